@@ -0,0 +1,244 @@
+/*
+ * certcache.c
+ *
+ * See LICENSE for details.
+ *
+ * A bounded LRU cache of parsed certificates, keyed on the digest of their
+ * encoding, so that loading a certificate seen before doesn't decode it
+ * again.  It is disabled until given a size.  Everything here runs with the
+ * GIL held, which serializes access to the cache.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+typedef struct {
+    unsigned char        key[CRYPTO_CERTCACHE_KEY_LENGTH];
+    X509                *cert;
+    Py_ssize_t           prev;      /* More recently used entry, or -1 */
+    Py_ssize_t           next;      /* Less recently used entry, or -1 */
+} cache_entry;
+
+static cache_entry *entries = NULL;
+static Py_ssize_t max_size = 0, size = 0;
+static Py_ssize_t head = -1, tail = -1;
+/* Entry indices by key */
+static PyObject *cache_index = NULL;
+static unsigned long hits = 0, misses = 0;
+
+/*
+ * Unlink an entry from the recently used list
+ */
+static void
+unlink_entry(Py_ssize_t i)
+{
+    if (entries[i].prev >= 0)
+        entries[entries[i].prev].next = entries[i].next;
+    else
+        head = entries[i].next;
+    if (entries[i].next >= 0)
+        entries[entries[i].next].prev = entries[i].prev;
+    else
+        tail = entries[i].prev;
+}
+
+/*
+ * Link an entry at the front of the recently used list
+ */
+static void
+link_entry(Py_ssize_t i)
+{
+    entries[i].prev = -1;
+    entries[i].next = head;
+    if (head >= 0)
+        entries[head].prev = i;
+    head = i;
+    if (tail < 0)
+        tail = i;
+}
+
+static PyObject *
+key_object(const unsigned char *key)
+{
+    return PyBytes_FromStringAndSize((const char *)key,
+                                     CRYPTO_CERTCACHE_KEY_LENGTH);
+}
+
+/*
+ * Check if the cache is enabled
+ *
+ * Returns: 1 if it is, 0 otherwise
+ */
+int
+crypto_certcache_enabled(void)
+{
+    return max_size > 0;
+}
+
+/*
+ * Compute the cache key of an encoded certificate
+ *
+ * Arguments: type - The file type (X509_FILETYPE_PEM or X509_FILETYPE_ASN1)
+ *            buf  - The encoded certificate
+ *            len  - Its length
+ *            key  - Where to store the CRYPTO_CERTCACHE_KEY_LENGTH byte key
+ * Returns:   1 on success, 0 on error
+ */
+int
+crypto_certcache_key(int type, const void *buf, size_t len, unsigned char *key)
+{
+    key[0] = (unsigned char)type;
+    return EVP_Digest(buf, len, key + 1, NULL, EVP_sha256(), NULL);
+}
+
+/*
+ * Look a certificate up in the cache, counting a hit or a miss.  The cache
+ * may have been disabled since the caller checked, by another thread.
+ *
+ * Arguments: key - The key of the encoded certificate
+ * Returns:   A new reference to the certificate, or NULL if it isn't cached
+ */
+X509 *
+crypto_certcache_get(const unsigned char *key)
+{
+    PyObject *key_obj, *value;
+    Py_ssize_t i;
+
+    if (max_size <= 0)
+        return NULL;
+    if ((key_obj = key_object(key)) == NULL)
+    {
+        PyErr_Clear();
+        return NULL;
+    }
+    value = PyDict_GetItem(cache_index, key_obj);
+    Py_DECREF(key_obj);
+    if (value == NULL)
+    {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    i = PyLong_AsSsize_t(value);
+    unlink_entry(i);
+    link_entry(i);
+    X509_up_ref(entries[i].cert);
+    return entries[i].cert;
+}
+
+/*
+ * Add a certificate to the cache, evicting the least recently used one if
+ * it is full.  The caller may have released the GIL since it checked that the
+ * cache is enabled, so this checks again: the cache may have been disabled
+ * or resized meanwhile, or another thread may have added the same
+ * certificate.  The cache is only an optimization, so errors are ignored.
+ *
+ * Arguments: key  - The key of the encoded certificate
+ *            cert - The certificate, which the cache takes a reference to
+ * Returns:   1 if the certificate was added, 0 otherwise
+ */
+int
+crypto_certcache_put(const unsigned char *key, X509 *cert)
+{
+    PyObject *key_obj, *old_key, *value;
+    Py_ssize_t i;
+
+    if (max_size <= 0)
+        return 0;
+    if ((key_obj = key_object(key)) == NULL)
+    {
+        PyErr_Clear();
+        return 0;
+    }
+    if (PyDict_GetItem(cache_index, key_obj) != NULL)
+    {
+        Py_DECREF(key_obj);
+        return 0;
+    }
+
+    if (size < max_size)
+    {
+        i = size++;
+    }
+    else
+    {
+        i = tail;
+        unlink_entry(i);
+        if ((old_key = key_object(entries[i].key)) == NULL ||
+            PyDict_DelItem(cache_index, old_key) < 0)
+            PyErr_Clear();
+        Py_XDECREF(old_key);
+        X509_free(entries[i].cert);
+    }
+
+    memcpy(entries[i].key, key, CRYPTO_CERTCACHE_KEY_LENGTH);
+    X509_up_ref(cert);
+    entries[i].cert = cert;
+    link_entry(i);
+
+    /*
+     * An entry which can't be indexed is never found, it just waits to be
+     * evicted
+     */
+    if ((value = PyLong_FromSsize_t(i)) == NULL ||
+        PyDict_SetItem(cache_index, key_obj, value) < 0)
+        PyErr_Clear();
+    Py_XDECREF(value);
+    Py_DECREF(key_obj);
+    return 1;
+}
+
+/*
+ * Empty the cache and change its size
+ *
+ * Arguments: new_size - The maximum number of certificates, 0 to disable it
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_certcache_resize(Py_ssize_t new_size)
+{
+    cache_entry *new_entries = NULL;
+    Py_ssize_t i;
+
+    if (new_size < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "cache size must not be negative");
+        return 0;
+    }
+    if (new_size > 0 && (new_entries = PyMem_New(cache_entry, new_size)) == NULL)
+    {
+        PyErr_NoMemory();
+        return 0;
+    }
+    if (cache_index == NULL && (cache_index = PyDict_New()) == NULL)
+    {
+        PyMem_Free(new_entries);
+        return 0;
+    }
+
+    for (i = 0; i < size; i++)
+        X509_free(entries[i].cert);
+    PyMem_Free(entries);
+    PyDict_Clear(cache_index);
+
+    entries = new_entries;
+    max_size = new_size;
+    size = 0;
+    head = tail = -1;
+    return 1;
+}
+
+/*
+ * Describe the state of the cache
+ *
+ * Returns: A dict with the hits, misses, size and max_size counters, or
+ *          NULL with an exception set
+ */
+PyObject *
+crypto_certcache_info(void)
+{
+    return Py_BuildValue("{s:k,s:k,s:n,s:n}", "hits", hits, "misses", misses,
+                         "size", size, "max_size", max_size);
+}
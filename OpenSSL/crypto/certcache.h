@@ -0,0 +1,28 @@
+/*
+ * certcache.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the certificate interning cache used by load_certificate.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_CERTCACHE_H_
+#define PyOpenSSL_crypto_CERTCACHE_H_
+
+#include <Python.h>
+#include <openssl/ssl.h>
+#include <openssl/sha.h>
+
+/* The file type followed by the SHA-256 digest of the encoded certificate */
+#define CRYPTO_CERTCACHE_KEY_LENGTH (1 + SHA256_DIGEST_LENGTH)
+
+extern  int       crypto_certcache_enabled   (void);
+extern  int       crypto_certcache_key       (int, const void *, size_t,
+                                              unsigned char *);
+extern  X509      *crypto_certcache_get      (const unsigned char *);
+extern  int       crypto_certcache_put       (const unsigned char *, X509 *);
+extern  int       crypto_certcache_resize    (Py_ssize_t);
+extern  PyObject  *crypto_certcache_info     (void);
+
+#endif
@@ -79,8 +79,116 @@ crypto_CRL_add_revoked(crypto_CRLObj *self, PyObject *args, PyObject *keywds) {
     return Py_None;
 }
 
+/*
+ * Sign a CRL with the given certificate and key, setting its issuer and its
+ * update times
+ *
+ * Arguments: self   - The CRL object
+ *            x509   - The certificate of the issuer
+ *            key    - The key to sign with
+ *            days   - The number of days until the next update
+ *            digest - The message digest, NULL for keys which don't take one
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+static int
+crypto_CRL_sign_with(crypto_CRLObj *self, crypto_X509Obj *x509,
+                     crypto_PKeyObj *key, int days, const EVP_MD *digest) {
+    ASN1_TIME *tmptm;
+
+    tmptm = ASN1_TIME_new();
+    if (!tmptm) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    X509_gmtime_adj(tmptm,0);
+    X509_CRL_set_lastUpdate(self->crl, tmptm);
+    X509_gmtime_adj(tmptm,days*24*60*60);
+    X509_CRL_set_nextUpdate(self->crl, tmptm);
+    ASN1_TIME_free(tmptm);
+    X509_CRL_set_issuer_name(self->crl, X509_get_subject_name(x509->x509));
+    if (!X509_CRL_sign(self->crl, key->pkey, digest)) {
+        exception_from_error_queue(crypto_Error);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Write a CRL to a BIO, as it was last signed
+ *
+ * Returns: The result of the OpenSSL function used
+ */
+static int
+crypto_CRL_write(crypto_CRLObj *self, BIO *bio, int type) {
+    switch (type) {
+        case X509_FILETYPE_PEM:
+            return PEM_write_bio_X509_CRL(bio, self->crl);
+
+        case X509_FILETYPE_ASN1:
+            return (int) i2d_X509_CRL_bio(bio, self->crl);
+
+        default:
+            return X509_CRL_print(bio, self->crl);
+    }
+}
+
+static int
+check_crl_type(int type) {
+    if (type != X509_FILETYPE_PEM && type != X509_FILETYPE_ASN1 &&
+        type != X509_FILETYPE_TEXT) {
+        PyErr_SetString(
+            PyExc_ValueError,
+            "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
+        return 0;
+    }
+    return 1;
+}
+
+static char crypto_CRL_sign_doc[] = "\n\
+sign(cert, key[, days][, digest=]) -> sign the CRL\n\
+\n\
+@param cert: The certificate of the issuer of the CRL.\n\
+@type cert: L{X509}\n\
+@param key: Used to sign CRL.\n\
+@type key: L{PKey}\n\
+@param days: The number of days until the next update of this CRL.\n\
+@type days: L{int}\n\
+@param digest: (keyword only) The message digest to use, md5 by default,\n\
+               or None for keys which don't take one.\n\
+@return: None\n\
+";
+static PyObject *
+crypto_CRL_sign(crypto_CRLObj *self, PyObject *args, PyObject *keywds) {
+    int days = 100;
+    const EVP_MD *digest = EVP_md5();
+    crypto_PKeyObj *key;
+    crypto_X509Obj *x509;
+    static char *kwlist[] = {"cert", "key", "days", "digest", NULL};
+
+    /* digest is keyword only */
+    if (PyTuple_GET_SIZE(args) > 3) {
+        PyErr_SetString(PyExc_TypeError,
+                        "sign() takes at most 3 positional arguments");
+        return NULL;
+    }
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O!O!|iO&:sign", kwlist,
+                                     &crypto_X509_Type, &x509,
+                                     &crypto_PKey_Type, &key, &days,
+                                     crypto_sign_digest_converter, &digest)) {
+        return NULL;
+    }
+
+    if (!crypto_CRL_sign_with(self, x509, key, days, digest)) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static char crypto_CRL_export_doc[] = "\n\
-export(cert, key[, type[, days]]) -> export a CRL as a string\n\
+export(cert, key[, type[, days]][, digest=]) -> export a CRL as a string\n\
 \n\
 @param cert: Used to sign CRL.\n\
 @type cert: L{X509}\n\
@@ -89,65 +197,106 @@ export(cert, key[, type[, days]]) -> export a CRL as a string\n\
 @param type: The export format, either L{FILETYPE_PEM}, L{FILETYPE_ASN1}, or L{FILETYPE_TEXT}.\n\
 @param days: The number of days until the next update of this CRL.\n\
 @type days: L{int}\n\
+@param digest: (keyword only) The message digest to use, md5 by default,\n\
+               or None for keys which don't take one.\n\
 @return: L{str}\n\
 ";
 static PyObject *
 crypto_CRL_export(crypto_CRLObj *self, PyObject *args, PyObject *keywds) {
-    int ret, buf_len, type = X509_FILETYPE_PEM, days = 100;
-    char *temp;
+    int ret, type = X509_FILETYPE_PEM, days = 100;
+    const EVP_MD *digest = EVP_md5();
     BIO *bio;
-    PyObject *buffer;
     crypto_PKeyObj *key;
-    ASN1_TIME *tmptm;
     crypto_X509Obj *x509;
-    static char *kwlist[] = {"cert", "key", "type", "days", NULL};
+    static char *kwlist[] = {"cert", "key", "type", "days", "digest", NULL};
     
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O!O!|ii:dump_crl", kwlist,
+    /* digest is keyword only */
+    if (PyTuple_GET_SIZE(args) > 4) {
+        PyErr_SetString(PyExc_TypeError,
+                        "export() takes at most 4 positional arguments");
+        return NULL;
+    }
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O!O!|iiO&:dump_crl", kwlist,
                                      &crypto_X509_Type, &x509, 
-                                     &crypto_PKey_Type, &key, &type, &days)) {
+                                     &crypto_PKey_Type, &key, &type, &days,
+                                     crypto_sign_digest_converter, &digest)) {
         return NULL;
     }
-    
+
+    if (!check_crl_type(type) ||
+        !crypto_CRL_sign_with(self, x509, key, days, digest)) {
+        return NULL;
+    }
+
     bio = BIO_new(BIO_s_mem());
-    tmptm = ASN1_TIME_new();
-    if (!tmptm) {
-        return 0;
+    ret = crypto_CRL_write(self, bio, type);
+    return crypto_bio_to_bytes(bio, ret);
+}
+
+static char crypto_CRL_export_into_doc[] = "\n\
+export_into(cert, key, buffer[, type[, days]][, digest=]) -> export a CRL\n\
+into a writable buffer\n\
+\n\
+Signing a CRL changes it, and the length of some signatures varies, so\n\
+query the size with cert and key, then write the CRL with None instead of\n\
+them, which writes it as signed by the query.\n\
+\n\
+@param cert: Used to sign CRL, or None to write it as last signed.\n\
+@type cert: L{X509}\n\
+@param key: Used to sign CRL, or None to write it as last signed.\n\
+@type key: L{PKey}\n\
+@param buffer: The writable buffer to export the CRL into, or None to only\n\
+               compute the size needed.\n\
+@param type: The export format, either L{FILETYPE_PEM}, L{FILETYPE_ASN1}, or L{FILETYPE_TEXT}.\n\
+@param days: The number of days until the next update of this CRL.\n\
+@type days: L{int}\n\
+@param digest: (keyword only) The message digest to use, md5 by default,\n\
+               or None for keys which don't take one.\n\
+@return: The number of bytes written (or needed)\n\
+";
+static PyObject *
+crypto_CRL_export_into(crypto_CRLObj *self, PyObject *args, PyObject *keywds) {
+    int ret, type = X509_FILETYPE_PEM, days = 100;
+    const EVP_MD *digest = EVP_md5();
+    PyObject *obj, *x509, *key;
+    crypto_OutputBuffer out;
+    static char *kwlist[] = {"cert", "key", "buffer", "type", "days", "digest", NULL};
+
+    /* digest is keyword only */
+    if (PyTuple_GET_SIZE(args) > 5) {
+        PyErr_SetString(PyExc_TypeError,
+                        "export_into() takes at most 5 positional arguments");
+        return NULL;
     }
-    X509_gmtime_adj(tmptm,0);
-    X509_CRL_set_lastUpdate(self->crl, tmptm);
-    X509_gmtime_adj(tmptm,days*24*60*60);
-    X509_CRL_set_nextUpdate(self->crl, tmptm);
-    ASN1_TIME_free(tmptm);
-    X509_CRL_set_issuer_name(self->crl, X509_get_subject_name(x509->x509));
-    X509_CRL_sign(self->crl, key->pkey, EVP_md5());
-    switch (type) {
-        case X509_FILETYPE_PEM:
-            ret = PEM_write_bio_X509_CRL(bio, self->crl);
-            break;
 
-        case X509_FILETYPE_ASN1:
-            ret = (int) i2d_X509_CRL_bio(bio, self->crl);
-            break;
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|iiO&:export_into", kwlist,
+                                     &x509, &key, &obj, &type, &days,
+                                     crypto_sign_digest_converter, &digest)) {
+        return NULL;
+    }
 
-        case X509_FILETYPE_TEXT:
-            ret = X509_CRL_print(bio, self->crl);
-            break;
+    if (!(x509 == Py_None && key == Py_None) &&
+        !(crypto_X509_Check(x509) && crypto_PKey_Check(key))) {
+        PyErr_SetString(PyExc_TypeError,
+                        "cert and key must be an X509 and a PKey, or both None");
+        return NULL;
+    }
 
-        default:
-            PyErr_SetString(
-                PyExc_ValueError,
-                "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
-            return NULL;
+    if (!check_crl_type(type)) {
+        return NULL;
     }
-    if (!ret) {
-        exception_from_error_queue(crypto_Error);
-        BIO_free(bio);
+    if (x509 != Py_None &&
+        !crypto_CRL_sign_with(self, (crypto_X509Obj *)x509,
+                              (crypto_PKeyObj *)key, days, digest)) {
         return NULL;
     }
-    buf_len = BIO_get_mem_data(bio, &temp);
-    buffer = PyBytes_FromStringAndSize(temp, buf_len);
-    BIO_free(bio);
-    return buffer;
+    if (!crypto_OutputBuffer_open(&out, obj)) {
+        return NULL;
+    }
+
+    ret = crypto_CRL_write(self, out.bio, type);
+    return crypto_OutputBuffer_close(&out, ret);
 }
 
 crypto_CRLObj *
@@ -174,7 +323,9 @@ crypto_CRL_New(X509_CRL *crl) {
 static PyMethodDef crypto_CRL_methods[] = {
     ADD_KW_METHOD(add_revoked),
     ADD_METHOD(get_revoked),
+    ADD_KW_METHOD(sign),
     ADD_KW_METHOD(export),
+    ADD_KW_METHOD(export_into),
     { NULL, NULL }
 };
 #undef ADD_METHOD
@@ -25,6 +25,10 @@ void **ssl_API;
 
 PyObject *crypto_Error;
 
+#ifdef WITH_THREAD
+int _pyOpenSSL_tstate_key;
+#endif
+
 int crypto_byte_converter(PyObject *input, void* output) {
     char **message = output;
     if (input == Py_None) {
@@ -37,30 +41,214 @@ int crypto_byte_converter(PyObject *input, void* output) {
     return 1;
 }
 
+/*
+ * Wrap a buffer in a read-only memory BIO, without copying it.  The buffer
+ * must stay alive until the BIO is freed.
+ *
+ * Arguments: view - The buffer
+ * Returns:   The BIO, or NULL with an exception set
+ */
+BIO *
+crypto_buffer_to_bio(Py_buffer *view) {
+    BIO *bio;
+
+    if (view->len > INT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "buffer too large");
+        return NULL;
+    }
+    if ((bio = BIO_new_mem_buf(view->buf, (int)view->len)) == NULL) {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+    return bio;
+}
+
+/*
+ * Turn what was written to a memory BIO into a string, and free the BIO
+ *
+ * Arguments: bio - The memory BIO
+ *            ok  - Whatever the OpenSSL function writing to bio returned
+ * Returns:   The string, or NULL with an exception set if ok is 0
+ */
+PyObject *
+crypto_bio_to_bytes(BIO *bio, int ok) {
+    char *temp;
+    long buf_len;
+    PyObject *buffer = NULL;
+
+    /* A passphrase callback may have raised an exception */
+    if (!PyErr_Occurred()) {
+        if (!ok) {
+            exception_from_error_queue(crypto_Error);
+        } else {
+            buf_len = BIO_get_mem_data(bio, &temp);
+            buffer = PyBytes_FromStringAndSize(temp, buf_len);
+        }
+    }
+
+    BIO_free(bio);
+    return buffer;
+}
+
+static BIO_METHOD *output_buffer_method = NULL;
+
+static int
+output_buffer_write(BIO *bio, const char *data, int len) {
+    crypto_OutputBuffer *out = BIO_get_data(bio);
+    Py_ssize_t n = out->view.len - out->written;
+
+    if (len <= 0)
+        return 0;
+    if (out->view.buf != NULL && n > 0) {
+        if (n > len)
+            n = len;
+        memcpy((char *)out->view.buf + out->written, data, n);
+    }
+    out->written += len;
+    return len;
+}
+
+static int
+output_buffer_puts(BIO *bio, const char *str) {
+    return output_buffer_write(bio, str, strlen(str));
+}
+
+static long
+output_buffer_ctrl(BIO *bio, int cmd, long num, void *ptr) {
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+/*
+ * Set up writing to a caller supplied buffer
+ *
+ * Arguments: out - The output buffer to set up
+ *            obj - A writable object supporting the buffer protocol, or
+ *                  None to only count the bytes written
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_OutputBuffer_open(crypto_OutputBuffer *out, PyObject *obj) {
+    memset(out, 0, sizeof(*out));
+
+    if (obj != Py_None && PyObject_GetBuffer(obj, &out->view, PyBUF_WRITABLE) < 0)
+        return 0;
+
+    if (output_buffer_method == NULL) {
+        output_buffer_method = BIO_meth_new(BIO_TYPE_SOURCE_SINK, "Python buffer");
+        if (output_buffer_method == NULL ||
+            !BIO_meth_set_write(output_buffer_method, output_buffer_write) ||
+            !BIO_meth_set_puts(output_buffer_method, output_buffer_puts) ||
+            !BIO_meth_set_ctrl(output_buffer_method, output_buffer_ctrl)) {
+            BIO_meth_free(output_buffer_method);
+            output_buffer_method = NULL;
+        }
+    }
+
+    if (output_buffer_method == NULL ||
+        (out->bio = BIO_new(output_buffer_method)) == NULL) {
+        if (out->view.obj != NULL)
+            PyBuffer_Release(&out->view);
+        exception_from_error_queue(crypto_Error);
+        return 0;
+    }
+    BIO_set_data(out->bio, out);
+    BIO_set_init(out->bio, 1);
+    return 1;
+}
+
+/*
+ * Finish writing to a caller supplied buffer, and release it
+ *
+ * Arguments: out - The output buffer
+ *            ok  - Whatever the OpenSSL function writing to out->bio returned
+ * Returns:   The number of bytes written (or needed, when only counting), or
+ *            NULL with an exception set if ok is 0 or the buffer is too small
+ */
+PyObject *
+crypto_OutputBuffer_close(crypto_OutputBuffer *out, int ok) {
+    PyObject *result = NULL;
+
+    BIO_free(out->bio);
+    if (!PyErr_Occurred()) {
+        if (!ok) {
+            exception_from_error_queue(crypto_Error);
+        } else if (out->view.buf != NULL && out->written > out->view.len) {
+            PyErr_Format(PyExc_ValueError, "buffer too small, %ld bytes needed",
+                         (long)out->written);
+        } else {
+            result = PyLong_FromSsize_t(out->written);
+        }
+    }
+
+    if (out->view.obj != NULL)
+        PyBuffer_Release(&out->view);
+    return result;
+}
+
+/*
+ * Passphrase callback handed to the PEM routines.  These always run with the
+ * GIL released, so it has to be reacquired before calling into Python and
+ * released again before handing control back to OpenSSL.
+ *
+ * Arguments: buf    - Where to store the passphrase
+ *            len    - Size of buf
+ *            rwflag - Whether the passphrase is used for writing
+ *            cb_arg - The Python callable
+ * Returns:   The length of the passphrase, or 0 on error
+ */
 static int
 global_passphrase_callback(char *buf, int len, int rwflag, void *cb_arg)
 {
     PyObject *func, *argv, *ret;
-    int nchars;
+    int nchars = 0;
+
+    MY_END_ALLOW_THREADS(ignored);
 
     func = (PyObject *)cb_arg;
     argv = Py_BuildValue("(i)", rwflag);
     ret = PyEval_CallObject(func, argv);
     Py_DECREF(argv);
-    if (ret == NULL)
-        return 0;
-    if (!PyBytes_Check(ret))
+    if (ret != NULL)
     {
-        PyErr_SetString(PyExc_ValueError, "String expected");
-        return 0;
+        if (!PyBytes_Check(ret))
+        {
+            PyErr_SetString(PyExc_ValueError, "String expected");
+        }
+        else
+        {
+            nchars = PyBytes_Size(ret);
+            if (nchars > len)
+                nchars = len;
+            strncpy(buf, PyBytes_AsString(ret), nchars);
+        }
+        Py_DECREF(ret);
     }
-    nchars = PyBytes_Size(ret);
-    if (nchars > len)
-        nchars = len;
-    strncpy(buf, PyBytes_AsString(ret), nchars);
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
     return nchars;
 }
 
+/*
+ * Check a FILETYPE_* argument before any work is done with the GIL released.
+ *
+ * Arguments: type       - The file type passed in by the caller
+ *            allow_text - Whether FILETYPE_TEXT is acceptable
+ * Returns:   1 if the type is acceptable, 0 (with ValueError set) otherwise
+ */
+static int
+check_filetype(int type, int allow_text)
+{
+    if (type == X509_FILETYPE_PEM || type == X509_FILETYPE_ASN1 ||
+        (allow_text && type == X509_FILETYPE_TEXT))
+        return 1;
+
+    if (allow_text)
+        PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
+    else
+        PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
+    return 0;
+}
+
 static char crypto_load_privatekey_doc[] = "\n\
 Load a private key from a buffer\n\
 \n\
@@ -77,15 +265,15 @@ static PyObject *
 crypto_load_privatekey(PyObject *spam, PyObject *args)
 {
     crypto_PKeyObj *crypto_PKey_New(EVP_PKEY *, int);
-    int type, len;
-    char *buffer;
+    int type;
+    Py_buffer buffer;
     PyObject *pw = NULL;
     pem_password_cb *cb = NULL;
     void *cb_arg = NULL;
     BIO *bio;
     EVP_PKEY *pkey;
 
-    if (!PyArg_ParseTuple(args, "is#|O:load_privatekey", &type, &buffer, &len, &pw))
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT "|O:load_privatekey", &type, &buffer, &pw))
         return NULL;
 
     if (pw != NULL)
@@ -102,28 +290,26 @@ crypto_load_privatekey(PyObject *spam, PyObject *args)
         }
         else
         {
+            PyBuffer_Release(&buffer);
             PyErr_SetString(PyExc_TypeError, "Last argument must be string or callable");
             return NULL;
         }
     }
 
-    bio = BIO_new_mem_buf(buffer, len);
-    switch (type)
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&buffer)) == NULL)
     {
-        case X509_FILETYPE_PEM:
-            pkey = PEM_read_bio_PrivateKey(bio, NULL, cb, cb_arg);
-            break;
-
-        case X509_FILETYPE_ASN1:
-            pkey = d2i_PrivateKey_bio(bio, NULL);
-            break;
-
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
-            BIO_free(bio);
-            return NULL;
+        PyBuffer_Release(&buffer);
+        return NULL;
     }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM)
+        pkey = PEM_read_bio_PrivateKey(bio, NULL, cb, cb_arg);
+    else
+        pkey = d2i_PrivateKey_bio(bio, NULL);
     BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
 
     if (pkey == NULL)
     {
@@ -140,7 +326,7 @@ Dump a private key to a buffer\n\
 @param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
 @param pkey: The PKey to dump\n\
 @param cipher: (optional) if encrypted PEM format, the cipher to\n\
-               use\n\
+               use, a Cipher object or the name of the cipher\n\
 @param passphrase - (optional) if encrypted PEM format, this can be either\n\
                     the passphrase to use, or a callback for providing the\n\
                     passphrase.\n\
@@ -148,95 +334,158 @@ Dump a private key to a buffer\n\
 @rtype: C{str}\n\
 ";
 
-static PyObject *
-crypto_dump_privatekey(PyObject *spam, PyObject *args)
+/*
+ * Check the optional cipher and passphrase arguments of dump_privatekey and
+ * dump_privatekey_into
+ *
+ * Arguments: cipher     - The cipher, or NULL
+ *            pw         - The passphrase or passphrase callback, or NULL
+ *            cb, cb_arg - Where to store the PEM passphrase callback and its
+ *                         argument
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+static int
+privatekey_cipher_args(const EVP_CIPHER *cipher, PyObject *pw,
+                       pem_password_cb **cb, void **cb_arg)
 {
-    int type, ret, buf_len;
-    char *temp;
-    PyObject *buffer;
-    char *cipher_name = NULL;
-    const EVP_CIPHER *cipher = NULL;
-    PyObject *pw = NULL;
-    pem_password_cb *cb = NULL;
-    void *cb_arg = NULL;
-    BIO *bio;
-    RSA *rsa;
-    crypto_PKeyObj *pkey;
+    *cb = NULL;
+    *cb_arg = NULL;
 
-    if (!PyArg_ParseTuple(args, "iO!|sO:dump_privatekey", &type,
-			  &crypto_PKey_Type, &pkey, &cipher_name, &pw))
-        return NULL;
+    if (cipher == NULL)
+        return 1;
 
-    if (cipher_name != NULL && pw == NULL)
+    if (pw == NULL)
     {
         PyErr_SetString(PyExc_ValueError, "Illegal number of arguments");
-        return NULL;
+        return 0;
     }
-    if (cipher_name != NULL)
+    if (PyBytes_Check(pw))
     {
-        cipher = EVP_get_cipherbyname(cipher_name);
-        if (cipher == NULL)
-        {
-            PyErr_SetString(PyExc_ValueError, "Invalid cipher name");
-            return NULL;
-        }
-        if (PyBytes_Check(pw))
-        {
-            cb = NULL;
-            cb_arg = PyBytes_AsString(pw);
-        }
-        else if (PyCallable_Check(pw))
-        {
-            cb = global_passphrase_callback;
-            cb_arg = pw;
-        }
-        else
-        {
-            PyErr_SetString(PyExc_TypeError, "Last argument must be string or callable");
-            return NULL;
-        }
+        *cb_arg = PyBytes_AsString(pw);
+    }
+    else if (PyCallable_Check(pw))
+    {
+        *cb = global_passphrase_callback;
+        *cb_arg = pw;
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, "Last argument must be string or callable");
+        return 0;
     }
+    return 1;
+}
+
+/*
+ * Write a private key to a BIO.  Must be called with the GIL released.
+ *
+ * Returns: The result of the OpenSSL function used
+ */
+static int
+write_privatekey(BIO *bio, int type, EVP_PKEY *pkey, const EVP_CIPHER *cipher,
+                 pem_password_cb *cb, void *cb_arg)
+{
+    int ret;
 
-    bio = BIO_new(BIO_s_mem());
     switch (type)
     {
         case X509_FILETYPE_PEM:
-            ret = PEM_write_bio_PrivateKey(bio, pkey->pkey, cipher, NULL, 0, cb, cb_arg);
-            if (PyErr_Occurred())
-            {
-                BIO_free(bio);
-                return NULL;
-            }
+            ret = PEM_write_bio_PrivateKey(bio, pkey, cipher, NULL, 0, cb, cb_arg);
             break;
 
         case X509_FILETYPE_ASN1:
-            ret = i2d_PrivateKey_bio(bio, pkey->pkey);
-            break;
-
-        case X509_FILETYPE_TEXT:
-            rsa = EVP_PKEY_get1_RSA(pkey->pkey);
-            ret = RSA_print(bio, rsa, 0);
-            RSA_free(rsa); 
+            ret = i2d_PrivateKey_bio(bio, pkey);
             break;
 
         default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
-            BIO_free(bio);
-            return NULL;
+            ret = EVP_PKEY_print_private(bio, pkey, 0, NULL);
+            break;
     }
+    return ret;
+}
 
-    if (ret == 0)
-    {
-        BIO_free(bio);
-        exception_from_error_queue(crypto_Error);
+static PyObject *
+crypto_dump_privatekey(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    const EVP_CIPHER *cipher = NULL;
+    PyObject *pw = NULL;
+    pem_password_cb *cb;
+    void *cb_arg;
+    BIO *bio;
+    crypto_PKeyObj *pkey;
+    EVP_PKEY *key;
+
+    if (!PyArg_ParseTuple(args, "iO!|O&O:dump_privatekey", &type,
+			  &crypto_PKey_Type, &pkey, crypto_cipher_converter,
+			  &cipher, &pw))
         return NULL;
-    }
 
-    buf_len = BIO_get_mem_data(bio, &temp);
-    buffer = PyBytes_FromStringAndSize(temp, buf_len);
-    BIO_free(bio);
+    if (!privatekey_cipher_args(cipher, pw, &cb, &cb_arg))
+        return NULL;
 
-    return buffer;
+    if (!check_filetype(type, 1))
+        return NULL;
+
+    /* The passphrase callback or another thread may replace the key */
+    key = pkey->pkey;
+    EVP_PKEY_up_ref(key);
+    bio = BIO_new(BIO_s_mem());
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_privatekey(bio, type, key, cipher, cb, cb_arg);
+    MY_END_ALLOW_THREADS(ignored);
+    EVP_PKEY_free(key);
+
+    return crypto_bio_to_bytes(bio, ret);
+}
+
+static char crypto_dump_privatekey_into_doc[] = "\n\
+Dump a private key into a writable buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param pkey: The PKey to dump\n\
+@param buffer: The writable buffer to dump the key into, or None to only\n\
+               compute the size needed\n\
+@param cipher: (optional) if encrypted PEM format, the cipher to\n\
+               use, a Cipher object or the name of the cipher\n\
+@param passphrase - (optional) if encrypted PEM format, this can be either\n\
+                    the passphrase to use, or a callback for providing the\n\
+                    passphrase.\n\
+@return: The number of bytes written (or needed)\n\
+";
+
+static PyObject *
+crypto_dump_privatekey_into(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    const EVP_CIPHER *cipher = NULL;
+    PyObject *obj, *pw = NULL;
+    pem_password_cb *cb;
+    void *cb_arg;
+    crypto_OutputBuffer out;
+    crypto_PKeyObj *pkey;
+    EVP_PKEY *key;
+
+    if (!PyArg_ParseTuple(args, "iO!O|O&O:dump_privatekey_into", &type,
+			  &crypto_PKey_Type, &pkey, &obj, crypto_cipher_converter,
+			  &cipher, &pw))
+        return NULL;
+
+    if (!privatekey_cipher_args(cipher, pw, &cb, &cb_arg))
+        return NULL;
+
+    if (!check_filetype(type, 1) || !crypto_OutputBuffer_open(&out, obj))
+        return NULL;
+
+    /* The passphrase callback or another thread may replace the key */
+    key = pkey->pkey;
+    EVP_PKEY_up_ref(key);
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_privatekey(out.bio, type, key, cipher, cb, cb_arg);
+    MY_END_ALLOW_THREADS(ignored);
+    EVP_PKEY_free(key);
+
+    return crypto_OutputBuffer_close(&out, ret);
 }
 
 static char crypto_load_certificate_doc[] = "\n\
@@ -251,134 +500,334 @@ static PyObject *
 crypto_load_certificate(PyObject *spam, PyObject *args)
 {
     crypto_X509Obj *crypto_X509_New(X509 *, int);
-    int type, len;
-    char *buffer;
+    crypto_X509Obj *x509;
+    int type, cached;
+    unsigned char key[CRYPTO_CERTCACHE_KEY_LENGTH];
+    Py_buffer buffer;
     BIO *bio;
     X509 *cert;
 
-    if (!PyArg_ParseTuple(args, "is#:load_certificate", &type, &buffer, &len))
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_certificate", &type, &buffer))
         return NULL;
 
-    bio = BIO_new_mem_buf(buffer, len);
-    switch (type)
+    if (!check_filetype(type, 0))
     {
-        case X509_FILETYPE_PEM:
-            cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
-            break;
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
 
-        case X509_FILETYPE_ASN1:
-            cert = d2i_X509_bio(bio, NULL);
-            break;
+    cached = crypto_certcache_enabled() &&
+        crypto_certcache_key(type, buffer.buf, buffer.len, key);
+    if (cached && (cert = crypto_certcache_get(key)) != NULL)
+    {
+        PyBuffer_Release(&buffer);
+        goto done;
+    }
 
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
-            BIO_free(bio);
-            return NULL;
+    if ((bio = crypto_buffer_to_bio(&buffer)) == NULL)
+    {
+        PyBuffer_Release(&buffer);
+        return NULL;
     }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM)
+        cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    else
+        cert = d2i_X509_bio(bio, NULL);
     BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
 
     if (cert == NULL)
     {
         exception_from_error_queue(crypto_Error);
         return NULL;
     }
+    /* The cache may have been disabled or resized while decoding */
+    if (cached)
+        cached = crypto_certcache_put(key, cert);
 
-    return (PyObject *)crypto_X509_New(cert, 1);
+  done:
+    if ((x509 = crypto_X509_New(cert, 1)) == NULL)
+    {
+        X509_free(cert);
+        return NULL;
+    }
+    /* The cache shares the certificate between everybody loading it */
+    x509->readonly = cached;
+    return (PyObject *)x509;
 }
 
-static char crypto_dump_certificate_doc[] = "\n\
-Dump a certificate to a buffer\n\
+static char crypto_set_certificate_cache_size_doc[] = "\n\
+Enable, disable or resize the certificate cache, emptying it.  While it is\n\
+enabled, load_certificate returns a read-only X509 object sharing the parsed\n\
+certificate for data it has already loaded.\n\
 \n\
-@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
-@param cert: The certificate to dump\n\
-@return: The buffer with the dumped certificate in\n\
+@param size: The maximum number of certificates to keep, 0 to disable the\n\
+             cache\n\
+@return: None\n\
 ";
 
 static PyObject *
-crypto_dump_certificate(PyObject *spam, PyObject *args)
+crypto_set_certificate_cache_size(PyObject *spam, PyObject *args)
 {
-    int type, ret, buf_len;
-    char *temp;
-    PyObject *buffer;
-    BIO *bio;
-    crypto_X509Obj *cert;
+    Py_ssize_t size;
 
-    if (!PyArg_ParseTuple(args, "iO!:dump_certificate", &type,
-			  &crypto_X509_Type, &cert))
+    if (!PyArg_ParseTuple(args, "n:set_certificate_cache_size", &size))
         return NULL;
 
-    bio = BIO_new(BIO_s_mem());
-    switch (type)
-    {
-        case X509_FILETYPE_PEM:
-            ret = PEM_write_bio_X509(bio, cert->x509);
-            break;
-
-        case X509_FILETYPE_ASN1:
-            ret = i2d_X509_bio(bio, cert->x509);
-            break;
+    if (!crypto_certcache_resize(size))
+        return NULL;
 
-        case X509_FILETYPE_TEXT:
-            ret = X509_print_ex(bio, cert->x509, XN_FLAG_ONELINE, 0);
-            break;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
 
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
-            BIO_free(bio);
-            return NULL;
-    }
+static char crypto_get_certificate_cache_info_doc[] = "\n\
+Return the statistics of the certificate cache\n\
+\n\
+@return: A dict with the number of hits and misses since the module was\n\
+         loaded, the number of certificates in the cache (size) and the\n\
+         maximum (max_size)\n\
+";
 
-    if (ret == 0)
-    {
-        BIO_free(bio);
-        exception_from_error_queue(crypto_Error);
+static PyObject *
+crypto_get_certificate_cache_info(PyObject *spam, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_certificate_cache_info"))
         return NULL;
-    }
-
-    buf_len = BIO_get_mem_data(bio, &temp);
-    buffer = PyBytes_FromStringAndSize(temp, buf_len);
-    BIO_free(bio);
 
-    return buffer;
+    return crypto_certcache_info();
 }
 
-static char crypto_load_certificate_request_doc[] = "\n\
-Load a certificate request from a buffer\n\
+static char crypto_load_certificates_doc[] = "\n\
+Load all the certificates in a buffer, such as a bundle of CA certificates\n\
 \n\
 @param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
-             buffer - The buffer the certificate request is stored in\n\
-@return: The X509Req object\n\
+@param buffer: The buffer the certificates are stored in, any object\n\
+               supporting the buffer protocol\n\
+@return: A list of X509 objects, empty if a PEM buffer holds no\n\
+         certificate\n\
 ";
 
 static PyObject *
-crypto_load_certificate_request(PyObject *spam, PyObject *args)
+crypto_load_certificates(PyObject *spam, PyObject *args)
 {
-    crypto_X509ReqObj *crypto_X509Req_New(X509_REQ *, int);
-    int type, len;
-    char *buffer;
+    int type, eof = 0;
+    Py_buffer view;
     BIO *bio;
-    X509_REQ *req;
+    X509 *cert;
+    STACK_OF(X509) *certs;
+    PyObject *list = NULL, *item;
+    int i, n;
 
-    if (!PyArg_ParseTuple(args, "is#:load_certificate_request", &type, &buffer, &len))
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_certificates", &type, &view))
         return NULL;
 
-    bio = BIO_new_mem_buf(buffer, len);
-    switch (type)
-    {
-        case X509_FILETYPE_PEM:
-            req = PEM_read_bio_X509_REQ(bio, NULL, NULL, NULL);
-            break;
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&view)) == NULL)
+        goto done;
 
-        case X509_FILETYPE_ASN1:
-            req = d2i_X509_REQ_bio(bio, NULL);
-            break;
-
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
-            BIO_free(bio);
-            return NULL;
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if ((certs = sk_X509_new_null()) != NULL) {
+        while ((cert = crypto_X509_read_bio(bio, type, &eof)) != NULL) {
+            if (!sk_X509_push(certs, cert)) {
+                X509_free(cert);
+                break;
+            }
+        }
+        if (!eof) {
+            sk_X509_pop_free(certs, X509_free);
+            certs = NULL;
+        }
+    }
+    BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if (certs == NULL) {
+        exception_from_error_queue(crypto_Error);
+        goto done;
+    }
+
+    n = sk_X509_num(certs);
+    if ((list = PyList_New(n)) != NULL) {
+        for (i = 0; i < n; i++) {
+            cert = sk_X509_value(certs, i);
+            if ((item = (PyObject *)crypto_X509_New(cert, 1)) == NULL) {
+                Py_DECREF(list);
+                list = NULL;
+                break;
+            }
+            PyList_SET_ITEM(list, i, item);
+        }
+        /* The remaining certificates were not handed over to the list */
+        for (; i < n; i++)
+            X509_free(sk_X509_value(certs, i));
+    }
+    else {
+        for (i = 0; i < n; i++)
+            X509_free(sk_X509_value(certs, i));
+    }
+    sk_X509_free(certs);
+
+  done:
+    PyBuffer_Release(&view);
+    return list;
+}
+
+static char crypto_iter_certificates_doc[] = "\n\
+Iterate over the certificates in a buffer, parsing them one at a time\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param buffer: The buffer the certificates are stored in, any object\n\
+               supporting the buffer protocol\n\
+@return: An iterator of X509 objects\n\
+";
+
+static PyObject *
+crypto_iter_certificates(PyObject *spam, PyObject *args)
+{
+    int type;
+    Py_buffer view;
+
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":iter_certificates", &type, &view))
+        return NULL;
+
+    if (!check_filetype(type, 0)) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    return crypto_X509Iterator_New(type, &view);
+}
+
+static char crypto_dump_certificate_doc[] = "\n\
+Dump a certificate to a buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param cert: The certificate to dump\n\
+@return: The buffer with the dumped certificate in\n\
+";
+
+/*
+ * Write a certificate to a BIO.  Can be called with the GIL released.
+ *
+ * Returns: The result of the OpenSSL function used
+ */
+static int
+write_certificate(BIO *bio, int type, X509 *cert)
+{
+    switch (type)
+    {
+        case X509_FILETYPE_PEM:
+            return PEM_write_bio_X509(bio, cert);
+
+        case X509_FILETYPE_ASN1:
+            return i2d_X509_bio(bio, cert);
+
+        default:
+            return X509_print_ex(bio, cert, XN_FLAG_ONELINE, 0);
+    }
+}
+
+static PyObject *
+crypto_dump_certificate(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    BIO *bio;
+    crypto_X509Obj *cert;
+    X509 *x509;
+
+    if (!PyArg_ParseTuple(args, "iO!:dump_certificate", &type,
+			  &crypto_X509_Type, &cert))
+        return NULL;
+
+    if (!check_filetype(type, 1))
+        return NULL;
+
+    /* Keep the certificate alive while the GIL is released */
+    x509 = cert->x509;
+    X509_up_ref(x509);
+    bio = BIO_new(BIO_s_mem());
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_certificate(bio, type, x509);
+    MY_END_ALLOW_THREADS(ignored);
+    X509_free(x509);
+
+    return crypto_bio_to_bytes(bio, ret);
+}
+
+static char crypto_dump_certificate_into_doc[] = "\n\
+Dump a certificate into a writable buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param cert: The certificate to dump\n\
+@param buffer: The writable buffer to dump the certificate into, or None to\n\
+               only compute the size needed\n\
+@return: The number of bytes written (or needed)\n\
+";
+
+static PyObject *
+crypto_dump_certificate_into(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    PyObject *obj;
+    crypto_OutputBuffer out;
+    crypto_X509Obj *cert;
+    X509 *x509;
+
+    if (!PyArg_ParseTuple(args, "iO!O:dump_certificate_into", &type,
+			  &crypto_X509_Type, &cert, &obj))
+        return NULL;
+
+    if (!check_filetype(type, 1) || !crypto_OutputBuffer_open(&out, obj))
+        return NULL;
+
+    /* Keep the certificate alive while the GIL is released */
+    x509 = cert->x509;
+    X509_up_ref(x509);
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_certificate(out.bio, type, x509);
+    MY_END_ALLOW_THREADS(ignored);
+    X509_free(x509);
+
+    return crypto_OutputBuffer_close(&out, ret);
+}
+
+static char crypto_load_certificate_request_doc[] = "\n\
+Load a certificate request from a buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+             buffer - The buffer the certificate request is stored in\n\
+@return: The X509Req object\n\
+";
+
+static PyObject *
+crypto_load_certificate_request(PyObject *spam, PyObject *args)
+{
+    crypto_X509ReqObj *crypto_X509Req_New(X509_REQ *, int);
+    int type;
+    Py_buffer buffer;
+    BIO *bio;
+    X509_REQ *req;
+
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_certificate_request", &type, &buffer))
+        return NULL;
+
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&buffer)) == NULL)
+    {
+        PyBuffer_Release(&buffer);
+        return NULL;
     }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM)
+        req = PEM_read_bio_X509_REQ(bio, NULL, NULL, NULL);
+    else
+        req = d2i_X509_REQ_bio(bio, NULL);
     BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
 
     if (req == NULL)
     {
@@ -397,12 +846,31 @@ Dump a certificate request to a buffer\n\
 @return: The buffer with the dumped certificate request in\n\
 ";
 
+/*
+ * Write a certificate request to a BIO.  Can be called with the GIL released.
+ *
+ * Returns: The result of the OpenSSL function used
+ */
+static int
+write_certificate_request(BIO *bio, int type, X509_REQ *req)
+{
+    switch (type)
+    {
+        case X509_FILETYPE_PEM:
+            return PEM_write_bio_X509_REQ(bio, req);
+
+        case X509_FILETYPE_ASN1:
+            return i2d_X509_REQ_bio(bio, req);
+
+        default:
+            return X509_REQ_print_ex(bio, req, XN_FLAG_ONELINE, 0);
+    }
+}
+
 static PyObject *
 crypto_dump_certificate_request(PyObject *spam, PyObject *args)
 {
-    int type, ret, buf_len;
-    char *temp;
-    PyObject *buffer;
+    int type, ret;
     BIO *bio;
     crypto_X509ReqObj *req;
 
@@ -410,39 +878,133 @@ crypto_dump_certificate_request(PyObject *spam, PyObject *args)
 			  &crypto_X509Req_Type, &req))
         return NULL;
 
+    if (!check_filetype(type, 1))
+        return NULL;
+
     bio = BIO_new(BIO_s_mem());
-    switch (type)
-    {
-        case X509_FILETYPE_PEM:
-            ret = PEM_write_bio_X509_REQ(bio, req->x509_req);
-            break;
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_certificate_request(bio, type, req->x509_req);
+    MY_END_ALLOW_THREADS(ignored);
 
-        case X509_FILETYPE_ASN1:
-            ret = i2d_X509_REQ_bio(bio, req->x509_req);
-            break;
+    return crypto_bio_to_bytes(bio, ret);
+}
 
-        case X509_FILETYPE_TEXT:
-            ret = X509_REQ_print_ex(bio, req->x509_req, XN_FLAG_ONELINE, 0);
-            break;
+static char crypto_dump_certificate_request_into_doc[] = "\n\
+Dump a certificate request into a writable buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param req: The certificate request to dump\n\
+@param buffer: The writable buffer to dump the request into, or None to\n\
+               only compute the size needed\n\
+@return: The number of bytes written (or needed)\n\
+";
 
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM, FILETYPE_ASN1, or FILETYPE_TEXT");
-            BIO_free(bio);
-            return NULL;
+static PyObject *
+crypto_dump_certificate_request_into(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    PyObject *obj;
+    crypto_OutputBuffer out;
+    crypto_X509ReqObj *req;
+
+    if (!PyArg_ParseTuple(args, "iO!O:dump_certificate_request_into", &type,
+			  &crypto_X509Req_Type, &req, &obj))
+        return NULL;
+
+    if (!check_filetype(type, 1) || !crypto_OutputBuffer_open(&out, obj))
+        return NULL;
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = write_certificate_request(out.bio, type, req->x509_req);
+    MY_END_ALLOW_THREADS(ignored);
+
+    return crypto_OutputBuffer_close(&out, ret);
+}
+
+static char crypto_load_dsa_params_doc[] = "\n\
+Load DSA domain parameters from a buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1)\n\
+@param buffer: The buffer the parameters are stored in\n\
+@return: The DSAParameters object\n\
+";
+
+static PyObject *
+crypto_load_dsa_params(PyObject *spam, PyObject *args)
+{
+    int type;
+    Py_buffer buffer;
+    BIO *bio;
+    DSA *dsa;
+
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_dsa_params", &type, &buffer))
+        return NULL;
+
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&buffer)) == NULL)
+    {
+        PyBuffer_Release(&buffer);
+        return NULL;
     }
 
-    if (ret == 0)
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM)
+        dsa = PEM_read_bio_DSAparams(bio, NULL, NULL, NULL);
+    else
+        dsa = d2i_DSAparams_bio(bio, NULL);
+    BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
+
+    if (dsa == NULL)
     {
-        BIO_free(bio);
         exception_from_error_queue(crypto_Error);
         return NULL;
     }
 
-    buf_len = BIO_get_mem_data(bio, &temp);
-    buffer = PyBytes_FromStringAndSize(temp, buf_len);
-    BIO_free(bio);
+    return (PyObject *)crypto_DSAParameters_New(dsa);
+}
 
-    return buffer;
+static char crypto_dump_dsa_params_doc[] = "\n\
+Dump DSA domain parameters to a buffer\n\
+\n\
+@param type: The file type (one of FILETYPE_PEM, FILETYPE_ASN1, FILETYPE_TEXT)\n\
+@param params: The DSAParameters to dump\n\
+@return: The buffer with the dumped parameters in\n\
+";
+
+static PyObject *
+crypto_dump_dsa_params(PyObject *spam, PyObject *args)
+{
+    int type, ret;
+    BIO *bio;
+    crypto_DSAParametersObj *params;
+
+    if (!PyArg_ParseTuple(args, "iO!:dump_dsa_params", &type,
+                          &crypto_DSAParameters_Type, &params))
+        return NULL;
+
+    if (!check_filetype(type, 1))
+        return NULL;
+
+    bio = BIO_new(BIO_s_mem());
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    switch (type)
+    {
+        case X509_FILETYPE_PEM:
+            ret = PEM_write_bio_DSAparams(bio, params->dsa);
+            break;
+
+        case X509_FILETYPE_ASN1:
+            ret = i2d_DSAparams_bio(bio, params->dsa);
+            break;
+
+        default:
+            ret = DSAparams_print(bio, params->dsa);
+            break;
+    }
+    MY_END_ALLOW_THREADS(ignored);
+
+    return crypto_bio_to_bytes(bio, ret);
 }
 
 static char crypto_load_crl_doc[] = "\n\
@@ -456,31 +1018,29 @@ Load a certificate revocation list from a buffer\n\
 
 static PyObject *
 crypto_load_crl(PyObject *spam, PyObject *args) {
-    int type, len;
-    char *buffer;
+    int type;
+    Py_buffer buffer;
     BIO *bio;
     X509_CRL *crl;
 
-    if (!PyArg_ParseTuple(args, "is#:load_crl", &type, &buffer, &len)) {
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_crl", &type, &buffer)) {
         return NULL;
     }
 
-    bio = BIO_new_mem_buf(buffer, len);
-    switch (type) {
-        case X509_FILETYPE_PEM:
-            crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL);
-            break;
-
-        case X509_FILETYPE_ASN1:
-            crl = d2i_X509_CRL_bio(bio, NULL);
-            break;
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&buffer)) == NULL) {
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
 
-        default:
-            PyErr_SetString(PyExc_ValueError, "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
-            BIO_free(bio);
-            return NULL;
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM) {
+        crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL);
+    } else {
+        crl = d2i_X509_CRL_bio(bio, NULL);
     }
     BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
 
     if (crl == NULL) {
         exception_from_error_queue(crypto_Error);
@@ -501,97 +1061,753 @@ Load pkcs7 data from a buffer\n\
 static PyObject *
 crypto_load_pkcs7_data(PyObject *spam, PyObject *args)
 {
-    int type, len;
-    char *buffer;
+    int type;
+    Py_buffer buffer;
     BIO *bio;
     PKCS7 *pkcs7 = NULL;
 
-    if (!PyArg_ParseTuple(args, "is#:load_pkcs7_data", &type, &buffer, &len))
+    if (!PyArg_ParseTuple(args, "i" BUFFER_FMT ":load_pkcs7_data", &type, &buffer))
+        return NULL;
+
+    if (!check_filetype(type, 0) || (bio = crypto_buffer_to_bio(&buffer)) == NULL)
+    {
+        PyBuffer_Release(&buffer);
         return NULL;
+    }
 
     /* 
      * Try to read the pkcs7 data from the bio 
      */
-    bio = BIO_new_mem_buf(buffer, len);
-    switch (type)
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if (type == X509_FILETYPE_PEM)
+        pkcs7 = PEM_read_bio_PKCS7(bio, NULL, NULL, NULL);
+    else
+        pkcs7 = d2i_PKCS7_bio(bio, NULL);
+    BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
+
+    /*
+     * Check if we got a PKCS7 structure
+     */
+    if (pkcs7 == NULL)
     {
-        case X509_FILETYPE_PEM:
-            pkcs7 = PEM_read_bio_PKCS7(bio, NULL, NULL, NULL);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return (PyObject *)crypto_PKCS7_New(pkcs7, 1);
+}
+
+static char crypto_load_pkcs12_doc[] = "\n\
+Load a PKCS12 object from a buffer\n\
+\n\
+@param buffer: The buffer the certificate is stored in\n\
+               passphrase (Optional) - The password to decrypt the PKCS12 lump\n\
+@returns: The PKCS12 object\n\
+";
+
+static PyObject *
+crypto_load_pkcs12(PyObject *spam, PyObject *args)
+{
+    Py_buffer buffer;
+    char *passphrase = NULL;
+    BIO *bio;
+    PKCS12 *p12;
+
+    if (!PyArg_ParseTuple(args, BUFFER_FMT "|s:load_pkcs12", &buffer, &passphrase))
+        return NULL;
+
+    if ((bio = crypto_buffer_to_bio(&buffer)) == NULL)
+    {
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    p12 = d2i_PKCS12_bio(bio, NULL);
+    BIO_free(bio);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&buffer);
+
+    if (p12 == NULL)
+    {
+      exception_from_error_queue(crypto_Error);
+      return NULL;
+    }
+
+    return (PyObject *)crypto_PKCS12_New(p12, passphrase);
+}
+
+
+static char crypto_X509_verify_cert_error_string_doc[] = "\n\
+Get X509 verify certificate error string.\n\
+\n\
+@param errnum: The error number.\n\
+@return: Error string as a Python string\n\
+";
+
+static PyObject *
+crypto_X509_verify_cert_error_string(PyObject *spam, PyObject *args)
+{
+    int errnum;
+    const char *str;
+
+    if (!PyArg_ParseTuple(args, "i", &errnum))
+        return NULL;
+
+    str = X509_verify_cert_error_string(errnum);
+    return PyText_FromString(str);
+}
+
+struct verify_many_work {
+    X509_STORE *store;
+    STACK_OF(X509) *certs;
+    STACK_OF(X509) *untrusted;
+    int *results;
+};
+
+static void
+verify_many_worker(pool_t *pool, void *arg) {
+    struct verify_many_work *work = arg;
+    Py_ssize_t i;
+
+    while ((i = pool_next(pool)) >= 0) {
+        work->results[i] = crypto_X509Store_verify_cert(
+            work->store, sk_X509_value(work->certs, (int)i), work->untrusted, NULL);
+    }
+}
+
+static char crypto_verify_many_doc[] = "\n\
+Verify many certificates against a certificate store, using a pool of native\n\
+threads which run without holding the GIL.\n\
+\n\
+@param store: The X509Store to verify against\n\
+@param certs: A sequence of X509 objects to verify\n\
+@param chain: (optional) a sequence of untrusted intermediate certificates\n\
+              which may be used to build the chains\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: A list of verification results, one per certificate, each 0\n\
+         (X509_V_OK) if the certificate is valid or one of the X509_V_*\n\
+         error codes otherwise.\n\
+";
+
+static PyObject *
+crypto_verify_many(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    crypto_X509StoreObj *store;
+    PyObject *certs_seq, *untrusted_seq = Py_None, *results = NULL, *item;
+    struct verify_many_work work;
+    int threads = 0, failed = 0;
+    Py_ssize_t i, n;
+
+    static char *kwlist[] = {"store", "certs", "chain", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O|Oi:verify_many", kwlist,
+                                     &crypto_X509Store_Type, &store, &certs_seq,
+                                     &untrusted_seq, &threads))
+        return NULL;
+
+    work.store = store->x509_store;
+    work.untrusted = NULL;
+    work.results = NULL;
+    if ((work.certs = crypto_X509_sequence_to_stack(certs_seq)) == NULL)
+        return NULL;
+    if (untrusted_seq != Py_None &&
+        (work.untrusted = crypto_X509_sequence_to_stack(untrusted_seq)) == NULL)
+        goto done;
+
+    n = sk_X509_num(work.certs);
+    if ((work.results = PyMem_New(int, n > 0 ? n : 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, verify_many_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    for (i = 0; i < n; i++) {
+        if (work.results[i] < 0)
+            failed = 1;
+    }
+    if (failed) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    if ((results = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0; i < n; i++) {
+        if ((item = PyLong_FromLong(work.results[i])) == NULL) {
+            Py_DECREF(results);
+            results = NULL;
+            goto done;
+        }
+        PyList_SET_ITEM(results, i, item);
+    }
+
+  done:
+    PyMem_Free(work.results);
+    sk_X509_pop_free(work.certs, X509_free);
+    sk_X509_pop_free(work.untrusted, X509_free);
+    return results;
+}
+
+struct fingerprint_many_work {
+    STACK_OF(X509) *certs;
+    const EVP_MD *digest;
+    unsigned char *fingerprints;    /* EVP_MD_size(digest) bytes per cert */
+    unsigned long *errors;          /* Error code per cert, 0 on success */
+};
+
+static void
+fingerprint_many_worker(pool_t *pool, void *arg) {
+    struct fingerprint_many_work *work = arg;
+    unsigned int size = EVP_MD_size(work->digest), len;
+    Py_ssize_t i;
+
+    while ((i = pool_next(pool)) >= 0) {
+        if (X509_digest(sk_X509_value(work->certs, (int)i), work->digest,
+                        work->fingerprints + i * size, &len)) {
+            work->errors[i] = 0;
+        } else {
+            work->errors[i] = last_error_code(ERR_LIB_X509);
+        }
+        ERR_clear_error();
+    }
+}
+
+static char crypto_fingerprint_many_doc[] = "\n\
+Compute the digests of the DER encoding of many certificates, using a pool\n\
+of native threads which run without holding the GIL.\n\
+\n\
+@param certs: A sequence of X509 objects\n\
+@param digest: message digest to use\n\
+@param joined: (optional) if true, return all the digests one after another\n\
+               in a single string instead of a list\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: A list of raw digests, one per certificate, or their concatenation\n\
+";
+
+static PyObject *
+crypto_fingerprint_many(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    PyObject *certs_seq, *block = NULL, *result = NULL, *item;
+    struct fingerprint_many_work work;
+    int joined = 0, threads = 0;
+    Py_ssize_t i, n, size;
+
+    static char *kwlist[] = {"certs", "digest", "joined", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO&|ii:fingerprint_many",
+                                     kwlist, &certs_seq,
+                                     crypto_digest_converter, &work.digest,
+                                     &joined, &threads))
+        return NULL;
+
+    work.errors = NULL;
+    if ((work.certs = crypto_X509_sequence_to_stack(certs_seq)) == NULL)
+        return NULL;
+
+    n = sk_X509_num(work.certs);
+    size = EVP_MD_size(work.digest);
+    /* The digests are written straight into the string that is returned */
+    if ((block = PyBytes_FromStringAndSize(NULL, n * size)) == NULL)
+        goto done;
+    work.fingerprints = (unsigned char *)PyBytes_AS_STRING(block);
+    if ((work.errors = PyMem_New(unsigned long, n > 0 ? n : 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, fingerprint_many_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    for (i = 0; i < n; i++) {
+        if (work.errors[i] != 0) {
+            exception_from_error_code(crypto_Error, work.errors[i]);
+            goto done;
+        }
+    }
+
+    if (joined) {
+        result = block;
+        block = NULL;
+        goto done;
+    }
+
+    if ((result = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0; i < n; i++) {
+        item = PyBytes_FromStringAndSize((char *)work.fingerprints + i * size,
+                                         size);
+        if (item == NULL) {
+            Py_DECREF(result);
+            result = NULL;
+            goto done;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+
+  done:
+    Py_XDECREF(block);
+    PyMem_Free(work.errors);
+    sk_X509_pop_free(work.certs, X509_free);
+    return result;
+}
+
+/*
+ * The value of one field of one certificate, as read by extract_fields
+ * without holding the GIL.  Owned data is freed when it is converted.
+ */
+enum {
+    VALUE_NONE = 0,
+    VALUE_ERROR,
+    VALUE_INTEGER,
+    VALUE_BYTES,            /* str.data allocated by OpenSSL */
+    VALUE_STATIC_BYTES,     /* str.data not owned */
+    VALUE_TEXT,             /* UTF-8 str.data allocated by OpenSSL */
+    VALUE_HEX,              /* Hexadecimal integer allocated by OpenSSL */
+    VALUE_NAMES
+};
+
+struct field_value {
+    int kind;
+    union {
+        PY_LONG_LONG integer;
+        struct {
+            char *data;
+            int len;
+        } str;
+        GENERAL_NAMES *names;
+        unsigned long error;
+    } u;
+};
+
+static void
+value_error(struct field_value *value) {
+    value->kind = VALUE_ERROR;
+    value->u.error = last_error_code(ERR_LIB_X509);
+}
+
+static void
+value_string(struct field_value *value, int kind, char *data, int len) {
+    if (data == NULL) {
+        value_error(value);
+        return;
+    }
+    value->kind = kind;
+    value->u.str.data = data;
+    value->u.str.len = len;
+}
+
+static void
+value_integer(struct field_value *value, PY_LONG_LONG integer) {
+    value->kind = VALUE_INTEGER;
+    value->u.integer = integer;
+}
+
+static void
+value_free(struct field_value *value) {
+    switch (value->kind) {
+        case VALUE_BYTES:
+        case VALUE_TEXT:
+        case VALUE_HEX:
+            OPENSSL_free(value->u.str.data);
+            break;
+        case VALUE_NAMES:
+            GENERAL_NAMES_free(value->u.names);
+            break;
+    }
+    value->kind = VALUE_NONE;
+}
+
+/*
+ * Convert a field value to Python and free it
+ *
+ * Arguments: value - The field value
+ * Returns:   A new reference to the Python value, or NULL on error
+ */
+static PyObject *
+value_to_object(struct field_value *value) {
+    PyObject *result = NULL;
+
+    switch (value->kind) {
+        case VALUE_NONE:
+            Py_INCREF(Py_None);
+            result = Py_None;
+            break;
+        case VALUE_ERROR:
+            exception_from_error_code(crypto_Error, value->u.error);
+            break;
+        case VALUE_INTEGER:
+            result = PyLong_FromLongLong(value->u.integer);
+            break;
+        case VALUE_BYTES:
+        case VALUE_STATIC_BYTES:
+            result = PyBytes_FromStringAndSize(value->u.str.data,
+                                               value->u.str.len);
+            break;
+        case VALUE_TEXT:
+            result = PyUnicode_Decode(value->u.str.data, value->u.str.len,
+                                      "utf-8", NULL);
+            break;
+        case VALUE_HEX:
+            result = PyLong_FromString(value->u.str.data, NULL, 16);
             break;
+        case VALUE_NAMES:
+            result = crypto_GeneralNames_to_list(value->u.names);
+            break;
+    }
+    value_free(value);
+    return result;
+}
+
+static void
+extract_name(X509_NAME *name, struct field_value *value) {
+    char *oneline = X509_NAME_oneline(name, NULL, 0);
+
+    value_string(value, VALUE_BYTES, oneline, oneline ? strlen(oneline) : 0);
+}
+
+static void
+extract_common_name(X509_NAME *name, struct field_value *value) {
+    unsigned char *utf8string;
+    int i, len;
+
+    if ((i = X509_NAME_get_index_by_NID(name, NID_commonName, -1)) < 0)
+        return;
+    len = ASN1_STRING_to_UTF8(
+        &utf8string, X509_NAME_ENTRY_get_data(X509_NAME_get_entry(name, i)));
+    if (len < 0)
+        value_error(value);
+    else
+        value_string(value, VALUE_TEXT, (char *)utf8string, len);
+}
+
+static void
+extract_time(const ASN1_TIME *when, struct field_value *value) {
+    ASN1_GENERALIZEDTIME *gt_when;
+    char *data;
+    int len;
+
+    if (when == NULL || ASN1_STRING_length(when) == 0)
+        return;
+    if ((gt_when = ASN1_TIME_to_generalizedtime(when, NULL)) == NULL) {
+        value_error(value);
+        return;
+    }
+    len = ASN1_STRING_length(gt_when);
+    data = OPENSSL_strndup((const char *)ASN1_STRING_get0_data(gt_when), len);
+    ASN1_GENERALIZEDTIME_free(gt_when);
+    value_string(value, VALUE_BYTES, data, len);
+}
+
+static void
+extract_subject(X509 *cert, struct field_value *value) {
+    extract_name(X509_get_subject_name(cert), value);
+}
+
+static void
+extract_issuer(X509 *cert, struct field_value *value) {
+    extract_name(X509_get_issuer_name(cert), value);
+}
+
+static void
+extract_subject_cn(X509 *cert, struct field_value *value) {
+    extract_common_name(X509_get_subject_name(cert), value);
+}
+
+static void
+extract_issuer_cn(X509 *cert, struct field_value *value) {
+    extract_common_name(X509_get_issuer_name(cert), value);
+}
+
+static void
+extract_serial_number(X509 *cert, struct field_value *value) {
+    BIGNUM *bignum;
+    char *hex = NULL;
+
+    if ((bignum = ASN1_INTEGER_to_BN(X509_get0_serialNumber(cert), NULL)) != NULL) {
+        hex = BN_bn2hex(bignum);
+        BN_free(bignum);
+    }
+    value_string(value, VALUE_HEX, hex, 0);
+}
+
+static void
+extract_not_before(X509 *cert, struct field_value *value) {
+    extract_time(X509_get0_notBefore(cert), value);
+}
+
+static void
+extract_not_after(X509 *cert, struct field_value *value) {
+    extract_time(X509_get0_notAfter(cert), value);
+}
 
-        case X509_FILETYPE_ASN1:
-            pkcs7 = d2i_PKCS7_bio(bio, NULL);
-            break;
+static void
+extract_key_type(X509 *cert, struct field_value *value) {
+    EVP_PKEY *pkey = X509_get0_pubkey(cert);
 
-        default:
-            PyErr_SetString(PyExc_ValueError,
-                    "type argument must be FILETYPE_PEM or FILETYPE_ASN1");
-            return NULL;
-    }
-    BIO_free(bio);
+    if (pkey != NULL)
+        value_integer(value, EVP_PKEY_base_id(pkey));
+}
 
-    /*
-     * Check if we got a PKCS7 structure
-     */
-    if (pkcs7 == NULL)
-    {
-        exception_from_error_queue(crypto_Error);
-        return NULL;
-    }
+static void
+extract_key_bits(X509 *cert, struct field_value *value) {
+    EVP_PKEY *pkey = X509_get0_pubkey(cert);
 
-    return (PyObject *)crypto_PKCS7_New(pkcs7, 1);
+    if (pkey != NULL)
+        value_integer(value, EVP_PKEY_bits(pkey));
 }
 
-static char crypto_load_pkcs12_doc[] = "\n\
-Load a PKCS12 object from a buffer\n\
-\n\
-@param buffer: The buffer the certificate is stored in\n\
-               passphrase (Optional) - The password to decrypt the PKCS12 lump\n\
-@returns: The PKCS12 object\n\
-";
+static void
+extract_signature_algorithm(X509 *cert, struct field_value *value) {
+    int nid = X509_get_signature_nid(cert);
+    const char *name;
 
-static PyObject *
-crypto_load_pkcs12(PyObject *spam, PyObject *args)
-{
-    int len;
-    char *buffer, *passphrase = NULL;
-    BIO *bio;
-    PKCS12 *p12;
+    if (nid != NID_undef && (name = OBJ_nid2sn(nid)) != NULL)
+        value_string(value, VALUE_STATIC_BYTES, (char *)name, strlen(name));
+}
 
-    if (!PyArg_ParseTuple(args, "s#|s:load_pkcs12", &buffer, &len, &passphrase))
-        return NULL;
+static void
+extract_subject_alt_name(X509 *cert, struct field_value *value) {
+    GENERAL_NAMES *names = X509_get_ext_d2i(cert, NID_subject_alt_name,
+                                            NULL, NULL);
 
-    bio = BIO_new_mem_buf(buffer, len);
-    if ((p12 = d2i_PKCS12_bio(bio, NULL)) == NULL)
-    {
-      BIO_free(bio);
-      exception_from_error_queue(crypto_Error);
-      return NULL;
+    if (names != NULL) {
+        value->kind = VALUE_NAMES;
+        value->u.names = names;
     }
-    BIO_free(bio);
+}
 
-    return (PyObject *)crypto_PKCS12_New(p12, passphrase);
+static void
+extract_version(X509 *cert, struct field_value *value) {
+    value_integer(value, X509_get_version(cert));
 }
 
+static void
+extract_subject_name_hash(X509 *cert, struct field_value *value) {
+    value_integer(value, X509_subject_name_hash(cert));
+}
 
-static char crypto_X509_verify_cert_error_string_doc[] = "\n\
-Get X509 verify certificate error string.\n\
+/* The fields extract_fields knows about, each read without the GIL */
+static const struct extract_field {
+    const char *name;
+    void (*extract)(X509 *cert, struct field_value *value);
+} extract_fields_table[] = {
+    { "subject", extract_subject },
+    { "issuer", extract_issuer },
+    { "subject_cn", extract_subject_cn },
+    { "issuer_cn", extract_issuer_cn },
+    { "serial_number", extract_serial_number },
+    { "not_before", extract_not_before },
+    { "not_after", extract_not_after },
+    { "key_type", extract_key_type },
+    { "key_bits", extract_key_bits },
+    { "signature_algorithm", extract_signature_algorithm },
+    { "subject_alt_name", extract_subject_alt_name },
+    { "version", extract_version },
+    { "subject_name_hash", extract_subject_name_hash },
+    { NULL, NULL }
+};
+
+/*
+ * A certificate to extract fields from: either an X509 object, which can't be
+ * modified until the workers are done, or the encoding kept by a CompactX509
+ * object, decoded by the worker
+ */
+struct extract_cert {
+    crypto_X509Obj *x509;
+    crypto_CompactX509Obj *compact;
+};
+
+struct extract_fields_work {
+    struct extract_cert *certs;
+    const struct extract_field **fields;
+    Py_ssize_t nfields;
+    struct field_value *values;     /* nfields values per cert */
+};
+
+static void
+extract_fields_worker(pool_t *pool, void *arg) {
+    struct extract_fields_work *work = arg;
+    struct field_value *values;
+    const unsigned char *p;
+    X509 *cert;
+    Py_ssize_t i, j;
+
+    while ((i = pool_next(pool)) >= 0) {
+        values = work->values + i * work->nfields;
+        if (work->certs[i].x509 != NULL) {
+            cert = work->certs[i].x509->x509;
+        } else {
+            p = work->certs[i].compact->der;
+            cert = d2i_X509(NULL, &p, Py_SIZE(work->certs[i].compact));
+        }
+        for (j = 0; j < work->nfields; j++) {
+            if (cert == NULL)
+                value_error(&values[j]);
+            else
+                work->fields[j]->extract(cert, &values[j]);
+        }
+        if (work->certs[i].x509 == NULL)
+            X509_free(cert);
+        ERR_clear_error();
+    }
+}
+
+static char crypto_extract_fields_doc[] = "\n\
+Read fields from many certificates, using a pool of native threads which run\n\
+without holding the GIL.\n\
 \n\
-@param errnum: The error number.\n\
-@return: Error string as a Python string\n\
+@param certs: A sequence of X509 or CompactX509 objects\n\
+@param fields: A sequence of field names, among subject, issuer, subject_cn,\n\
+               issuer_cn, serial_number, not_before, not_after, key_type,\n\
+               key_bits, signature_algorithm, subject_alt_name, version and\n\
+               subject_name_hash\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: A dict mapping each field name to the list of its values, one per\n\
+         certificate, with None where a certificate doesn't have the field\n\
 ";
 
 static PyObject *
-crypto_X509_verify_cert_error_string(PyObject *spam, PyObject *args)
-{
-    int errnum;
-    const char *str;
-
-    if (!PyArg_ParseTuple(args, "i", &errnum))
+crypto_extract_fields(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    PyObject *certs, *fields, *certs_seq = NULL, *fields_seq = NULL;
+    PyObject *result = NULL, *column, *item;
+    struct extract_fields_work work;
+    const struct extract_field *field;
+    char *name;
+    int threads = 0;
+    Py_ssize_t i, j, n = 0;
+
+    static char *kwlist[] = {"certs", "fields", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i:extract_fields",
+                                     kwlist, &certs, &fields, &threads))
         return NULL;
 
-    str = X509_verify_cert_error_string(errnum);
-    return PyText_FromString(str);
+    work.certs = NULL;
+    work.fields = NULL;
+    work.values = NULL;
+
+    fields_seq = PySequence_Fast(fields, "Expected a sequence of field names");
+    if (fields_seq == NULL)
+        goto done;
+    work.nfields = PySequence_Fast_GET_SIZE(fields_seq);
+    if ((work.fields = PyMem_New(const struct extract_field *,
+                                 work.nfields > 0 ? work.nfields : 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (j = 0; j < work.nfields; j++) {
+        if (!PyArg_Parse(PySequence_Fast_GET_ITEM(fields_seq, j),
+                         "s:extract_fields", &name))
+            goto done;
+        for (field = extract_fields_table; field->name != NULL; field++) {
+            if (strcmp(field->name, name) == 0)
+                break;
+        }
+        if (field->name == NULL) {
+            PyErr_Format(PyExc_ValueError, "Unknown field %s", name);
+            goto done;
+        }
+        work.fields[j] = field;
+    }
+
+    certs_seq = PySequence_Fast(
+        certs, "Expected a sequence of X509 or CompactX509 objects");
+    if (certs_seq == NULL)
+        goto done;
+    n = PySequence_Fast_GET_SIZE(certs_seq);
+    if (work.nfields > 0 && n > PY_SSIZE_T_MAX / work.nfields) {
+        PyErr_NoMemory();
+        n = 0;
+        goto done;
+    }
+    if ((work.certs = PyMem_New(struct extract_cert, n > 0 ? n : 1)) == NULL ||
+        (work.values = PyMem_New(struct field_value,
+                                 n * work.nfields > 0 ? n * work.nfields : 1)) == NULL) {
+        PyErr_NoMemory();
+        n = 0;
+        goto done;
+    }
+    memset(work.values, 0, sizeof(struct field_value) * n * work.nfields);
+
+    /*
+     * Hold references to the certificates, in case the sequence is changed
+     * while the GIL is released.  Other threads can't modify the X509 objects
+     * until the workers are done, and names changed before are encoded again
+     * now, which hashing them would otherwise do in the workers.
+     */
+    for (i = 0; i < n; i++) {
+        item = PySequence_Fast_GET_ITEM(certs_seq, i);
+        work.certs[i].x509 = NULL;
+        work.certs[i].compact = NULL;
+        if (crypto_X509_Check(item)) {
+            work.certs[i].x509 = (crypto_X509Obj *)item;
+            work.certs[i].x509->in_use++;
+            Py_INCREF(item);
+            i2d_X509_NAME(X509_get_subject_name(work.certs[i].x509->x509), NULL);
+            i2d_X509_NAME(X509_get_issuer_name(work.certs[i].x509->x509), NULL);
+            ERR_clear_error();
+        } else if (crypto_CompactX509_Check(item)) {
+            work.certs[i].compact = (crypto_CompactX509Obj *)item;
+            Py_INCREF(item);
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "Expected a sequence of X509 or CompactX509 objects");
+            n = i;
+            goto done;
+        }
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, extract_fields_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if ((result = PyDict_New()) == NULL)
+        goto done;
+    for (j = 0; j < work.nfields; j++) {
+        if ((column = PyList_New(n)) == NULL)
+            goto error;
+        for (i = 0; i < n; i++) {
+            if ((item = value_to_object(&work.values[i * work.nfields + j])) == NULL) {
+                Py_DECREF(column);
+                goto error;
+            }
+            PyList_SET_ITEM(column, i, item);
+        }
+        if (PyDict_SetItemString(result, work.fields[j]->name, column) < 0) {
+            Py_DECREF(column);
+            goto error;
+        }
+        Py_DECREF(column);
+    }
+    goto done;
+
+  error:
+    Py_CLEAR(result);
+
+  done:
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < work.nfields; j++)
+            value_free(&work.values[i * work.nfields + j]);
+        if (work.certs[i].x509 != NULL) {
+            work.certs[i].x509->in_use--;
+            Py_DECREF(work.certs[i].x509);
+        }
+        Py_XDECREF(work.certs[i].compact);
+    }
+    PyMem_Free(work.values);
+    PyMem_Free(work.certs);
+    PyMem_Free(work.fields);
+    Py_XDECREF(certs_seq);
+    Py_XDECREF(fields_seq);
+    return result;
 }
 
 static char crypto_exception_from_error_queue_doc[] = "\n\
@@ -608,47 +1824,60 @@ static char crypto_sign_doc[] = "\n\
 Sign data with a digest\n\
 \n\
 @param pkey: Pkey to sign with\n\
-@param data: data to be signed\n\
-@param digest: message digest to use\n\
+@param data: data to be signed, any object supporting the buffer protocol\n\
+@param digest: message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
 @return: signature\n\
 ";
 
 static PyObject *
 crypto_sign(PyObject *spam, PyObject *args) {
-    PyObject *buffer;
+    PyObject *signature;
     crypto_PKeyObj *pkey;
-    char *data = NULL;
-    char *digest_name;
+    Py_buffer data;
     int err;
-    unsigned int sig_len;
+    size_t sig_len;
     const EVP_MD *digest;
-    unsigned char sig_buf[512];
+    EVP_MD_CTX *md_ctx;
+    EVP_PKEY *key;
 
     if (!PyArg_ParseTuple(
-            args, "O!" BYTESTRING_FMT "s:sign", &crypto_PKey_Type,
-            &pkey, &data, &digest_name)) {
+            args, "O!" BUFFER_FMT "O&:sign", &crypto_PKey_Type,
+            &pkey, &data, crypto_sign_digest_converter, &digest)) {
         return NULL;
     }
 
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL) {
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
+    sig_len = EVP_PKEY_size(pkey->pkey);
+    if ((signature = PyBytes_FromStringAndSize(NULL, sig_len)) == NULL) {
+        PyBuffer_Release(&data);
         return NULL;
     }
 
-    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
-    EVP_SignInit(md_ctx, digest);
-    EVP_SignUpdate(md_ctx, data, strlen(data));
-    sig_len = sizeof(sig_buf);
-    err = EVP_SignFinal(md_ctx, sig_buf, &sig_len, pkey->pkey);
-    EVP_MD_CTX_free(md_ctx);
+    /* Another thread may replace the key while the GIL is released */
+    key = pkey->pkey;
+    EVP_PKEY_up_ref(key);
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if ((md_ctx = EVP_MD_CTX_new()) != NULL) {
+        err = crypto_digest_sign(md_ctx, key, digest, data.buf, data.len,
+                                 (unsigned char *)PyBytes_AS_STRING(signature),
+                                 &sig_len);
+        EVP_MD_CTX_free(md_ctx);
+    } else {
+        err = 0;
+    }
+    EVP_PKEY_free(key);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&data);
 
-    if (err != 1) {
+    if (!err) {
+        Py_DECREF(signature);
         exception_from_error_queue(crypto_Error);
         return NULL;
     }
 
-    buffer = PyBytes_FromStringAndSize((char*)sig_buf, sig_len);
-    return buffer;
+    if (_PyBytes_Resize(&signature, sig_len) < 0)
+        return NULL;
+    return signature;
 }
 
 static char crypto_verify_doc[] = "\n\
@@ -656,54 +1885,502 @@ Verify a signature\n\
 \n\
 @param cert: signing certificate (X509 object)\n\
 @param signature: signature returned by sign function\n\
-@param data: data to be verified\n\
-@param digest: message digest to use\n\
+@param data: data to be verified, any object supporting the buffer protocol\n\
+@param digest: message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
 @return: None if the signature is correct, raise exception otherwise\n\
 ";
 
 static PyObject *
 crypto_verify(PyObject *spam, PyObject *args) {
     crypto_X509Obj *cert;
-    unsigned char *signature;
-    int sig_len;
-    char *data, *digest_name;
+    Py_buffer signature, data;
     int err;
     const EVP_MD *digest;
+    EVP_MD_CTX *md_ctx;
     EVP_PKEY *pkey;
 
-#ifdef PY3
-    if (!PyArg_ParseTuple(args, "O!" BYTESTRING_FMT "#" BYTESTRING_FMT "s:verify", &crypto_X509_Type, &cert, &signature, &sig_len, &data, &digest_name)) {
-#else
-    if (!PyArg_ParseTuple(args, "O!t#ss:verify", &crypto_X509_Type, &cert, &signature, &sig_len, &data, &digest_name)) {
-#endif
-        return NULL;
-    }
-
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL){
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
+    if (!PyArg_ParseTuple(args, "O!" BUFFER_FMT BUFFER_FMT "O&:verify",
+                          &crypto_X509_Type, &cert, &signature, &data,
+                          crypto_sign_digest_converter, &digest)) {
         return NULL;
     }
 
     pkey = X509_get_pubkey(cert->x509);
     if (pkey == NULL) {
         PyErr_SetString(PyExc_ValueError, "No public key");
-        return NULL;
+        goto error;
     }
 
-    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
-    EVP_VerifyInit(md_ctx, digest);
-    EVP_VerifyUpdate(md_ctx, data, strlen((char*)data));
-    err = EVP_VerifyFinal(md_ctx, signature, sig_len, pkey);
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    if ((md_ctx = EVP_MD_CTX_new()) != NULL) {
+        err = crypto_digest_verify(md_ctx, pkey, digest,
+                                   signature.buf, signature.len,
+                                   data.buf, data.len);
+        EVP_MD_CTX_free(md_ctx);
+    } else {
+        err = 0;
+    }
     EVP_PKEY_free(pkey);
-    EVP_MD_CTX_free(md_ctx);
+    MY_END_ALLOW_THREADS(ignored);
+    PyBuffer_Release(&signature);
+    PyBuffer_Release(&data);
 
-    if (err != 1) {
+    if (!err) {
         exception_from_error_queue(crypto_Error);
         return NULL;
     }
 
     Py_INCREF(Py_None);
     return Py_None;
+
+  error:
+    PyBuffer_Release(&signature);
+    PyBuffer_Release(&data);
+    return NULL;
+}
+
+/*
+ * Release the first n buffers of an array and free it
+ */
+static void
+release_buffers(Py_buffer *views, Py_ssize_t n) {
+    Py_ssize_t i;
+
+    for (i = 0; i < n; i++)
+        PyBuffer_Release(&views[i]);
+    PyMem_Free(views);
+}
+
+/*
+ * Get the buffers of all the items of a sequence, so they can be read with
+ * the GIL released
+ *
+ * Arguments: seq - A sequence, as returned by PySequence_Fast
+ * Returns:   An array of PySequence_Fast_GET_SIZE(seq) buffers, to be released
+ *            with release_buffers, or NULL with an exception set
+ */
+static Py_buffer *
+get_buffers(PyObject *seq) {
+    Py_ssize_t i, n = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *views;
+
+    if ((views = PyMem_New(Py_buffer, n > 0 ? n : 1)) == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &views[i],
+                               PyBUF_SIMPLE) < 0) {
+            release_buffers(views, i);
+            return NULL;
+        }
+    }
+    return views;
+}
+
+struct sign_many_work {
+    EVP_PKEY *pkey;
+    const EVP_MD *digest;
+    Py_buffer *messages;
+    unsigned char *signatures;  /* sig_size bytes per message */
+    size_t sig_size;
+    size_t *sig_lens;
+    unsigned long *errors;      /* Error code per message, 0 on success */
+};
+
+static void
+sign_many_worker(pool_t *pool, void *arg) {
+    struct sign_many_work *work = arg;
+    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
+    Py_ssize_t i;
+
+    while ((i = pool_next(pool)) >= 0) {
+        work->sig_lens[i] = work->sig_size;
+        if (md_ctx != NULL &&
+            crypto_digest_sign(md_ctx, work->pkey, work->digest,
+                               work->messages[i].buf, work->messages[i].len,
+                               work->signatures + i * work->sig_size,
+                               &work->sig_lens[i])) {
+            work->errors[i] = 0;
+        } else {
+            work->errors[i] = last_error_code(ERR_LIB_EVP);
+        }
+        ERR_clear_error();
+    }
+    EVP_MD_CTX_free(md_ctx);
+}
+
+static char crypto_sign_many_doc[] = "\n\
+Sign many messages with the same key and digest, using a pool of native\n\
+threads which run without holding the GIL.\n\
+\n\
+@param pkey: Pkey to sign with\n\
+@param messages: sequence of data to be signed, each any object supporting\n\
+                 the buffer protocol\n\
+@param digest: message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: list of signatures, one per message\n\
+";
+
+static PyObject *
+crypto_sign_many(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    crypto_PKeyObj *pkey;
+    PyObject *messages, *seq, *list = NULL, *item;
+    int threads = 0;
+    Py_ssize_t i, n;
+    struct sign_many_work work;
+
+    static char *kwlist[] = {"pkey", "messages", "digest", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!OO&|i:sign_many", kwlist,
+                                     &crypto_PKey_Type, &pkey, &messages,
+                                     crypto_sign_digest_converter, &work.digest,
+                                     &threads))
+        return NULL;
+
+    if ((seq = PySequence_Fast(messages, "Expected a sequence of messages")) == NULL)
+        return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if ((work.messages = get_buffers(seq)) == NULL) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    /* Another thread may replace the key while the GIL is released */
+    work.pkey = pkey->pkey;
+    EVP_PKEY_up_ref(work.pkey);
+    work.sig_size = EVP_PKEY_size(work.pkey);
+    work.signatures = NULL;
+    work.sig_lens = NULL;
+    work.errors = NULL;
+    if (work.sig_size > 0 &&
+        (size_t)n > (PY_SSIZE_T_MAX - 1) / work.sig_size) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    work.signatures = PyMem_Malloc(n * work.sig_size + 1);
+    work.sig_lens = PyMem_New(size_t, n + 1);
+    work.errors = PyMem_New(unsigned long, n + 1);
+    if (work.signatures == NULL || work.sig_lens == NULL || work.errors == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, sign_many_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    for (i = 0; i < n; i++) {
+        if (work.errors[i] != 0) {
+            exception_from_error_code(crypto_Error, work.errors[i]);
+            goto done;
+        }
+    }
+
+    if ((list = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0; i < n; i++) {
+        item = PyBytes_FromStringAndSize(
+            (char *)work.signatures + i * work.sig_size, work.sig_lens[i]);
+        if (item == NULL) {
+            Py_DECREF(list);
+            list = NULL;
+            goto done;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+
+  done:
+    EVP_PKEY_free(work.pkey);
+    PyMem_Free(work.signatures);
+    PyMem_Free(work.sig_lens);
+    PyMem_Free(work.errors);
+    release_buffers(work.messages, n);
+    Py_DECREF(seq);
+    return list;
+}
+
+/*
+ * Get the buffers of all the (signature, data) pairs of a sequence, so they
+ * can be read with the GIL released
+ *
+ * Arguments: seq - A sequence, as returned by PySequence_Fast
+ * Returns:   An array of 2 * PySequence_Fast_GET_SIZE(seq) buffers, the
+ *            signature and the data of each pair, to be released with
+ *            release_buffers, or NULL with an exception set
+ */
+static Py_buffer *
+get_pair_buffers(PyObject *seq) {
+    Py_ssize_t i, n = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *views;
+    PyObject *pair;
+    int ok;
+
+    if ((views = PyMem_New(Py_buffer, n > 0 ? 2 * n : 1)) == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        pair = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i),
+                               "Expected a sequence of (signature, data) pairs");
+        if (pair == NULL) {
+            release_buffers(views, 2 * i);
+            return NULL;
+        }
+        if (PySequence_Fast_GET_SIZE(pair) != 2) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Expected a sequence of (signature, data) pairs");
+            ok = 0;
+        } else if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(pair, 0),
+                                      &views[2 * i], PyBUF_SIMPLE) < 0) {
+            ok = 0;
+        } else if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(pair, 1),
+                                      &views[2 * i + 1], PyBUF_SIMPLE) < 0) {
+            PyBuffer_Release(&views[2 * i]);
+            ok = 0;
+        } else {
+            ok = 1;
+        }
+        Py_DECREF(pair);
+        if (!ok) {
+            release_buffers(views, 2 * i);
+            return NULL;
+        }
+    }
+    return views;
+}
+
+struct verify_signatures_work {
+    EVP_PKEY *pkey;
+    const EVP_MD *digest;
+    Py_buffer *pairs;           /* Signature and data of each item */
+    char *results;
+};
+
+static void
+verify_signatures_worker(pool_t *pool, void *arg) {
+    struct verify_signatures_work *work = arg;
+    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
+    Py_buffer *sig, *data;
+    Py_ssize_t i;
+
+    while ((i = pool_next(pool)) >= 0) {
+        sig = &work->pairs[2 * i];
+        data = &work->pairs[2 * i + 1];
+        work->results[i] = md_ctx != NULL &&
+            crypto_digest_verify(md_ctx, work->pkey, work->digest,
+                                 sig->buf, sig->len, data->buf, data->len);
+        ERR_clear_error();
+    }
+    EVP_MD_CTX_free(md_ctx);
+}
+
+static char crypto_verify_signatures_doc[] = "\n\
+Verify many signatures made with the key of the same certificate, using a\n\
+pool of native threads which run without holding the GIL.\n\
+\n\
+@param cert: signing certificate (X509 object)\n\
+@param signatures: sequence of (signature, data) pairs, each any object\n\
+                   supporting the buffer protocol\n\
+@param digest: message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: list of booleans, True for each valid signature\n\
+";
+
+static PyObject *
+crypto_verify_signatures(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    crypto_X509Obj *cert;
+    PyObject *signatures, *seq, *list = NULL;
+    int threads = 0;
+    Py_ssize_t i, n;
+    struct verify_signatures_work work;
+
+    static char *kwlist[] = {"cert", "signatures", "digest", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!OO&|i:verify_signatures",
+                                     kwlist, &crypto_X509_Type, &cert,
+                                     &signatures, crypto_sign_digest_converter,
+                                     &work.digest, &threads))
+        return NULL;
+
+    if ((seq = PySequence_Fast(signatures,
+                               "Expected a sequence of (signature, data) pairs")) == NULL)
+        return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if ((work.pairs = get_pair_buffers(seq)) == NULL) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    work.results = NULL;
+    if ((work.pkey = X509_get_pubkey(cert->x509)) == NULL) {
+        PyErr_SetString(PyExc_ValueError, "No public key");
+        goto done;
+    }
+    if ((work.results = PyMem_Malloc(n + 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, verify_signatures_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if ((list = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0; i < n; i++)
+        PyList_SET_ITEM(list, i, PyBool_FromLong(work.results[i]));
+
+  done:
+    if (work.pkey != NULL)
+        EVP_PKEY_free(work.pkey);
+    PyMem_Free(work.results);
+    release_buffers(work.pairs, 2 * n);
+    Py_DECREF(seq);
+    return list;
+}
+
+struct generate_keys_work {
+    crypto_key_spec spec;
+    EVP_PKEY **keys;
+    unsigned long *errors;      /* Error code per key, 0 on success */
+};
+
+static void
+generate_keys_worker(pool_t *pool, void *arg) {
+    struct generate_keys_work *work = arg;
+    Py_ssize_t i;
+
+    while ((i = pool_next(pool)) >= 0) {
+        work->keys[i] = crypto_PKey_generate(&work->spec);
+        if (work->keys[i] != NULL) {
+            work->errors[i] = 0;
+        } else {
+            work->errors[i] = last_error_code(ERR_LIB_EVP);
+        }
+        ERR_clear_error();
+    }
+}
+
+static char crypto_generate_keys_doc[] = "\n\
+Generate many keys of the same type and size, using a pool of native\n\
+threads which run without holding the GIL.\n\
+\n\
+@param type: The key type, as for PKey.generate_key\n\
+@param bits: The number of bits, or DSAParameters for DSA keys, or the\n\
+             curve for EC keys, or None for Ed25519 keys, as for\n\
+             PKey.generate_key\n\
+@param count: The number of keys to generate\n\
+@param threads: (optional) the number of threads to use, by default one per\n\
+                CPU\n\
+@return: list of count new PKey objects\n\
+";
+
+static PyObject *
+crypto_generate_keys(PyObject *spam, PyObject *args, PyObject *kwargs) {
+    PyObject *size, *list = NULL, *item;
+    int type, threads = 0;
+    Py_ssize_t i, n;
+    struct generate_keys_work work;
+
+    static char *kwlist[] = {"type", "bits", "count", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iOn|i:generate_keys", kwlist,
+                                     &type, &size, &n, &threads))
+        return NULL;
+
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "count must not be negative");
+        return NULL;
+    }
+    if (!crypto_PKey_parse_spec(type, size == Py_None ? NULL : size,
+                                &work.spec))
+        return NULL;
+
+    work.keys = PyMem_New(EVP_PKEY *, n + 1);
+    work.errors = PyMem_New(unsigned long, n + 1);
+    if (work.keys == NULL || work.errors == NULL) {
+        PyMem_Free(work.keys);
+        PyMem_Free(work.errors);
+        crypto_PKey_free_spec(&work.spec);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pool_run(n, threads, generate_keys_worker, &work);
+    MY_END_ALLOW_THREADS(ignored);
+
+    for (i = 0; i < n; i++) {
+        if (work.errors[i] != 0) {
+            exception_from_error_code(crypto_Error, work.errors[i]);
+            goto done;
+        }
+    }
+
+    if ((list = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0; i < n; i++) {
+        if ((item = (PyObject *)crypto_PKey_New(work.keys[i], 1)) == NULL) {
+            Py_DECREF(list);
+            list = NULL;
+            goto done;
+        }
+        /* The PKey object owns the key now */
+        work.keys[i] = NULL;
+        PyList_SET_ITEM(list, i, item);
+    }
+
+  done:
+    for (i = 0; i < n; i++)
+        if (work.keys[i] != NULL)
+            EVP_PKEY_free(work.keys[i]);
+    PyMem_Free(work.keys);
+    PyMem_Free(work.errors);
+    crypto_PKey_free_spec(&work.spec);
+    return list;
+}
+
+static char crypto_get_digest_doc[] = "\n\
+Look up a message digest by name.  The Digest object can be passed instead\n\
+of the name wherever a message digest is needed, which saves looking the\n\
+name up each time.\n\
+\n\
+@param name: The name of the message digest\n\
+@return: The Digest object, the same one for every name of the digest\n\
+";
+
+static PyObject *
+crypto_get_digest(PyObject *spam, PyObject *args) {
+    char *name;
+
+    if (!PyArg_ParseTuple(args, "s:get_digest", &name))
+        return NULL;
+
+    return crypto_Digest_Get(name);
+}
+
+static char crypto_get_cipher_doc[] = "\n\
+Look up a cipher by name.  The Cipher object can be passed instead of the\n\
+name wherever a cipher is needed, which saves looking the name up each time.\n\
+\n\
+@param name: The name of the cipher\n\
+@return: The Cipher object, the same one for every name of the cipher\n\
+";
+
+static PyObject *
+crypto_get_cipher(PyObject *spam, PyObject *args) {
+    char *name;
+
+    if (!PyArg_ParseTuple(args, "s:get_cipher", &name))
+        return NULL;
+
+    return crypto_Cipher_Get(name);
 }
 
 /* Methods in the OpenSSL.crypto module (i.e. none) */
@@ -712,14 +2389,31 @@ static PyMethodDef crypto_methods[] = {
     { "load_privatekey",  (PyCFunction)crypto_load_privatekey,  METH_VARARGS, crypto_load_privatekey_doc },
     { "dump_privatekey",  (PyCFunction)crypto_dump_privatekey,  METH_VARARGS, crypto_dump_privatekey_doc },
     { "load_certificate", (PyCFunction)crypto_load_certificate, METH_VARARGS, crypto_load_certificate_doc },
+    { "set_certificate_cache_size", (PyCFunction)crypto_set_certificate_cache_size, METH_VARARGS, crypto_set_certificate_cache_size_doc },
+    { "get_certificate_cache_info", (PyCFunction)crypto_get_certificate_cache_info, METH_VARARGS, crypto_get_certificate_cache_info_doc },
+    { "load_certificates", (PyCFunction)crypto_load_certificates, METH_VARARGS, crypto_load_certificates_doc },
+    { "iter_certificates", (PyCFunction)crypto_iter_certificates, METH_VARARGS, crypto_iter_certificates_doc },
     { "dump_certificate", (PyCFunction)crypto_dump_certificate, METH_VARARGS, crypto_dump_certificate_doc },
     { "load_certificate_request", (PyCFunction)crypto_load_certificate_request, METH_VARARGS, crypto_load_certificate_request_doc },
     { "dump_certificate_request", (PyCFunction)crypto_dump_certificate_request, METH_VARARGS, crypto_dump_certificate_request_doc },
+    { "dump_privatekey_into", (PyCFunction)crypto_dump_privatekey_into, METH_VARARGS, crypto_dump_privatekey_into_doc },
+    { "dump_certificate_into", (PyCFunction)crypto_dump_certificate_into, METH_VARARGS, crypto_dump_certificate_into_doc },
+    { "dump_certificate_request_into", (PyCFunction)crypto_dump_certificate_request_into, METH_VARARGS, crypto_dump_certificate_request_into_doc },
+    { "load_dsa_params", (PyCFunction)crypto_load_dsa_params, METH_VARARGS, crypto_load_dsa_params_doc },
+    { "dump_dsa_params", (PyCFunction)crypto_dump_dsa_params, METH_VARARGS, crypto_dump_dsa_params_doc },
     { "load_crl",         (PyCFunction)crypto_load_crl,         METH_VARARGS, crypto_load_crl_doc },
     { "load_pkcs7_data", (PyCFunction)crypto_load_pkcs7_data, METH_VARARGS, crypto_load_pkcs7_data_doc },
     { "load_pkcs12", (PyCFunction)crypto_load_pkcs12, METH_VARARGS, crypto_load_pkcs12_doc },
     { "sign", (PyCFunction)crypto_sign, METH_VARARGS, crypto_sign_doc },
     { "verify", (PyCFunction)crypto_verify, METH_VARARGS, crypto_verify_doc },
+    { "sign_many", (PyCFunction)crypto_sign_many, METH_VARARGS | METH_KEYWORDS, crypto_sign_many_doc },
+    { "verify_signatures", (PyCFunction)crypto_verify_signatures, METH_VARARGS | METH_KEYWORDS, crypto_verify_signatures_doc },
+    { "generate_keys", (PyCFunction)crypto_generate_keys, METH_VARARGS | METH_KEYWORDS, crypto_generate_keys_doc },
+    { "fingerprint_many", (PyCFunction)crypto_fingerprint_many, METH_VARARGS | METH_KEYWORDS, crypto_fingerprint_many_doc },
+    { "extract_fields", (PyCFunction)crypto_extract_fields, METH_VARARGS | METH_KEYWORDS, crypto_extract_fields_doc },
+    { "get_digest", (PyCFunction)crypto_get_digest, METH_VARARGS, crypto_get_digest_doc },
+    { "get_cipher", (PyCFunction)crypto_get_cipher, METH_VARARGS, crypto_get_cipher_doc },
+    { "verify_many", (PyCFunction)crypto_verify_many, METH_VARARGS | METH_KEYWORDS, crypto_verify_many_doc },
     { "X509_verify_cert_error_string", (PyCFunction)crypto_X509_verify_cert_error_string, METH_VARARGS, crypto_X509_verify_cert_error_string_doc },
     { "_exception_from_error_queue", (PyCFunction)crypto_exception_from_error_queue, METH_NOARGS, crypto_exception_from_error_queue_doc },
     { NULL, NULL }
@@ -857,10 +2551,13 @@ PyOpenSSL_MODINIT(crypto) {
 
     PyModule_AddIntConstant(module, "TYPE_RSA", crypto_TYPE_RSA);
     PyModule_AddIntConstant(module, "TYPE_DSA", crypto_TYPE_DSA);
+    PyModule_AddIntConstant(module, "TYPE_EC", crypto_TYPE_EC);
+    PyModule_AddIntConstant(module, "TYPE_ED25519", crypto_TYPE_ED25519);
 
 #ifdef WITH_THREAD
     if (!init_openssl_threads())
         goto error;
+    _pyOpenSSL_tstate_key = PyThread_create_key();
 #endif
     if (!init_crypto_x509(module))
         goto error;
@@ -884,6 +2581,18 @@ PyOpenSSL_MODINIT(crypto) {
         goto error;
     if (!init_crypto_revoked(module))
         goto error;
+    if (!init_crypto_x509iterator(module))
+        goto error;
+    if (!init_crypto_signer(module))
+        goto error;
+    if (!init_crypto_evp(module))
+        goto error;
+    if (!init_crypto_compactx509(module))
+        goto error;
+    if (!init_crypto_keypool(module))
+        goto error;
+    if (!init_crypto_dsaparameters(module))
+        goto error;
 
     PyOpenSSL_MODRETURN(module);
 
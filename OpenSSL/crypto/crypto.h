@@ -28,6 +28,7 @@
 #endif
 
 #include "x509.h"
+#include "x509iter.h"
 #include "x509name.h"
 #include "netscape_spki.h"
 #include "x509store.h"
@@ -38,10 +39,27 @@
 #include "pkcs12.h"
 #include "crl.h"
 #include "revoked.h"
+#include "signer.h"
+#include "evp.h"
+#include "certcache.h"
+#include "x509compact.h"
+#include "keypool.h"
+#include "dsaparams.h"
 #include "../util.h"
 
 extern PyObject *crypto_Error;
 
+#ifdef WITH_THREAD
+#include <pythread.h>
+
+/*
+ * The thread-local key MY_BEGIN_ALLOW_THREADS stores the saved thread state
+ * under, so that OpenSSL callbacks invoked while the GIL is released (the
+ * passphrase callback) can reacquire it.
+ */
+extern int _pyOpenSSL_tstate_key;
+#endif
+
 #define crypto_X509_New_NUM             0
 #define crypto_X509_New_RETURN          crypto_X509Obj *
 #define crypto_X509_New_PROTO           (X509 *, int)
@@ -94,6 +112,22 @@ extern crypto_PKCS7_New_RETURN     crypto_PKCS7_New     crypto_PKCS7_New_PROTO;
 extern crypto_NetscapeSPKI_New_RETURN  crypto_NetscapeSPKI_New  crypto_NetscapeSPKI_New_PROTO;
 
 int crypto_byte_converter(PyObject *input, void *output);
+BIO *crypto_buffer_to_bio(Py_buffer *view);
+PyObject *crypto_bio_to_bytes(BIO *bio, int ok);
+
+/*
+ * A caller supplied writable buffer, which the dump_*_into functions write
+ * to through a BIO.  Everything written is counted, even past the end of the
+ * buffer, so that passing None instead of a buffer tells the size needed.
+ */
+typedef struct {
+    Py_buffer  view;            /* view.buf is NULL when only counting */
+    Py_ssize_t written;
+    BIO        *bio;
+} crypto_OutputBuffer;
+
+int crypto_OutputBuffer_open(crypto_OutputBuffer *out, PyObject *obj);
+PyObject *crypto_OutputBuffer_close(crypto_OutputBuffer *out, int ok);
 
 #else /* crypto_MODULE */
 
@@ -0,0 +1,185 @@
+/*
+ * dsaparams.c
+ *
+ * See LICENSE for details.
+ *
+ * DSA domain parameters, which are expensive to generate but can be shared
+ * by any number of keys, so that generating a DSA key from them only takes
+ * generating the key itself.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+/*
+ * Constructor for DSAParameters objects, never called by Python code directly
+ *
+ * Arguments: dsa - The DSA structure holding the parameters, which the
+ *                  DSAParameters object takes over
+ * Returns:   The newly created DSAParameters object, or NULL with an
+ *            exception set (dsa is freed then)
+ */
+crypto_DSAParametersObj *
+crypto_DSAParameters_New(DSA *dsa)
+{
+    crypto_DSAParametersObj *self;
+
+    self = PyObject_New(crypto_DSAParametersObj, &crypto_DSAParameters_Type);
+    if (self == NULL)
+    {
+        DSA_free(dsa);
+        return NULL;
+    }
+
+    self->dsa = dsa;
+    return self;
+}
+
+static char crypto_DSAParameters_bits_doc[] = "\n\
+Return the number of bits of the keys generated from the parameters\n\
+\n\
+@return: The number of bits of the prime p\n\
+";
+
+static PyObject *
+crypto_DSAParameters_bits(crypto_DSAParametersObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":bits"))
+        return NULL;
+
+    return PyLong_FromLong(DSA_bits(self->dsa));
+}
+
+/*
+ * ADD_METHOD(name) expands to a correct PyMethodDef declaration
+ *   {  'name', (PyCFunction)crypto_DSAParameters_name, METH_VARARGS }
+ * for convenience
+ */
+#define ADD_METHOD(name)        \
+    { #name, (PyCFunction)crypto_DSAParameters_##name, METH_VARARGS, crypto_DSAParameters_##name##_doc }
+static PyMethodDef crypto_DSAParameters_methods[] =
+{
+    ADD_METHOD(bits),
+    { NULL, NULL }
+};
+#undef ADD_METHOD
+
+
+static char crypto_DSAParameters_doc[] = "\n\
+DSAParameters(bits) -> DSAParameters instance\n\
+\n\
+Generate new DSA domain parameters.  Keys are generated from them by passing\n\
+them to PKey.generate_key, generate_keys or KeyPool instead of the number\n\
+of bits.\n\
+\n\
+@param bits: The number of bits of the prime p\n\
+@returns: The DSAParameters object\n\
+";
+
+static PyObject *
+crypto_DSAParameters_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    int bits, ok = 0;
+    DSA *dsa;
+
+    if (!PyArg_ParseTuple(args, "i:DSAParameters", &bits))
+        return NULL;
+
+    if ((dsa = DSA_new()) == NULL)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    /* This is the slow part of generating a DSA key */
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ok = DSA_generate_parameters_ex(dsa, bits, NULL, 0, NULL, NULL, NULL);
+    MY_END_ALLOW_THREADS(ignored);
+    if (!ok)
+    {
+        DSA_free(dsa);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return (PyObject *)crypto_DSAParameters_New(dsa);
+}
+
+/*
+ * Deallocate the memory used by the DSAParameters object
+ *
+ * Arguments: self - The DSAParameters object
+ * Returns:   None
+ */
+static void
+crypto_DSAParameters_dealloc(crypto_DSAParametersObj *self)
+{
+    DSA_free(self->dsa);
+    PyObject_Del(self);
+}
+
+PyTypeObject crypto_DSAParameters_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "DSAParameters",
+    sizeof(crypto_DSAParametersObj),
+    0,
+    (destructor)crypto_DSAParameters_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_DSAParameters_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_DSAParameters_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_DSAParameters_new, /* tp_new */
+};
+
+/*
+ * Initialize the DSAParameters part of the crypto module
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_dsaparameters(PyObject *module)
+{
+    if (PyType_Ready(&crypto_DSAParameters_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "DSAParameters", (PyObject *)&crypto_DSAParameters_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "DSAParametersType", (PyObject *)&crypto_DSAParameters_Type) != 0) {
+        return 0;
+    }
+
+    return 1;
+}
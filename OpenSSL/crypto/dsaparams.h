@@ -0,0 +1,33 @@
+/*
+ * dsaparams.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the DSA domain parameters type.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_DSAPARAMS_H_
+#define PyOpenSSL_crypto_DSAPARAMS_H_
+
+#include <Python.h>
+#include <openssl/dsa.h>
+
+extern  int       init_crypto_dsaparameters   (PyObject *);
+
+extern  PyTypeObject      crypto_DSAParameters_Type;
+
+#define crypto_DSAParameters_Check(v) ((v)->ob_type == &crypto_DSAParameters_Type)
+
+/*
+ * The parameters are never modified once created, so keys can be generated
+ * from them by several threads at once.
+ */
+typedef struct {
+    PyObject_HEAD
+    DSA                 *dsa;
+} crypto_DSAParametersObj;
+
+extern  crypto_DSAParametersObj *crypto_DSAParameters_New (DSA *);
+
+#endif
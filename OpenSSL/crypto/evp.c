@@ -0,0 +1,562 @@
+/*
+ * evp.c
+ *
+ * See LICENSE for details.
+ *
+ * Message digest and cipher handles.  Every name is resolved only once, the
+ * handles are interned so that all the names of a digest or cipher share the
+ * same object.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+/* Handles by the names they were asked for and by their canonical names */
+static PyObject *digest_cache = NULL;
+static PyObject *cipher_cache = NULL;
+
+/*
+ * Find the canonical name of a digest or cipher
+ *
+ * Arguments: nid  - The NID of the digest or cipher
+ *            name - The name it was looked up with, used if it has no NID
+ * Returns:   The canonical name
+ */
+static const char *
+canonical_name(int nid, const char *name)
+{
+    if (nid == NID_undef)
+        return name;
+    return OBJ_nid2sn(nid);
+}
+
+/*
+ * Store a handle in a cache under the name it was asked for, if that's not
+ * its canonical name already
+ *
+ * Arguments: cache     - The cache
+ *            name      - The name the handle was asked for
+ *            canonical - The canonical name of the handle
+ *            obj       - The handle, which is released on error
+ * Returns:   The handle, or NULL with an exception set
+ */
+static PyObject *
+cache_alias(PyObject *cache, const char *name, const char *canonical,
+            PyObject *obj)
+{
+    if (strcmp(name, canonical) != 0 &&
+        PyDict_SetItemString(cache, name, obj) < 0)
+    {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return obj;
+}
+
+/*
+ * Get the handle of a message digest
+ *
+ * Arguments: name - The name of the digest
+ * Returns:   A new reference to the handle, or NULL with an exception set
+ */
+PyObject *
+crypto_Digest_Get(const char *name)
+{
+    PyObject *obj;
+    crypto_DigestObj *self;
+    const EVP_MD *digest;
+    const char *canonical;
+
+    if ((obj = PyDict_GetItemString(digest_cache, name)) != NULL)
+    {
+        Py_INCREF(obj);
+        return obj;
+    }
+
+    if ((digest = EVP_get_digestbyname(name)) == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "No such digest method");
+        return NULL;
+    }
+
+    canonical = canonical_name(EVP_MD_type(digest), name);
+    if ((obj = PyDict_GetItemString(digest_cache, canonical)) != NULL)
+    {
+        Py_INCREF(obj);
+        return cache_alias(digest_cache, name, canonical, obj);
+    }
+
+    if ((self = PyObject_New(crypto_DigestObj, &crypto_Digest_Type)) == NULL)
+        return NULL;
+    self->digest = digest;
+    obj = (PyObject *)self;
+    if (PyDict_SetItemString(digest_cache, canonical, obj) < 0)
+    {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return cache_alias(digest_cache, name, canonical, obj);
+}
+
+/*
+ * Get the handle of a cipher
+ *
+ * Arguments: name - The name of the cipher
+ * Returns:   A new reference to the handle, or NULL with an exception set
+ */
+PyObject *
+crypto_Cipher_Get(const char *name)
+{
+    PyObject *obj;
+    crypto_CipherObj *self;
+    const EVP_CIPHER *cipher;
+    const char *canonical;
+
+    if ((obj = PyDict_GetItemString(cipher_cache, name)) != NULL)
+    {
+        Py_INCREF(obj);
+        return obj;
+    }
+
+    if ((cipher = EVP_get_cipherbyname(name)) == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "Invalid cipher name");
+        return NULL;
+    }
+
+    canonical = canonical_name(EVP_CIPHER_nid(cipher), name);
+    if ((obj = PyDict_GetItemString(cipher_cache, canonical)) != NULL)
+    {
+        Py_INCREF(obj);
+        return cache_alias(cipher_cache, name, canonical, obj);
+    }
+
+    if ((self = PyObject_New(crypto_CipherObj, &crypto_Cipher_Type)) == NULL)
+        return NULL;
+    self->cipher = cipher;
+    obj = (PyObject *)self;
+    if (PyDict_SetItemString(cipher_cache, canonical, obj) < 0)
+    {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return cache_alias(cipher_cache, name, canonical, obj);
+}
+
+/*
+ * Converter for the "O&" format, accepting a Digest object or the name of a
+ * message digest
+ *
+ * Arguments: obj    - The argument
+ *            output - Where to store the const EVP_MD pointer
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_digest_converter(PyObject *obj, void *output)
+{
+    const EVP_MD **digest = output;
+    char *name;
+
+    if (crypto_Digest_Check(obj))
+    {
+        *digest = ((crypto_DigestObj *)obj)->digest;
+        return 1;
+    }
+
+    if (!PyArg_Parse(obj, "s", &name))
+        return 0;
+    /* The cache keeps the handle alive */
+    if ((obj = crypto_Digest_Get(name)) == NULL)
+        return 0;
+    *digest = ((crypto_DigestObj *)obj)->digest;
+    Py_DECREF(obj);
+    return 1;
+}
+
+/*
+ * Converter for the "O&" format, accepting what crypto_digest_converter does
+ * or None, for signing with keys which don't take a separate digest, like
+ * Ed25519 keys
+ *
+ * Arguments: obj    - The argument
+ *            output - Where to store the const EVP_MD pointer, NULL for None
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_sign_digest_converter(PyObject *obj, void *output)
+{
+    if (obj == Py_None)
+    {
+        *(const EVP_MD **)output = NULL;
+        return 1;
+    }
+    return crypto_digest_converter(obj, output);
+}
+
+/*
+ * Converter for the "O&" format, accepting a Cipher object or the name of a
+ * cipher
+ *
+ * Arguments: obj    - The argument
+ *            output - Where to store the const EVP_CIPHER pointer
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_cipher_converter(PyObject *obj, void *output)
+{
+    const EVP_CIPHER **cipher = output;
+    char *name;
+
+    if (crypto_Cipher_Check(obj))
+    {
+        *cipher = ((crypto_CipherObj *)obj)->cipher;
+        return 1;
+    }
+
+    if (!PyArg_Parse(obj, "s", &name))
+        return 0;
+    /* The cache keeps the handle alive */
+    if ((obj = crypto_Cipher_Get(name)) == NULL)
+        return 0;
+    *cipher = ((crypto_CipherObj *)obj)->cipher;
+    Py_DECREF(obj);
+    return 1;
+}
+
+static char crypto_Digest_get_name_doc[] = "\n\
+Return the canonical name of the message digest\n\
+\n\
+@return: The name\n\
+";
+
+static PyObject *
+crypto_Digest_get_name(crypto_DigestObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_name"))
+        return NULL;
+
+    return PyText_FromString(canonical_name(EVP_MD_type(self->digest), "UNDEF"));
+}
+
+static char crypto_Digest_get_size_doc[] = "\n\
+Return the size of the message digest\n\
+\n\
+@return: The size in bytes\n\
+";
+
+static PyObject *
+crypto_Digest_get_size(crypto_DigestObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_size"))
+        return NULL;
+
+    return PyLong_FromLong(EVP_MD_size(self->digest));
+}
+
+static char crypto_Digest_get_block_size_doc[] = "\n\
+Return the block size of the message digest\n\
+\n\
+@return: The block size in bytes\n\
+";
+
+static PyObject *
+crypto_Digest_get_block_size(crypto_DigestObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_block_size"))
+        return NULL;
+
+    return PyLong_FromLong(EVP_MD_block_size(self->digest));
+}
+
+static char crypto_Cipher_get_name_doc[] = "\n\
+Return the canonical name of the cipher\n\
+\n\
+@return: The name\n\
+";
+
+static PyObject *
+crypto_Cipher_get_name(crypto_CipherObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_name"))
+        return NULL;
+
+    return PyText_FromString(canonical_name(EVP_CIPHER_nid(self->cipher), "UNDEF"));
+}
+
+static char crypto_Cipher_get_key_length_doc[] = "\n\
+Return the key length of the cipher\n\
+\n\
+@return: The key length in bytes\n\
+";
+
+static PyObject *
+crypto_Cipher_get_key_length(crypto_CipherObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_key_length"))
+        return NULL;
+
+    return PyLong_FromLong(EVP_CIPHER_key_length(self->cipher));
+}
+
+static char crypto_Cipher_get_iv_length_doc[] = "\n\
+Return the IV length of the cipher\n\
+\n\
+@return: The IV length in bytes\n\
+";
+
+static PyObject *
+crypto_Cipher_get_iv_length(crypto_CipherObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_iv_length"))
+        return NULL;
+
+    return PyLong_FromLong(EVP_CIPHER_iv_length(self->cipher));
+}
+
+static char crypto_Cipher_get_block_size_doc[] = "\n\
+Return the block size of the cipher\n\
+\n\
+@return: The block size in bytes\n\
+";
+
+static PyObject *
+crypto_Cipher_get_block_size(crypto_CipherObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_block_size"))
+        return NULL;
+
+    return PyLong_FromLong(EVP_CIPHER_block_size(self->cipher));
+}
+
+/*
+ * ADD_METHOD(name) expands to a correct PyMethodDef declaration
+ *   {  'name', (PyCFunction)crypto_Type_name, METH_VARARGS, crypto_Type_name_doc }
+ * for convenience
+ */
+#define ADD_METHOD(type, name)        \
+    { #name, (PyCFunction)crypto_##type##_##name, METH_VARARGS, crypto_##type##_##name##_doc }
+static PyMethodDef crypto_Digest_methods[] =
+{
+    ADD_METHOD(Digest, get_name),
+    ADD_METHOD(Digest, get_size),
+    ADD_METHOD(Digest, get_block_size),
+    { NULL, NULL }
+};
+
+static PyMethodDef crypto_Cipher_methods[] =
+{
+    ADD_METHOD(Cipher, get_name),
+    ADD_METHOD(Cipher, get_key_length),
+    ADD_METHOD(Cipher, get_iv_length),
+    ADD_METHOD(Cipher, get_block_size),
+    { NULL, NULL }
+};
+#undef ADD_METHOD
+
+static PyObject *
+crypto_Digest_repr(crypto_DigestObj *self)
+{
+    char realbuf[128];
+
+    /* Short names are much shorter than this */
+    PyOS_snprintf(realbuf, sizeof(realbuf), "<Digest object '%s'>",
+                  canonical_name(EVP_MD_type(self->digest), "UNDEF"));
+    return PyText_FromString(realbuf);
+}
+
+static PyObject *
+crypto_Cipher_repr(crypto_CipherObj *self)
+{
+    char realbuf[128];
+
+    PyOS_snprintf(realbuf, sizeof(realbuf), "<Cipher object '%s'>",
+                  canonical_name(EVP_CIPHER_nid(self->cipher), "UNDEF"));
+    return PyText_FromString(realbuf);
+}
+
+/*
+ * Deallocate the memory used by the Digest or Cipher object
+ *
+ * Arguments: self - The Digest or Cipher object
+ * Returns:   None
+ */
+static void
+crypto_EVP_dealloc(PyObject *self)
+{
+    PyObject_Del(self);
+}
+
+static char crypto_Digest_doc[] = "\n\
+Digest(name) -> Digest instance\n\
+\n\
+A message digest, as returned by get_digest.  It can be used wherever the\n\
+name of a message digest is accepted.\n\
+\n\
+@param name: The name of the message digest\n\
+@return: The Digest object, the same one for every name of the digest\n\
+";
+
+static PyObject *
+crypto_Digest_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    char *name;
+
+    static char *kwlist[] = {"name", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s:Digest", kwlist, &name))
+        return NULL;
+
+    /* Interned like the ones get_digest returns */
+    return crypto_Digest_Get(name);
+}
+
+static char crypto_Cipher_doc[] = "\n\
+Cipher(name) -> Cipher instance\n\
+\n\
+A cipher, as returned by get_cipher.  It can be used wherever the name of a\n\
+cipher is accepted.\n\
+\n\
+@param name: The name of the cipher\n\
+@return: The Cipher object, the same one for every name of the cipher\n\
+";
+
+static PyObject *
+crypto_Cipher_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    char *name;
+
+    static char *kwlist[] = {"name", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s:Cipher", kwlist, &name))
+        return NULL;
+
+    /* Interned like the ones get_cipher returns */
+    return crypto_Cipher_Get(name);
+}
+
+PyTypeObject crypto_Digest_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "Digest",
+    sizeof(crypto_DigestObj),
+    0,
+    (destructor)crypto_EVP_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    (reprfunc)crypto_Digest_repr,
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_Digest_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_Digest_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_Digest_new, /* tp_new */
+};
+
+PyTypeObject crypto_Cipher_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "Cipher",
+    sizeof(crypto_CipherObj),
+    0,
+    (destructor)crypto_EVP_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    (reprfunc)crypto_Cipher_repr,
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_Cipher_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_Cipher_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_Cipher_new, /* tp_new */
+};
+
+/*
+ * Initialize the Digest and Cipher part of the crypto module
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_evp(PyObject *module)
+{
+    if ((digest_cache = PyDict_New()) == NULL) {
+        return 0;
+    }
+
+    if ((cipher_cache = PyDict_New()) == NULL) {
+        return 0;
+    }
+
+    if (PyType_Ready(&crypto_Digest_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "Digest", (PyObject *)&crypto_Digest_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "DigestType", (PyObject *)&crypto_Digest_Type) != 0) {
+        return 0;
+    }
+
+    if (PyType_Ready(&crypto_Cipher_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "Cipher", (PyObject *)&crypto_Cipher_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "CipherType", (PyObject *)&crypto_Cipher_Type) != 0) {
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,41 @@
+/*
+ * evp.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the message digest and cipher handles and the argument converters
+ * accepting either a handle or a name.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_EVP_H_
+#define PyOpenSSL_crypto_EVP_H_
+
+#include <Python.h>
+#include <openssl/evp.h>
+
+extern  int       init_crypto_evp   (PyObject *);
+
+extern  PyTypeObject      crypto_Digest_Type;
+extern  PyTypeObject      crypto_Cipher_Type;
+
+#define crypto_Digest_Check(v) ((v)->ob_type == &crypto_Digest_Type)
+#define crypto_Cipher_Check(v) ((v)->ob_type == &crypto_Cipher_Type)
+
+typedef struct {
+    PyObject_HEAD
+    const EVP_MD        *digest;
+} crypto_DigestObj;
+
+typedef struct {
+    PyObject_HEAD
+    const EVP_CIPHER    *cipher;
+} crypto_CipherObj;
+
+extern  PyObject  *crypto_Digest_Get        (const char *);
+extern  PyObject  *crypto_Cipher_Get        (const char *);
+extern  int       crypto_digest_converter   (PyObject *, void *);
+extern  int       crypto_sign_digest_converter (PyObject *, void *);
+extern  int       crypto_cipher_converter   (PyObject *, void *);
+
+#endif
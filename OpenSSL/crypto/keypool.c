@@ -0,0 +1,496 @@
+/*
+ * keypool.c
+ *
+ * See LICENSE for details.
+ *
+ * A pool of keys generated ahead of time by native background threads, so
+ * that taking a key doesn't wait for it to be generated.  The background
+ * threads never touch Python objects; they share a plain C structure with the
+ * KeyPool object, protected by a lock, which the last of them to stop frees.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+#ifdef WITH_THREAD
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+struct keypool_state_st {
+    crypto_key_spec      spec;
+    Py_ssize_t           target;        /* The number of keys to keep ready */
+    EVP_PKEY           **keys;          /* target slots, count of them used */
+    Py_ssize_t           count;
+    Py_ssize_t           pending;       /* Keys being generated */
+    int                  threads;       /* Background threads still running */
+    int                  idle;          /* Threads waiting for wake */
+    int                  refs;          /* The KeyPool object and the threads */
+    int                  closing;
+    int                  signaled;      /* Whether wake is released */
+    unsigned long        generated, taken, misses, failures;
+    double               generation_time;   /* Seconds, over all keys */
+    PyThread_type_lock   lock;          /* Protects everything above */
+    PyThread_type_lock   wake;          /* Released to wake an idle thread */
+};
+
+/*
+ * Get the wall clock time, in seconds
+ */
+static double
+now(void)
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+/*
+ * Free the shared state and the keys left in it
+ */
+static void
+keypool_state_free(keypool_state *state)
+{
+    while (state->count > 0)
+        EVP_PKEY_free(state->keys[--state->count]);
+    PyMem_Free(state->keys);
+    crypto_PKey_free_spec(&state->spec);
+    if (state->lock != NULL)
+        PyThread_free_lock(state->lock);
+    if (state->wake != NULL)
+    {
+        if (!state->signaled)
+            PyThread_release_lock(state->wake);
+        PyThread_free_lock(state->wake);
+    }
+    PyMem_Free(state);
+}
+
+/*
+ * Wake one idle background thread, if it isn't done already.  Must be called
+ * with the lock held.
+ */
+static void
+wake_thread(keypool_state *state)
+{
+    if (!state->signaled)
+    {
+        state->signaled = 1;
+        PyThread_release_lock(state->wake);
+    }
+}
+
+/*
+ * Drop a reference to the shared state.  Must be called with the lock held,
+ * which is released.
+ */
+static void
+release_state(keypool_state *state)
+{
+    int last = --state->refs == 0;
+
+    PyThread_release_lock(state->lock);
+    if (last)
+        keypool_state_free(state);
+}
+
+/*
+ * The background threads, which generate keys while the pool isn't full and
+ * wait to be woken otherwise.  A thread stops when the pool is closed, or
+ * when it fails to generate a key, since it would most likely fail again.
+ */
+static void
+keypool_thread(void *arg)
+{
+    keypool_state *state = arg;
+    EVP_PKEY *pkey;
+    double start, elapsed;
+
+    PyThread_acquire_lock(state->lock, WAIT_LOCK);
+    while (!state->closing)
+    {
+        if (state->count + state->pending >= state->target)
+        {
+            state->idle++;
+            PyThread_release_lock(state->lock);
+            PyThread_acquire_lock(state->wake, WAIT_LOCK);
+            PyThread_acquire_lock(state->lock, WAIT_LOCK);
+            state->signaled = 0;
+            state->idle--;
+            continue;
+        }
+
+        state->pending++;
+        /* Let another thread help if there is still room */
+        if (state->idle > 0 && state->count + state->pending < state->target)
+            wake_thread(state);
+        PyThread_release_lock(state->lock);
+
+        start = now();
+        pkey = crypto_PKey_generate(&state->spec);
+        elapsed = now() - start;
+        if (pkey == NULL)
+            ERR_clear_error();
+
+        PyThread_acquire_lock(state->lock, WAIT_LOCK);
+        state->pending--;
+        if (pkey == NULL)
+        {
+            state->failures++;
+            break;
+        }
+        state->keys[state->count++] = pkey;
+        state->generated++;
+        state->generation_time += elapsed;
+    }
+
+    /* Pass the news on to the other threads */
+    if (state->closing && state->idle > 0)
+        wake_thread(state);
+    state->threads--;
+    release_state(state);
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+    ERR_remove_state(0);
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+    ERR_remove_thread_state(NULL);
+#endif
+}
+
+static char crypto_KeyPool_take_doc[] = "\n\
+Take a key from the pool.  If the pool is empty, a key is generated on the\n\
+spot, with the GIL released.\n\
+\n\
+@return: A new PKey object\n\
+";
+
+static PyObject *
+crypto_KeyPool_take(crypto_KeyPoolObj *self, PyObject *args)
+{
+    keypool_state *state = self->state;
+    EVP_PKEY *pkey = NULL;
+
+    if (!PyArg_ParseTuple(args, ":take"))
+        return NULL;
+
+    PyThread_acquire_lock(state->lock, WAIT_LOCK);
+    if (state->closing)
+    {
+        PyThread_release_lock(state->lock);
+        PyErr_SetString(PyExc_ValueError, "KeyPool is closed");
+        return NULL;
+    }
+    state->taken++;
+    if (state->count > 0)
+    {
+        pkey = state->keys[--state->count];
+        if (state->idle > 0)
+            wake_thread(state);
+    }
+    else
+    {
+        state->misses++;
+    }
+    PyThread_release_lock(state->lock);
+
+    if (pkey == NULL)
+    {
+        MY_BEGIN_ALLOW_THREADS(ignored);
+        pkey = crypto_PKey_generate(&state->spec);
+        MY_END_ALLOW_THREADS(ignored);
+        if (pkey == NULL)
+        {
+            exception_from_error_queue(crypto_Error);
+            return NULL;
+        }
+    }
+
+    return (PyObject *)crypto_PKey_New(pkey, 1);
+}
+
+static char crypto_KeyPool_stats_doc[] = "\n\
+Describe the state of the pool\n\
+\n\
+@return: A dict with the following keys: size, the number of keys ready;\n\
+         target_size; threads, the number of background threads running;\n\
+         generated, the number of keys they generated; taken, the number of\n\
+         keys taken; misses, the number of keys taken from an empty pool;\n\
+         failures, the number of threads stopped by a failed generation;\n\
+         generation_time, the average time to generate a key, in seconds;\n\
+         refill_rate, the number of keys per second the running threads\n\
+         can generate.\n\
+";
+
+static PyObject *
+crypto_KeyPool_stats(crypto_KeyPoolObj *self, PyObject *args)
+{
+    keypool_state *state = self->state;
+    Py_ssize_t size, target;
+    int threads;
+    unsigned long generated, taken, misses, failures;
+    double generation_time = 0.0, refill_rate = 0.0;
+
+    if (!PyArg_ParseTuple(args, ":stats"))
+        return NULL;
+
+    PyThread_acquire_lock(state->lock, WAIT_LOCK);
+    size = state->count;
+    target = state->target;
+    threads = state->threads;
+    generated = state->generated;
+    taken = state->taken;
+    misses = state->misses;
+    failures = state->failures;
+    if (generated > 0)
+        generation_time = state->generation_time / generated;
+    PyThread_release_lock(state->lock);
+
+    if (generation_time > 0.0)
+        refill_rate = threads / generation_time;
+
+    return Py_BuildValue("{s:n,s:n,s:i,s:k,s:k,s:k,s:k,s:d,s:d}",
+                         "size", size, "target_size", target,
+                         "threads", threads, "generated", generated,
+                         "taken", taken, "misses", misses,
+                         "failures", failures,
+                         "generation_time", generation_time,
+                         "refill_rate", refill_rate);
+}
+
+/*
+ * Stop the background threads and free the keys in the pool.  Threads busy
+ * generating a key aren't waited for; the last one frees the shared state.
+ */
+static void
+close_pool(keypool_state *state)
+{
+    PyThread_acquire_lock(state->lock, WAIT_LOCK);
+    if (!state->closing)
+    {
+        state->closing = 1;
+        while (state->count > 0)
+            EVP_PKEY_free(state->keys[--state->count]);
+        if (state->idle > 0)
+            wake_thread(state);
+    }
+    PyThread_release_lock(state->lock);
+}
+
+static char crypto_KeyPool_close_doc[] = "\n\
+Stop the background threads and free the keys in the pool.  take() can't\n\
+be called afterwards.\n\
+\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_KeyPool_close(crypto_KeyPoolObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":close"))
+        return NULL;
+
+    close_pool(self->state);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/*
+ * ADD_METHOD(name) expands to a correct PyMethodDef declaration
+ *   {  'name', (PyCFunction)crypto_KeyPool_name, METH_VARARGS }
+ * for convenience
+ */
+#define ADD_METHOD(name)        \
+    { #name, (PyCFunction)crypto_KeyPool_##name, METH_VARARGS, crypto_KeyPool_##name##_doc }
+static PyMethodDef crypto_KeyPool_methods[] =
+{
+    ADD_METHOD(take),
+    ADD_METHOD(stats),
+    ADD_METHOD(close),
+    { NULL, NULL }
+};
+#undef ADD_METHOD
+
+
+static char crypto_KeyPool_doc[] = "\n\
+KeyPool(type, bits, target_size[, threads]) -> KeyPool instance\n\
+\n\
+Create a pool of keys kept topped up by native background threads.\n\
+\n\
+@param type: The key type, as for PKey.generate_key\n\
+@param bits: The number of bits, DSAParameters or curve, as for\n\
+             PKey.generate_key, or None for TYPE_ED25519\n\
+@param target_size: The number of keys to keep ready\n\
+@param threads: (optional) The number of background threads, 1 by default\n\
+@returns: The KeyPool object\n\
+";
+
+static PyObject *
+crypto_KeyPool_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    crypto_KeyPoolObj *self;
+    keypool_state *state;
+    PyObject *size;
+    Py_ssize_t target;
+    crypto_key_spec spec;
+    int type, threads = 1, i;
+    static char *kwlist[] = {"type", "bits", "target_size", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iOn|i:KeyPool", kwlist,
+                                     &type, &size, &target, &threads))
+        return NULL;
+
+    if (target <= 0 || threads <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError,
+                        "target_size and threads must be positive");
+        return NULL;
+    }
+    if (!crypto_PKey_parse_spec(type, size == Py_None ? NULL : size, &spec))
+        return NULL;
+
+    if ((state = PyMem_New(keypool_state, 1)) == NULL)
+    {
+        crypto_PKey_free_spec(&spec);
+        return PyErr_NoMemory();
+    }
+    memset(state, 0, sizeof(*state));
+    state->spec = spec;
+    state->target = target;
+    state->refs = 1;
+    state->signaled = 1;
+    if ((state->keys = PyMem_New(EVP_PKEY *, target)) == NULL ||
+        (state->lock = PyThread_allocate_lock()) == NULL ||
+        (state->wake = PyThread_allocate_lock()) == NULL)
+    {
+        keypool_state_free(state);
+        return PyErr_NoMemory();
+    }
+    /* Held until a thread needs waking */
+    PyThread_acquire_lock(state->wake, WAIT_LOCK);
+    state->signaled = 0;
+
+    if ((self = PyObject_New(crypto_KeyPoolObj, &crypto_KeyPool_Type)) == NULL)
+    {
+        keypool_state_free(state);
+        return NULL;
+    }
+    self->state = state;
+
+    PyThread_acquire_lock(state->lock, WAIT_LOCK);
+    for (i = 0; i < threads; i++)
+    {
+        state->threads++;
+        state->refs++;
+        if (PyThread_start_new_thread(keypool_thread, state) ==
+            PYTHREAD_INVALID_THREAD_ID)
+        {
+            state->threads--;
+            state->refs--;
+            break;
+        }
+    }
+    PyThread_release_lock(state->lock);
+
+    if (state->threads == 0)
+    {
+        Py_DECREF(self);
+        PyErr_SetString(crypto_Error, "can't start the KeyPool threads");
+        return NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+/*
+ * Deallocate the memory used by the KeyPool object
+ *
+ * Arguments: self - The KeyPool object
+ * Returns:   None
+ */
+static void
+crypto_KeyPool_dealloc(crypto_KeyPoolObj *self)
+{
+    close_pool(self->state);
+    PyThread_acquire_lock(self->state->lock, WAIT_LOCK);
+    release_state(self->state);
+    PyObject_Del(self);
+}
+
+PyTypeObject crypto_KeyPool_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "KeyPool",
+    sizeof(crypto_KeyPoolObj),
+    0,
+    (destructor)crypto_KeyPool_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_KeyPool_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_KeyPool_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_KeyPool_new, /* tp_new */
+};
+
+#endif
+
+/*
+ * Initialize the KeyPool part of the crypto module.  Without threads, there
+ * is no KeyPool.
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_keypool(PyObject *module)
+{
+#ifdef WITH_THREAD
+    if (PyType_Ready(&crypto_KeyPool_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "KeyPool", (PyObject *)&crypto_KeyPool_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "KeyPoolType", (PyObject *)&crypto_KeyPool_Type) != 0) {
+        return 0;
+    }
+#endif
+
+    return 1;
+}
@@ -0,0 +1,33 @@
+/*
+ * keypool.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the pool of keys generated ahead of time.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_KEYPOOL_H_
+#define PyOpenSSL_crypto_KEYPOOL_H_
+
+#include <Python.h>
+#include <openssl/evp.h>
+
+extern  int       init_crypto_keypool   (PyObject *);
+
+extern  PyTypeObject      crypto_KeyPool_Type;
+
+#define crypto_KeyPool_Check(v) ((v)->ob_type == &crypto_KeyPool_Type)
+
+/*
+ * The state shared with the background threads, which outlives the KeyPool
+ * object until the last of them exits
+ */
+typedef struct keypool_state_st keypool_state;
+
+typedef struct {
+    PyObject_HEAD
+    keypool_state       *state;
+} crypto_KeyPoolObj;
+
+#endif
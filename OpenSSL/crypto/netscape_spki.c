@@ -93,11 +93,10 @@ static PyObject *
 crypto_NetscapeSPKI_sign(crypto_NetscapeSPKIObj *self, PyObject *args)
 {
     crypto_PKeyObj *pkey;
-    char *digest_name;
     const EVP_MD *digest;
 
-    if (!PyArg_ParseTuple(args, "O!s:sign", &crypto_PKey_Type, &pkey,
-			  &digest_name))
+    if (!PyArg_ParseTuple(args, "O!O&:sign", &crypto_PKey_Type, &pkey,
+			  crypto_digest_converter, &digest))
         return NULL;
 
     if (pkey->only_public) {
@@ -110,12 +109,6 @@ crypto_NetscapeSPKI_sign(crypto_NetscapeSPKIObj *self, PyObject *args)
 	return NULL;
     }
 
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL)
-    {
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
-        return NULL;
-    }
-
     if (!NETSCAPE_SPKI_sign(self->netscape_spki, pkey->pkey, digest))
     {
         exception_from_error_queue(crypto_Error);
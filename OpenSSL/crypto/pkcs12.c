@@ -216,37 +216,24 @@ crypto_PKCS12_set_friendlyname(crypto_PKCS12Obj *self, PyObject *args, PyObject
     return Py_None;
 }
 
-static char crypto_PKCS12_export_doc[] = "\n\
-export([passphrase=None][, friendly_name=None][, iter=2048][, maciter=1]\n\
-Dump a PKCS12 object as a string.  See also \"man PKCS12_create\".\n\
-\n\
-@param passphrase: used to encrypt the PKCS12\n\
-@type passphrase: L{str}\n\
-@param iter: How many times to repeat the encryption\n\
-@type iter: L{int}\n\
-@param maciter: How many times to repeat the MAC\n\
-@type maciter: L{int}\n\
-@return: The string containing the PKCS12\n\
-";
-static PyObject *
-crypto_PKCS12_export(crypto_PKCS12Obj *self, PyObject *args, PyObject *keywds) {
+/*
+ * Build the PKCS12 structure for export
+ *
+ * Arguments: self       - The PKCS12 object
+ *            passphrase - The passphrase to encrypt with, or NULL
+ *            iter       - How many times to repeat the encryption
+ *            maciter    - How many times to repeat the MAC
+ * Returns:   The PKCS12 structure, or NULL with an exception set
+ */
+static PKCS12 *
+crypto_PKCS12_create(crypto_PKCS12Obj *self, char *passphrase, int iter, int maciter) {
     int i; /* Py_ssize_t for Python 2.5+ */
     PyObject *obj;
-    int buf_len;
-    PyObject *buffer;
-    char *temp, *passphrase = NULL, *friendly_name = NULL;
-    BIO *bio;
+    char *friendly_name = NULL;
     PKCS12 *p12;
     EVP_PKEY *pkey = NULL;
     STACK_OF(X509) *cacerts = NULL;
     X509 *x509 = NULL;
-    int iter = 0;  /* defaults to PKCS12_DEFAULT_ITER */
-    int maciter = 0;
-    static char *kwlist[] = {"passphrase", "iter", "maciter", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|zii:export",
-        kwlist, &passphrase, &iter, &maciter))
-        return NULL;
 
     if (self->key != Py_None) {
         pkey = ((crypto_PKeyObj*) self->key)->pkey;
@@ -274,14 +261,84 @@ crypto_PKCS12_export(crypto_PKCS12Obj *self, PyObject *args, PyObject *keywds) {
     sk_X509_free(cacerts); /* NULL safe.  Free just the container. */
     if (p12 == NULL) {
         exception_from_error_queue(crypto_Error);
+    }
+    return p12;
+}
+
+static char crypto_PKCS12_export_doc[] = "\n\
+export([passphrase=None][, friendly_name=None][, iter=2048][, maciter=1]\n\
+Dump a PKCS12 object as a string.  See also \"man PKCS12_create\".\n\
+\n\
+@param passphrase: used to encrypt the PKCS12\n\
+@type passphrase: L{str}\n\
+@param iter: How many times to repeat the encryption\n\
+@type iter: L{int}\n\
+@param maciter: How many times to repeat the MAC\n\
+@type maciter: L{int}\n\
+@return: The string containing the PKCS12\n\
+";
+static PyObject *
+crypto_PKCS12_export(crypto_PKCS12Obj *self, PyObject *args, PyObject *keywds) {
+    int ret;
+    char *passphrase = NULL;
+    BIO *bio;
+    PKCS12 *p12;
+    int iter = 0;  /* defaults to PKCS12_DEFAULT_ITER */
+    int maciter = 0;
+    static char *kwlist[] = {"passphrase", "iter", "maciter", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|zii:export",
+        kwlist, &passphrase, &iter, &maciter))
+        return NULL;
+
+    if ((p12 = crypto_PKCS12_create(self, passphrase, iter, maciter)) == NULL) {
         return NULL;
     }
     bio = BIO_new(BIO_s_mem());
-    i2d_PKCS12_bio(bio, p12);
-    buf_len = BIO_get_mem_data(bio, &temp);
-    buffer = PyBytes_FromStringAndSize(temp, buf_len);
-    BIO_free(bio);
-    return buffer;
+    ret = i2d_PKCS12_bio(bio, p12);
+    PKCS12_free(p12);
+    return crypto_bio_to_bytes(bio, ret);
+}
+
+static char crypto_PKCS12_export_into_doc[] = "\n\
+export_into(buffer[, passphrase=None][, iter=2048][, maciter=1]\n\
+Dump a PKCS12 object into a writable buffer.  See also \"man PKCS12_create\".\n\
+\n\
+@param buffer: The writable buffer to dump the PKCS12 into, or None to only\n\
+               compute the size needed\n\
+@param passphrase: used to encrypt the PKCS12\n\
+@type passphrase: L{str}\n\
+@param iter: How many times to repeat the encryption\n\
+@type iter: L{int}\n\
+@param maciter: How many times to repeat the MAC\n\
+@type maciter: L{int}\n\
+@return: The number of bytes written (or needed)\n\
+";
+static PyObject *
+crypto_PKCS12_export_into(crypto_PKCS12Obj *self, PyObject *args, PyObject *keywds) {
+    int ret;
+    PyObject *obj;
+    char *passphrase = NULL;
+    crypto_OutputBuffer out;
+    PKCS12 *p12;
+    int iter = 0;  /* defaults to PKCS12_DEFAULT_ITER */
+    int maciter = 0;
+    static char *kwlist[] = {"buffer", "passphrase", "iter", "maciter", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|zii:export_into",
+        kwlist, &obj, &passphrase, &iter, &maciter))
+        return NULL;
+
+    if ((p12 = crypto_PKCS12_create(self, passphrase, iter, maciter)) == NULL) {
+        return NULL;
+    }
+    if (!crypto_OutputBuffer_open(&out, obj)) {
+        PKCS12_free(p12);
+        return NULL;
+    }
+    ret = i2d_PKCS12_bio(out.bio, p12);
+    PKCS12_free(p12);
+    return crypto_OutputBuffer_close(&out, ret);
 }
 
 /*
@@ -304,6 +361,7 @@ static PyMethodDef crypto_PKCS12_methods[] =
     ADD_METHOD(get_friendlyname),
     ADD_KW_METHOD(set_friendlyname),
     ADD_KW_METHOD(export),
+    ADD_KW_METHOD(export_into),
     { NULL, NULL }
 };
 #undef ADD_METHOD
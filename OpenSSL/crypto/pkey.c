@@ -27,60 +27,280 @@ do {                                    \
 } while (0)
     
 
-static char crypto_PKey_generate_key_doc[] = "\n\
-Generate a key of a given type, with a given number of a bits\n\
-\n\
-@param type: The key type (TYPE_RSA or TYPE_DSA)\n\
-@param bits: The number of bits\n\
-@return: None\n\
-";
+/*
+ * Replace the key of a PKey object with a newly generated one
+ *
+ * Arguments: self - The PKey object
+ *            pkey - The new key, which the PKey object takes over
+ * Returns:   None
+ */
+static void
+set_pkey(crypto_PKeyObj *self, EVP_PKEY *pkey)
+{
+    if (self->dealloc)
+        EVP_PKEY_free(self->pkey);
+    self->pkey = pkey;
+    self->dealloc = 1;
+    self->only_public = 0;
+}
 
-static PyObject *
-crypto_PKey_generate_key(crypto_PKeyObj *self, PyObject *args)
+/*
+ * Generate a key with EVP_PKEY_keygen
+ *
+ * Arguments: type  - The key type
+ *            curve - The NID of the curve for EC keys, NID_undef otherwise
+ * Returns:   The new key, or NULL on error (the error is in the OpenSSL error
+ *            queue)
+ */
+static EVP_PKEY *
+keygen(int type, int curve)
 {
-    int type, bits;
-    RSA *rsa = NULL;
-    DSA *dsa = NULL;
+    EVP_PKEY_CTX *ctx;
+    EVP_PKEY *pkey = NULL;
 
-    if (!PyArg_ParseTuple(args, "ii:generate_key", &type, &bits))
+    if ((ctx = EVP_PKEY_CTX_new_id(type, NULL)) == NULL)
         return NULL;
+    if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+        (curve != NID_undef &&
+         EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, curve) <= 0) ||
+        EVP_PKEY_keygen(ctx, &pkey) <= 0)
+    {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+/*
+ * Find the curve to generate an EC key on
+ *
+ * Arguments: size - The size of a NIST curve, or the name of a curve
+ * Returns:   The NID of the curve, or NID_undef with an exception set
+ */
+static int
+curve_nid(PyObject *size)
+{
+    char *name;
+    int bits, nid;
+
+    if (size == NULL)
+    {
+        PyErr_SetString(PyExc_TypeError, "EC keys need a curve");
+        return NID_undef;
+    }
+
+    if (PyBytes_Check(size) || PyUnicode_Check(size))
+    {
+        if (!PyArg_Parse(size, "s:generate_key", &name))
+            return NID_undef;
+        if ((nid = EC_curve_nist2nid(name)) == NID_undef &&
+            (nid = OBJ_sn2nid(name)) == NID_undef)
+            PyErr_SetString(PyExc_ValueError, "No such curve");
+        return nid;
+    }
+
+    if (!PyArg_Parse(size, "i:generate_key", &bits))
+        return NID_undef;
+    switch (bits)
+    {
+        case 224:
+            return NID_secp224r1;
+        case 256:
+            return NID_X9_62_prime256v1;
+        case 384:
+            return NID_secp384r1;
+        case 521:
+            return NID_secp521r1;
+    }
+    PyErr_SetString(PyExc_ValueError, "No NIST curve of that size");
+    return NID_undef;
+}
+
+/*
+ * Check the arguments of a key generation
+ *
+ * Arguments: type - The key type
+ *            size - The number of bits, or DSAParameters for DSA keys, or
+ *                   the curve for EC keys, or NULL
+ *            spec - Where to store the kind of key to generate, to be freed
+ *                   with crypto_PKey_free_spec on success
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_PKey_parse_spec(int type, PyObject *size, crypto_key_spec *spec)
+{
+    spec->type = type;
+    spec->bits = 0;
+    spec->primes = 2;
+    spec->curve = NID_undef;
+    spec->params = NULL;
 
     switch (type)
     {
         case crypto_TYPE_RSA:
-            if (bits <= 0) {
+        case crypto_TYPE_DSA:
+            if (size == NULL)
+            {
+                PyErr_SetString(PyExc_TypeError, "generate_key() needs the number of bits");
+                return 0;
+            }
+            if (type == crypto_TYPE_DSA && crypto_DSAParameters_Check(size))
+            {
+                spec->params = ((crypto_DSAParametersObj *)size)->dsa;
+                DSA_up_ref(spec->params);
+                return 1;
+            }
+            if (!PyArg_Parse(size, "i:generate_key", &spec->bits))
+                return 0;
+            if (type == crypto_TYPE_RSA && spec->bits <= 0)
+            {
                 PyErr_SetString(PyExc_ValueError, "Invalid number of bits");
-                return NULL;
+                return 0;
             }
+            return 1;
+
+        case crypto_TYPE_EC:
+            return (spec->curve = curve_nid(size)) != NID_undef;
+
+        case crypto_TYPE_ED25519:
+            return 1;
+    }
 
-            rsa = RSA_new();
+    PyErr_SetString(crypto_Error, "No such key type");
+    return 0;
+}
 
-	    BIGNUM *bne = BN_new();
-	    if (BN_set_word(bne, RSA_F4) != 1)
-		FAIL();
-            if ((RSA_generate_key_ex(rsa, bits, bne, NULL)) != 1)
-                FAIL();
-	    BN_free(bne);
+/*
+ * Free what a key generation spec holds
+ *
+ * Arguments: spec - The spec filled in by crypto_PKey_parse_spec
+ * Returns:   None
+ */
+void
+crypto_PKey_free_spec(crypto_key_spec *spec)
+{
+    DSA_free(spec->params);
+    spec->params = NULL;
+}
+
+/*
+ * Generate a new key.  Doesn't touch any Python object, so it can be called
+ * with the GIL released, and from several threads at once with the same spec.
+ *
+ * Arguments: spec - The kind of key to generate
+ * Returns:   The new key, or NULL on error (the error is in the OpenSSL error
+ *            queue)
+ */
+EVP_PKEY *
+crypto_PKey_generate(const crypto_key_spec *spec)
+{
+    EVP_PKEY *pkey = NULL;
+    BIGNUM *e = NULL;
+    RSA *rsa = NULL;
+    DSA *dsa = NULL;
 
-            if (!EVP_PKEY_assign_RSA(self->pkey, rsa))
-                FAIL();
-	    break;
+    switch (spec->type)
+    {
+        case crypto_TYPE_RSA:
+            if ((pkey = EVP_PKEY_new()) == NULL ||
+                (rsa = RSA_new()) == NULL ||
+                (e = BN_new()) == NULL ||
+                !BN_set_word(e, RSA_F4) ||
+                !RSA_generate_multi_prime_key(rsa, spec->bits, spec->primes, e,
+                                              NULL) ||
+                !EVP_PKEY_assign_RSA(pkey, rsa))
+                goto error;
+            BN_free(e);
+            return pkey;
 
         case crypto_TYPE_DSA:
-            dsa = DSA_new();
-            if ((DSA_generate_parameters_ex(dsa, bits, NULL, 0, NULL, NULL, NULL)) != 1)
-                FAIL();
-            if (!DSA_generate_key(dsa))
-                FAIL();
-            if (!EVP_PKEY_assign_DSA(self->pkey, dsa))
-                FAIL();
-	    break;
-
-        default:
-	    PyErr_SetString(crypto_Error, "No such key type");
-	    return NULL;
+            /* Generating the parameters takes much longer than the key */
+            if (spec->params != NULL)
+                dsa = DSAparams_dup(spec->params);
+            else if ((dsa = DSA_new()) != NULL &&
+                     !DSA_generate_parameters_ex(dsa, spec->bits, NULL, 0,
+                                                 NULL, NULL, NULL))
+                goto error;
+            if ((pkey = EVP_PKEY_new()) == NULL ||
+                dsa == NULL ||
+                !DSA_generate_key(dsa) ||
+                !EVP_PKEY_assign_DSA(pkey, dsa))
+                goto error;
+            return pkey;
+
+        case crypto_TYPE_EC:
+            return keygen(EVP_PKEY_EC, spec->curve);
+
+        case crypto_TYPE_ED25519:
+            return keygen(EVP_PKEY_ED25519, NID_undef);
+    }
+    return NULL;
+
+  error:
+    BN_free(e);
+    RSA_free(rsa);
+    DSA_free(dsa);
+    EVP_PKEY_free(pkey);
+    return NULL;
+}
+
+static char crypto_PKey_generate_key_doc[] = "\n\
+Generate a key of a given type, with a given number of a bits\n\
+\n\
+@param type: The key type (TYPE_RSA, TYPE_DSA, TYPE_EC or TYPE_ED25519)\n\
+@param bits: The number of bits.  For TYPE_DSA, DSAParameters to generate\n\
+             the key from instead.  For TYPE_EC, the size of a NIST curve\n\
+             (224, 256, 384 or 521) or the name of a curve, such as\n\
+             \"P-256\" or \"secp384r1\".  Ignored, and optional, for\n\
+             TYPE_ED25519.\n\
+@param primes: (optional, keyword only) The number of primes of a TYPE_RSA\n\
+               key, 2 by default.  More primes can make private key\n\
+               operations faster, depending on the OpenSSL build; how many\n\
+               are allowed depends on the number of bits.\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_PKey_generate_key(crypto_PKeyObj *self, PyObject *args, PyObject *kwargs)
+{
+    int type, primes = 2;
+    PyObject *size = NULL;
+    crypto_key_spec spec;
+    EVP_PKEY *pkey;
+    static char *kwlist[] = {"type", "bits", "primes", NULL};
+
+    /* primes is keyword only, like the optional arguments added later */
+    if (PyTuple_GET_SIZE(args) > 2)
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "generate_key() takes at most 2 positional arguments");
+        return NULL;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|Oi:generate_key", kwlist,
+                                     &type, &size, &primes))
+        return NULL;
 
+    if (primes != 2 && (type != crypto_TYPE_RSA || primes < 2))
+    {
+        PyErr_SetString(PyExc_ValueError,
+                        "primes must be at least 2, and only for RSA keys");
+        return NULL;
     }
+
+    if (!crypto_PKey_parse_spec(type, size, &spec))
+        return NULL;
+    spec.primes = primes;
+
+    /* Large RSA keys take long enough to let other threads run meanwhile */
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    pkey = crypto_PKey_generate(&spec);
+    MY_END_ALLOW_THREADS(ignored);
+    crypto_PKey_free_spec(&spec);
+    if (pkey == NULL)
+        FAIL();
+
+    set_pkey(self, pkey);
     self->initialized = 1;
     Py_INCREF(Py_None);
     return Py_None;
@@ -116,6 +336,36 @@ crypto_PKey_type(crypto_PKeyObj *self, PyObject *args)
     return PyLong_FromLong(EVP_PKEY_id(self->pkey));
 }
 
+/*
+ * Describe the public part of a key
+ *
+ * Arguments: pkey - The key, which may be NULL
+ * Returns:   A new reference to a dict giving the type and size of the key
+ *            like PKey.type and PKey.bits, None if there is no key, or NULL
+ *            with an exception set
+ */
+PyObject *
+crypto_PKey_describe(EVP_PKEY *pkey)
+{
+    PyObject *dict;
+
+    if (pkey == NULL)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    if ((dict = PyDict_New()) == NULL)
+        return NULL;
+    if (dict_set_new(dict, "type", PyLong_FromLong(EVP_PKEY_id(pkey))) < 0 ||
+        dict_set_new(dict, "bits", PyLong_FromLong(EVP_PKEY_bits(pkey))) < 0)
+    {
+        Py_DECREF(dict);
+        return NULL;
+    }
+    return dict;
+}
+
 
 /*
  * ADD_METHOD(name) expands to a correct PyMethodDef declaration
@@ -124,14 +374,17 @@ crypto_PKey_type(crypto_PKeyObj *self, PyObject *args)
  */
 #define ADD_METHOD(name)        \
     { #name, (PyCFunction)crypto_PKey_##name, METH_VARARGS, crypto_PKey_##name##_doc }
+#define ADD_METHOD_KW(name)     \
+    { #name, (PyCFunction)crypto_PKey_##name, METH_VARARGS | METH_KEYWORDS, crypto_PKey_##name##_doc }
 static PyMethodDef crypto_PKey_methods[] =
 {
-    ADD_METHOD(generate_key),
+    ADD_METHOD_KW(generate_key),
     ADD_METHOD(bits),
     ADD_METHOD(type),
     { NULL, NULL }
 };
 #undef ADD_METHOD
+#undef ADD_METHOD_KW
 
 
 /*
@@ -18,6 +18,23 @@ extern  PyTypeObject    crypto_PKey_Type;
 
 #define crypto_PKey_Check(v) ((v)->ob_type == &crypto_PKey_Type)
 
+/*
+ * What kind of key to generate, read from the arguments of a key generation
+ * so that keys can then be generated without touching Python objects
+ */
+typedef struct {
+    int                  type;
+    int                  bits;          /* For RSA and DSA keys */
+    int                  primes;        /* The number of primes of RSA keys */
+    int                  curve;         /* The NID of the curve for EC keys */
+    DSA                 *params;        /* Shared DSA parameters, or NULL */
+} crypto_key_spec;
+
+extern  PyObject  *crypto_PKey_describe  (EVP_PKEY *);
+extern  int       crypto_PKey_parse_spec (int, PyObject *, crypto_key_spec *);
+extern  void      crypto_PKey_free_spec  (crypto_key_spec *);
+extern  EVP_PKEY  *crypto_PKey_generate  (const crypto_key_spec *);
+
 typedef struct {
     PyObject_HEAD
 
@@ -48,5 +65,7 @@ typedef struct {
 
 #define crypto_TYPE_RSA           EVP_PKEY_RSA
 #define crypto_TYPE_DSA           EVP_PKEY_DSA
+#define crypto_TYPE_EC            EVP_PKEY_EC
+#define crypto_TYPE_ED25519       EVP_PKEY_ED25519
 
 #endif
@@ -141,6 +141,8 @@ crypto_Revoked_set_reason(crypto_RevokedObj *self, PyObject *args, PyObject *key
         return NULL;
     }
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if(reason_str == NULL) {
         delete_reason(X509_REVOKED_get0_extensions(self->revoked));
         goto done;
@@ -229,6 +231,7 @@ static PyObject*
 crypto_Revoked_set_rev_date(crypto_RevokedObj *self, PyObject *args) {
     const ASN1_TIME *time;
 
+    crypto_DERDigest_invalidate(&self->der_digest);
     time = X509_REVOKED_get0_revocationDate(self->revoked);
 
     return _set_asn1_time(BYTESTRING_FMT ":set_rev_date", (ASN1_TIME *)time, args);
@@ -312,6 +315,8 @@ crypto_Revoked_set_serial(crypto_RevokedObj *self, PyObject *args, PyObject *key
         return NULL;
     }
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if (!BN_hex2bn(&serial, hex_str) ) {
         PyErr_SetString(PyExc_ValueError, "bad hex string");
         return NULL;
@@ -337,9 +342,35 @@ crypto_Revoked_New(X509_REVOKED *revoked) {
         return NULL;
     }
     self->revoked = revoked;
+    crypto_DERDigest_invalidate(&self->der_digest);
     return self;
 }
 
+static long
+crypto_Revoked_hash(crypto_RevokedObj *self) {
+    return crypto_DERDigest_hash(&self->der_digest, ASN1_ITEM_rptr(X509_REVOKED),
+                                 self->revoked, (PyObject *)self);
+}
+
+static PyObject *
+crypto_Revoked_richcompare(PyObject *a, PyObject *b, int op) {
+    crypto_RevokedObj *x, *y;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) ||
+        !crypto_Revoked_Check(a) || !crypto_Revoked_Check(b)) {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+
+    x = (crypto_RevokedObj *)a;
+    y = (crypto_RevokedObj *)b;
+    equal = crypto_DERDigest_equal(&x->der_digest, x->revoked,
+                                   &y->der_digest, y->revoked,
+                                   ASN1_ITEM_rptr(X509_REVOKED));
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
 /*
  * ADD_METHOD(name) expands to a correct PyMethodDef declaration
  *   {  'name', (PyCFunction)crypto_Revoked_name, METH_VARARGS, crypto_Revoked_name_doc }
@@ -400,7 +431,7 @@ PyTypeObject crypto_Revoked_Type = {
     NULL, /* as_number */
     NULL, /* as_sequence */
     NULL, /* as_mapping */
-    NULL, /* hash */
+    (hashfunc)crypto_Revoked_hash, /* hash */
     NULL, /* call */
     NULL, /* str */
     NULL, /* getattro */
@@ -410,7 +441,7 @@ PyTypeObject crypto_Revoked_Type = {
     crypto_Revoked_doc, /* doc */
     NULL, /* traverse */
     NULL, /* clear */
-    NULL, /* tp_richcompare */
+    (richcmpfunc)crypto_Revoked_richcompare, /* tp_richcompare */
     0, /* tp_weaklistoffset */
     NULL, /* tp_iter */
     NULL, /* tp_iternext */
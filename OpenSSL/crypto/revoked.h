@@ -10,6 +10,7 @@ extern  PyTypeObject      crypto_Revoked_Type;
 typedef struct {
     PyObject_HEAD
     X509_REVOKED *revoked;
+    crypto_DERDigest der_digest;
 } crypto_RevokedObj;
 
 extern  int       init_crypto_revoked   (PyObject *);
@@ -0,0 +1,512 @@
+/*
+ * signer.c
+ *
+ * See LICENSE for details.
+ *
+ * Incremental signing and verification of data, mostly thin wrappers around
+ * the EVP_DigestSign and EVP_DigestVerify functions.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+/*
+ * Updates with at least this many bytes are done with the GIL released.
+ * Below that, releasing and reacquiring the GIL costs more than it gains.
+ */
+#define SIGNER_GIL_MINSIZE 2048
+
+/*
+ * Sign a buffer in one go.  Doesn't touch any Python object, so it can be
+ * called with the GIL released.
+ *
+ * Arguments: ctx     - The digest context to use, which may have been used
+ *                      before
+ *            pkey    - The private key to sign with
+ *            md      - The message digest, or NULL for keys which don't take
+ *                      one
+ *            data    - The data to sign
+ *            len     - The length of data
+ *            sig     - Where to store the signature, EVP_PKEY_size(pkey) bytes
+ *            sig_len - The size of sig, set to the length of the signature
+ * Returns:   1 on success, 0 on error (the error is in the OpenSSL error queue)
+ */
+int
+crypto_digest_sign(EVP_MD_CTX *ctx, EVP_PKEY *pkey, const EVP_MD *md,
+                   const void *data, size_t len,
+                   unsigned char *sig, size_t *sig_len)
+{
+    EVP_MD_CTX_reset(ctx);
+    /* One shot, as Ed25519 keys can't sign in several updates */
+    return EVP_DigestSignInit(ctx, NULL, md, NULL, pkey) == 1 &&
+           EVP_DigestSign(ctx, sig, sig_len, data, len) == 1;
+}
+
+/*
+ * Verify the signature of a buffer in one go.  Doesn't touch any Python
+ * object, so it can be called with the GIL released.
+ *
+ * Arguments: ctx     - The digest context to use, which may have been used
+ *                      before
+ *            pkey    - The public key to verify with
+ *            md      - The message digest, or NULL for keys which don't take
+ *                      one
+ *            sig     - The signature
+ *            sig_len - The length of sig
+ *            data    - The signed data
+ *            len     - The length of data
+ * Returns:   1 if the signature is correct, 0 otherwise (the error is in the
+ *            OpenSSL error queue)
+ */
+int
+crypto_digest_verify(EVP_MD_CTX *ctx, EVP_PKEY *pkey, const EVP_MD *md,
+                     const unsigned char *sig, size_t sig_len,
+                     const void *data, size_t len)
+{
+    EVP_MD_CTX_reset(ctx);
+    return EVP_DigestVerifyInit(ctx, NULL, md, NULL, pkey) == 1 &&
+           EVP_DigestVerify(ctx, sig, sig_len, data, len) == 1;
+}
+
+/*
+ * Take the lock of a Signer or Verifier.  Waiting for it, if another thread
+ * is busy with a large update, is done with the GIL released.
+ */
+#ifdef WITH_THREAD
+#define ENTER_SIGNER(self)                                      \
+    if (!PyThread_acquire_lock((self)->lock, NOWAIT_LOCK)) {    \
+        MY_BEGIN_ALLOW_THREADS(ignored);                        \
+        PyThread_acquire_lock((self)->lock, WAIT_LOCK);         \
+        MY_END_ALLOW_THREADS(ignored);                          \
+    }
+#define LEAVE_SIGNER(self) PyThread_release_lock((self)->lock);
+#else
+#define ENTER_SIGNER(self)
+#define LEAVE_SIGNER(self)
+#endif
+
+/*
+ * Check that a Signer or Verifier hasn't been finalized.  Must be called with
+ * its lock held.
+ */
+static int
+check_not_finished(crypto_SignerObj *self)
+{
+    if (self->finished) {
+        PyErr_SetString(PyExc_ValueError, "final() has already been called");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Create a Signer or Verifier
+ *
+ * Arguments: type - crypto_Signer_Type or crypto_Verifier_Type
+ *            pkey - The key, a new reference of which is taken over (it is
+ *                   freed even if this fails)
+ *            md   - The message digest
+ * Returns:   The new object, or NULL with an exception set
+ */
+static PyObject *
+crypto_Signer_New(PyTypeObject *type, EVP_PKEY *pkey, const EVP_MD *md)
+{
+    crypto_SignerObj *self;
+    int ok;
+
+    self = (crypto_SignerObj *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        EVP_PKEY_free(pkey);
+        return NULL;
+    }
+    self->pkey = pkey;
+    self->finished = 0;
+
+#ifdef WITH_THREAD
+    if ((self->lock = PyThread_allocate_lock()) == NULL) {
+        Py_DECREF(self);
+        PyErr_SetString(PyExc_MemoryError, "unable to allocate lock");
+        return NULL;
+    }
+#endif
+
+    if ((self->ctx = EVP_MD_CTX_new()) == NULL) {
+        Py_DECREF(self);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    if (type == &crypto_Signer_Type)
+        ok = EVP_DigestSignInit(self->ctx, NULL, md, NULL, pkey);
+    else
+        ok = EVP_DigestVerifyInit(self->ctx, NULL, md, NULL, pkey);
+    if (ok != 1) {
+        Py_DECREF(self);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+/*
+ * Digest more data.  Can be called with the GIL released.
+ */
+static int
+signer_update(crypto_SignerObj *self, const void *data, size_t len)
+{
+    if (Py_TYPE(self) == &crypto_Signer_Type)
+        return EVP_DigestSignUpdate(self->ctx, data, len);
+    else
+        return EVP_DigestVerifyUpdate(self->ctx, data, len);
+}
+
+static char crypto_Signer_update_doc[] = "\n\
+Feed more data to be signed or verified.  Large buffers are digested\n\
+without holding the GIL.\n\
+\n\
+@param data: The data, any object supporting the buffer protocol\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_Signer_update(crypto_SignerObj *self, PyObject *args)
+{
+    Py_buffer buffer;
+    int ok = 1;
+
+    if (!PyArg_ParseTuple(args, BUFFER_FMT ":update", &buffer))
+        return NULL;
+
+    ENTER_SIGNER(self);
+    if (!check_not_finished(self)) {
+        LEAVE_SIGNER(self);
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
+
+    if (buffer.len >= SIGNER_GIL_MINSIZE) {
+        MY_BEGIN_ALLOW_THREADS(ignored);
+        ok = signer_update(self, buffer.buf, buffer.len);
+        MY_END_ALLOW_THREADS(ignored);
+    } else if (buffer.len > 0) {
+        ok = signer_update(self, buffer.buf, buffer.len);
+    }
+    LEAVE_SIGNER(self);
+    PyBuffer_Release(&buffer);
+
+    if (ok != 1) {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static char crypto_Signer_final_doc[] = "\n\
+Sign all the data fed to update().  No more data can be added afterwards.\n\
+\n\
+@return: The signature\n\
+";
+
+static PyObject *
+crypto_Signer_final(crypto_SignerObj *self, PyObject *args)
+{
+    PyObject *signature;
+    size_t sig_len;
+    int ok;
+
+    if (!PyArg_ParseTuple(args, ":final"))
+        return NULL;
+
+    sig_len = EVP_PKEY_size(self->pkey);
+    if ((signature = PyBytes_FromStringAndSize(NULL, sig_len)) == NULL)
+        return NULL;
+
+    ENTER_SIGNER(self);
+    if (!check_not_finished(self)) {
+        LEAVE_SIGNER(self);
+        Py_DECREF(signature);
+        return NULL;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ok = EVP_DigestSignFinal(self->ctx,
+                             (unsigned char *)PyBytes_AS_STRING(signature),
+                             &sig_len);
+    MY_END_ALLOW_THREADS(ignored);
+    self->finished = 1;
+    LEAVE_SIGNER(self);
+
+    if (ok != 1) {
+        Py_DECREF(signature);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    /* DSA and ECDSA signatures can be shorter than the maximum size */
+    if (_PyBytes_Resize(&signature, sig_len) < 0)
+        return NULL;
+    return signature;
+}
+
+static char crypto_Verifier_final_doc[] = "\n\
+Verify the signature of all the data fed to update().  No more data can be\n\
+added afterwards.\n\
+\n\
+@param signature: The signature to check\n\
+@return: None if the signature is correct, raise exception otherwise\n\
+";
+
+static PyObject *
+crypto_Verifier_final(crypto_SignerObj *self, PyObject *args)
+{
+    Py_buffer signature;
+    int ok;
+
+    if (!PyArg_ParseTuple(args, BUFFER_FMT ":final", &signature))
+        return NULL;
+
+    ENTER_SIGNER(self);
+    if (!check_not_finished(self)) {
+        LEAVE_SIGNER(self);
+        PyBuffer_Release(&signature);
+        return NULL;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ok = EVP_DigestVerifyFinal(self->ctx, signature.buf, signature.len);
+    MY_END_ALLOW_THREADS(ignored);
+    self->finished = 1;
+    LEAVE_SIGNER(self);
+    PyBuffer_Release(&signature);
+
+    if (ok != 1) {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/*
+ * ADD_METHOD(type, name) expands to a correct PyMethodDef declaration
+ *   {  'name', (PyCFunction)crypto_type_name, METH_VARARGS, crypto_type_name_doc }
+ * for convenience
+ */
+#define ADD_METHOD(type, name)        \
+    { #name, (PyCFunction)crypto_##type##_##name, METH_VARARGS, crypto_##type##_##name##_doc }
+static PyMethodDef crypto_Signer_methods[] =
+{
+    ADD_METHOD(Signer, update),
+    ADD_METHOD(Signer, final),
+    { NULL, NULL }
+};
+
+static PyMethodDef crypto_Verifier_methods[] =
+{
+    ADD_METHOD(Signer, update),
+    ADD_METHOD(Verifier, final),
+    { NULL, NULL }
+};
+#undef ADD_METHOD
+
+static PyObject *
+crypto_Signer_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    crypto_PKeyObj *pkey;
+    const EVP_MD *digest;
+    static char *kwlist[] = {"pkey", "digest", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O&:Signer", kwlist,
+                                     &crypto_PKey_Type, &pkey,
+                                     crypto_digest_converter, &digest))
+        return NULL;
+
+    EVP_PKEY_up_ref(pkey->pkey);
+    return crypto_Signer_New(subtype, pkey->pkey, digest);
+}
+
+static PyObject *
+crypto_Verifier_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    crypto_X509Obj *cert;
+    const EVP_MD *digest;
+    EVP_PKEY *pkey;
+    static char *kwlist[] = {"cert", "digest", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O&:Verifier", kwlist,
+                                     &crypto_X509_Type, &cert,
+                                     crypto_digest_converter, &digest))
+        return NULL;
+
+    if ((pkey = X509_get_pubkey(cert->x509)) == NULL) {
+        PyErr_SetString(PyExc_ValueError, "No public key");
+        return NULL;
+    }
+
+    return crypto_Signer_New(subtype, pkey, digest);
+}
+
+/*
+ * Deallocate the memory used by the Signer or Verifier object
+ *
+ * Arguments: self - The Signer or Verifier object
+ * Returns:   None
+ */
+static void
+crypto_Signer_dealloc(crypto_SignerObj *self)
+{
+    if (self->ctx != NULL)
+        EVP_MD_CTX_free(self->ctx);
+    if (self->pkey != NULL)
+        EVP_PKEY_free(self->pkey);
+#ifdef WITH_THREAD
+    if (self->lock != NULL)
+        PyThread_free_lock(self->lock);
+#endif
+
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static char crypto_Signer_doc[] = "\n\
+Signer(pkey, digest) -> Signer instance\n\
+\n\
+Sign data fed in any number of pieces, without holding all of it in memory.\n\
+\n\
+@param pkey: The PKey to sign with\n\
+@param digest: The message digest to use, a Digest object or its name\n\
+@return: The Signer object\n\
+";
+
+static char crypto_Verifier_doc[] = "\n\
+Verifier(cert, digest) -> Verifier instance\n\
+\n\
+Verify the signature of data fed in any number of pieces, without holding\n\
+all of it in memory.\n\
+\n\
+@param cert: The signing certificate (X509 object)\n\
+@param digest: The message digest to use, a Digest object or its name\n\
+@return: The Verifier object\n\
+";
+
+PyTypeObject crypto_Signer_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "Signer",
+    sizeof(crypto_SignerObj),
+    0,
+    (destructor)crypto_Signer_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_Signer_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_Signer_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_Signer_new, /* tp_new */
+};
+
+PyTypeObject crypto_Verifier_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "Verifier",
+    sizeof(crypto_SignerObj),
+    0,
+    (destructor)crypto_Signer_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_Verifier_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_Verifier_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_Verifier_new, /* tp_new */
+};
+
+/*
+ * Initialize the Signer and Verifier part of the crypto module
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_signer(PyObject *module)
+{
+    if (PyType_Ready(&crypto_Signer_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "Signer", (PyObject *)&crypto_Signer_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "SignerType", (PyObject *)&crypto_Signer_Type) != 0) {
+        return 0;
+    }
+
+    if (PyType_Ready(&crypto_Verifier_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "Verifier", (PyObject *)&crypto_Verifier_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "VerifierType", (PyObject *)&crypto_Verifier_Type) != 0) {
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,49 @@
+/*
+ * signer.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the incremental signing and verification contexts and the functions
+ * signing and verifying a buffer in one go.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_SIGNER_H_
+#define PyOpenSSL_crypto_SIGNER_H_
+
+#include <Python.h>
+#include <openssl/evp.h>
+#ifdef WITH_THREAD
+#include <pythread.h>
+#endif
+
+extern  int       init_crypto_signer   (PyObject *);
+
+extern  PyTypeObject      crypto_Signer_Type;
+extern  PyTypeObject      crypto_Verifier_Type;
+
+#define crypto_Signer_Check(v) ((v)->ob_type == &crypto_Signer_Type)
+#define crypto_Verifier_Check(v) ((v)->ob_type == &crypto_Verifier_Type)
+
+/*
+ * Signer and Verifier objects share their layout.
+ */
+typedef struct {
+    PyObject_HEAD
+    EVP_MD_CTX          *ctx;
+    EVP_PKEY            *pkey;
+    int                  finished;
+#ifdef WITH_THREAD
+    /* Serializes updates, which run without the GIL for large buffers */
+    PyThread_type_lock   lock;
+#endif
+} crypto_SignerObj;
+
+extern  int       crypto_digest_sign     (EVP_MD_CTX *, EVP_PKEY *, const EVP_MD *,
+                                          const void *, size_t,
+                                          unsigned char *, size_t *);
+extern  int       crypto_digest_verify   (EVP_MD_CTX *, EVP_PKEY *, const EVP_MD *,
+                                          const unsigned char *, size_t,
+                                          const void *, size_t);
+
+#endif
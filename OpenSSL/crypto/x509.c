@@ -22,6 +22,32 @@
  * http://www.openssl.org/ for more information
  */
 
+/*
+ * Get ready to modify an X509 object
+ *
+ * Arguments: self - The X509 object
+ * Returns:   1 if it can be modified, 0 with an exception set otherwise
+ */
+int
+crypto_X509_modify(crypto_X509Obj *self)
+{
+    if (self->readonly)
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "X509 object is shared by the certificate cache and "
+                        "can't be modified");
+        return 0;
+    }
+    if (self->in_use)
+    {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "X509 object is being read by extract_fields");
+        return 0;
+    }
+    crypto_DERDigest_invalidate(&self->der_digest);
+    return 1;
+}
+
 static char crypto_X509_get_version_doc[] = "\n\
 Return version number of the certificate\n\
 \n\
@@ -52,12 +78,46 @@ crypto_X509_set_version(crypto_X509Obj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "i:set_version", &version))
         return NULL;
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+
     X509_set_version(self->x509, version);
 
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+/*
+ * Return the serial number of a certificate, converting it the first time
+ *
+ * Arguments: self - The X509 object
+ * Returns:   A new reference to the serial number, or NULL on error
+ */
+static PyObject *
+cached_serial_number(crypto_X509Obj *self)
+{
+    ASN1_INTEGER *asn1_i;
+    BIGNUM *bignum;
+    char *hex;
+    PyObject *res;
+
+    if (self->serial_number == NULL)
+    {
+        asn1_i = X509_get_serialNumber(self->x509);
+        bignum = ASN1_INTEGER_to_BN(asn1_i, NULL);
+        hex = BN_bn2hex(bignum);
+        res = PyLong_FromString(hex, NULL, 16);
+        BN_free(bignum);
+        free(hex);
+        if (res == NULL)
+            return NULL;
+        self->serial_number = res;
+    }
+
+    Py_INCREF(self->serial_number);
+    return self->serial_number;
+}
+
 static char crypto_X509_get_serial_number_doc[] = "\n\
 Return serial number of the certificate\n\
 \n\
@@ -67,21 +127,10 @@ Return serial number of the certificate\n\
 static PyObject *
 crypto_X509_get_serial_number(crypto_X509Obj *self, PyObject *args)
 {
-    ASN1_INTEGER *asn1_i;
-    BIGNUM *bignum;
-    char *hex;
-    PyObject *res;
-
     if (!PyArg_ParseTuple(args, ":get_serial_number"))
         return NULL;
 
-    asn1_i = X509_get_serialNumber(self->x509);
-    bignum = ASN1_INTEGER_to_BN(asn1_i, NULL);
-    hex = BN_bn2hex(bignum);
-    res = PyLong_FromString(hex, NULL, 16);
-    BN_free(bignum);
-    free(hex);
-    return res;
+    return cached_serial_number(self);
 }
 
 static char crypto_X509_set_serial_number_doc[] = "\n\
@@ -105,6 +154,10 @@ crypto_X509_set_serial_number(crypto_X509Obj *self, PyObject *args)
         return NULL;
     }
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->serial_number);
+
     if (!PyOpenSSL_Integer_Check(serial)) {
         PyErr_SetString(
             PyExc_TypeError, "serial number must be integer");
@@ -175,6 +228,33 @@ crypto_X509_set_serial_number(crypto_X509Obj *self, PyObject *args)
     return NULL;
 }
 
+/*
+ * Return the X509Name object for one of the names of a certificate, creating
+ * it the first time
+ *
+ * Arguments: self  - The X509 object
+ *            cache - Where the X509Name object is kept
+ *            name  - The name
+ * Returns:   A new reference to the X509Name object, or NULL on error
+ */
+static PyObject *
+cached_name(crypto_X509Obj *self, PyObject **cache, X509_NAME *name)
+{
+    crypto_X509NameObj *pyname;
+
+    if (*cache == NULL)
+    {
+        if ((pyname = crypto_X509Name_New(name, 0)) == NULL)
+            return NULL;
+        pyname->parent_cert = (PyObject *)self;
+        Py_INCREF(self);
+        *cache = (PyObject *)pyname;
+    }
+
+    Py_INCREF(*cache);
+    return *cache;
+}
+
 static char crypto_X509_get_issuer_doc[] = "\n\
 Create an X509Name object for the issuer of the certificate\n\
 \n\
@@ -184,40 +264,44 @@ Create an X509Name object for the issuer of the certificate\n\
 static PyObject *
 crypto_X509_get_issuer(crypto_X509Obj *self, PyObject *args)
 {
-    crypto_X509NameObj *pyname;
-    X509_NAME *name;
-
     if (!PyArg_ParseTuple(args, ":get_issuer"))
         return NULL;
 
-    name = X509_get_issuer_name(self->x509);
-    pyname = crypto_X509Name_New(name, 0);
-    if (pyname != NULL)
-    {
-        pyname->parent_cert = (PyObject *)self;
-        Py_INCREF(self);
-    }
-    return (PyObject *)pyname;
+    return cached_name(self, &self->issuer, X509_get_issuer_name(self->x509));
 }
 
 static char crypto_X509_set_issuer_doc[] = "\n\
 Set the issuer of the certificate\n\
 \n\
-@param issuer: The issuer name\n\
-@type issuer: L{X509Name}\n\
+@param issuer: The issuer name, or a sequence of components as\n\
+               accepted by L{X509Name.set_components}\n\
+@type issuer: L{X509Name} or sequence\n\
 @return: None\n\
 ";
 
 static PyObject *
 crypto_X509_set_issuer(crypto_X509Obj *self, PyObject *args)
 {
-    crypto_X509NameObj *issuer;
+    PyObject *issuer;
+
+    if (!PyArg_ParseTuple(args, "O:set_issuer", &issuer))
+        return NULL;
 
-    if (!PyArg_ParseTuple(args, "O!:set_issuer", &crypto_X509Name_Type,
-			  &issuer))
+    if (!crypto_X509_modify(self))
         return NULL;
 
-    if (!X509_set_issuer_name(self->x509, issuer->x509_name))
+    if (!crypto_X509Name_Check(issuer))
+    {
+        /* The components go straight into the certificate's own name */
+        if (!crypto_X509Name_fill(X509_get_issuer_name(self->x509), issuer))
+            return NULL;
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    Py_CLEAR(self->issuer);
+    if (!X509_set_issuer_name(self->x509,
+                              ((crypto_X509NameObj *)issuer)->x509_name))
     {
         exception_from_error_queue(crypto_Error);
         return NULL;
@@ -236,40 +320,44 @@ Create an X509Name object for the subject of the certificate\n\
 static PyObject *
 crypto_X509_get_subject(crypto_X509Obj *self, PyObject *args)
 {
-    crypto_X509NameObj *pyname;
-    X509_NAME *name;
-
     if (!PyArg_ParseTuple(args, ":get_subject"))
         return NULL;
 
-    name = X509_get_subject_name(self->x509);
-    pyname = crypto_X509Name_New(name, 0);
-    if (pyname != NULL)
-    {
-        pyname->parent_cert = (PyObject *)self;
-        Py_INCREF(self);
-    }
-    return (PyObject *)pyname;
+    return cached_name(self, &self->subject, X509_get_subject_name(self->x509));
 }
 
 static char crypto_X509_set_subject_doc[] = "\n\
 Set the subject of the certificate\n\
 \n\
-@param subject: The subject name\n\
-@type subject: L{X509Name}\n\
+@param subject: The subject name, or a sequence of components as\n\
+                accepted by L{X509Name.set_components}\n\
+@type subject: L{X509Name} or sequence\n\
 @return: None\n\
 ";
 
 static PyObject *
 crypto_X509_set_subject(crypto_X509Obj *self, PyObject *args)
 {
-    crypto_X509NameObj *subject;
+    PyObject *subject;
 
-    if (!PyArg_ParseTuple(args, "O!:set_subject", &crypto_X509Name_Type,
-			  &subject))
+    if (!PyArg_ParseTuple(args, "O:set_subject", &subject))
         return NULL;
 
-    if (!X509_set_subject_name(self->x509, subject->x509_name))
+    if (!crypto_X509_modify(self))
+        return NULL;
+
+    if (!crypto_X509Name_Check(subject))
+    {
+        /* The components go straight into the certificate's own name */
+        if (!crypto_X509Name_fill(X509_get_subject_name(self->x509), subject))
+            return NULL;
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    Py_CLEAR(self->subject);
+    if (!X509_set_subject_name(self->x509,
+                              ((crypto_X509NameObj *)subject)->x509_name))
     {
         exception_from_error_queue(crypto_Error);
         return NULL;
@@ -323,6 +411,9 @@ crypto_X509_set_pubkey(crypto_X509Obj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O!:set_pubkey", &crypto_PKey_Type, &pkey))
         return NULL;
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+
     if (!X509_set_pubkey(self->x509, pkey->pkey))
     {
         exception_from_error_queue(crypto_Error);
@@ -372,7 +463,11 @@ Set the time stamp for when the certificate starts being valid\n\
 static PyObject*
 crypto_X509_set_notBefore(crypto_X509Obj *self, PyObject *args)
 {
-	return _set_asn1_time(
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->not_before);
+
+    return _set_asn1_time(
             BYTESTRING_FMT ":set_notBefore",
             X509_get_notBefore(self->x509), args);
 }
@@ -392,21 +487,28 @@ Set the time stamp for when the certificate stops being valid\n\
 static PyObject*
 crypto_X509_set_notAfter(crypto_X509Obj *self, PyObject *args)
 {
-	return _set_asn1_time(
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->not_after);
+
+    return _set_asn1_time(
             BYTESTRING_FMT ":set_notAfter",
             X509_get_notAfter(self->x509), args);
 }
 
-PyObject*
-_get_asn1_time(char *format, ASN1_TIME* timestamp, PyObject *args)
+/*
+ * Convert a time stamp to a GeneralizedTime byte string
+ *
+ * Arguments: timestamp - The time stamp
+ * Returns:   A new reference to the byte string, None if the time stamp is
+ *            not set, or NULL on error
+ */
+static PyObject*
+asn1_time_to_bytes(ASN1_TIME* timestamp)
 {
 	ASN1_GENERALIZEDTIME *gt_timestamp = NULL;
 	PyObject *py_timestamp = NULL;
 
-	if (!PyArg_ParseTuple(args, format)) {
-		return NULL;
-	}
-
 	/*
 	 * http://www.columbia.edu/~ariel/ssleay/asn1-time.html
 	 */
@@ -432,6 +534,33 @@ _get_asn1_time(char *format, ASN1_TIME* timestamp, PyObject *args)
 	}
 }
 
+PyObject*
+_get_asn1_time(char *format, ASN1_TIME* timestamp, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, format)) {
+		return NULL;
+	}
+
+	return asn1_time_to_bytes(timestamp);
+}
+
+/*
+ * Return one of the time stamps of a certificate, converting it the first time
+ *
+ * Arguments: cache     - Where the converted time stamp is kept
+ *            timestamp - The time stamp
+ * Returns:   A new reference to the byte string or None, or NULL on error
+ */
+static PyObject*
+cached_time(PyObject **cache, ASN1_TIME *timestamp)
+{
+    if (*cache == NULL && (*cache = asn1_time_to_bytes(timestamp)) == NULL)
+        return NULL;
+
+    Py_INCREF(*cache);
+    return *cache;
+}
+
 static char crypto_X509_get_notBefore_doc[] = "\n\
 Retrieve the time stamp for when the certificate starts being valid\n\
 \n\
@@ -446,11 +575,13 @@ Retrieve the time stamp for when the certificate starts being valid\n\
 static PyObject*
 crypto_X509_get_notBefore(crypto_X509Obj *self, PyObject *args)
 {
-	/*
-	 * X509_get_notBefore returns a borrowed reference.
-	 */
-	return _get_asn1_time(
-		":get_notBefore", X509_get_notBefore(self->x509), args);
+    if (!PyArg_ParseTuple(args, ":get_notBefore"))
+        return NULL;
+
+    /*
+     * X509_get_notBefore returns a borrowed reference.
+     */
+    return cached_time(&self->not_before, X509_get_notBefore(self->x509));
 }
 
 
@@ -468,11 +599,13 @@ Retrieve the time stamp for when the certificate stops being valid\n\
 static PyObject*
 crypto_X509_get_notAfter(crypto_X509Obj *self, PyObject *args)
 {
-	/*
-	 * X509_get_notAfter returns a borrowed reference.
-	 */
-	return _get_asn1_time(
-		":get_notAfter", X509_get_notAfter(self->x509), args);
+    if (!PyArg_ParseTuple(args, ":get_notAfter"))
+        return NULL;
+
+    /*
+     * X509_get_notAfter returns a borrowed reference.
+     */
+    return cached_time(&self->not_after, X509_get_notAfter(self->x509));
 }
 
 
@@ -493,6 +626,10 @@ crypto_X509_gmtime_adj_notBefore(crypto_X509Obj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "l:gmtime_adj_notBefore", &amount))
         return NULL;
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->not_before);
+
     X509_gmtime_adj(X509_get_notBefore(self->x509), amount);
 
     Py_INCREF(Py_None);
@@ -515,6 +652,10 @@ crypto_X509_gmtime_adj_notAfter(crypto_X509Obj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "l:gmtime_adj_notAfter", &amount))
         return NULL;
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->not_after);
+
     X509_gmtime_adj(X509_get_notAfter(self->x509), amount);
 
     Py_INCREF(Py_None);
@@ -558,7 +699,8 @@ static char crypto_X509_sign_doc[] = "\n\
 Sign the certificate using the supplied key and digest\n\
 \n\
 @param pkey: The key to sign with\n\
-@param digest: The message digest to use\n\
+@param digest: The message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
 @return: None\n\
 ";
 
@@ -566,11 +708,13 @@ static PyObject *
 crypto_X509_sign(crypto_X509Obj *self, PyObject *args)
 {
     crypto_PKeyObj *pkey;
-    char *digest_name;
     const EVP_MD *digest;
 
-    if (!PyArg_ParseTuple(args, "O!s:sign", &crypto_PKey_Type, &pkey,
-			  &digest_name))
+    if (!PyArg_ParseTuple(args, "O!O&:sign", &crypto_PKey_Type, &pkey,
+			  crypto_sign_digest_converter, &digest))
+        return NULL;
+
+    if (!crypto_X509_modify(self))
         return NULL;
 
     if (pkey->only_public) {
@@ -583,12 +727,6 @@ crypto_X509_sign(crypto_X509Obj *self, PyObject *args)
 	return NULL;
     }
 
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL)
-    {
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
-        return NULL;
-    }
-
     if (!X509_sign(self->x509, pkey->pkey, digest))
     {
         exception_from_error_queue(crypto_Error);
@@ -638,41 +776,45 @@ crypto_X509_subject_name_hash(crypto_X509Obj *self, PyObject *args)
 static char crypto_X509_digest_doc[] = "\n\
 Return the digest of the X509 object.\n\
 \n\
+@param digest: The message digest to use, a Digest object or its name\n\
+@param raw: (optional) if true, return the digest as raw bytes instead of\n\
+            colon separated hex\n\
 @return: The digest of the object\n\
 ";
 
 static PyObject *
-crypto_X509_digest(crypto_X509Obj *self, PyObject *args)
+crypto_X509_digest(crypto_X509Obj *self, PyObject *args, PyObject *kwargs)
 {
+    static const char hex[] = "0123456789ABCDEF";
     unsigned char fp[EVP_MAX_MD_SIZE];
-    char *tmp;
-    char *digest_name;
-    unsigned int len,i;
-    PyObject *ret;
+    char tmp[3 * EVP_MAX_MD_SIZE];
+    unsigned int len, i;
     const EVP_MD *digest;
+    int raw = 0;
 
-    if (!PyArg_ParseTuple(args, "s:digest", &digest_name))
-        return NULL;
+    static char *kwlist[] = {"digest", "raw", NULL};
 
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL)
-    {
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|i:digest", kwlist,
+                                     crypto_digest_converter, &digest, &raw))
         return NULL;
-    }
 
-    if (!X509_digest(self->x509,digest,fp,&len))
+    if (!X509_digest(self->x509, digest, fp, &len))
     {
         exception_from_error_queue(crypto_Error);
+        return NULL;
     }
-    tmp = malloc(3*len+1);
-    memset(tmp, 0, 3*len+1);
+
+    if (raw)
+        return PyBytes_FromStringAndSize((char *)fp, len);
+
+    if (len == 0)
+        return PyBytes_FromStringAndSize(NULL, 0);
     for (i = 0; i < len; i++) {
-        sprintf(tmp+i*3,"%02X:",fp[i]);
+        tmp[3 * i] = hex[fp[i] >> 4];
+        tmp[3 * i + 1] = hex[fp[i] & 0xf];
+        tmp[3 * i + 2] = ':';
     }
-    tmp[3*len-1] = 0;
-    ret = PyBytes_FromStringAndSize(tmp,3*len-1);
-    free(tmp);
-    return ret;
+    return PyBytes_FromStringAndSize(tmp, 3 * len - 1);
 }
 
 
@@ -693,6 +835,10 @@ crypto_X509_add_extensions(crypto_X509Obj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O:add_extensions", &extensions))
         return NULL;
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->subject_alt_name);
+
     seq = PySequence_Fast(extensions, "Expected a sequence");
     if (seq == NULL)
         return NULL;
@@ -769,6 +915,127 @@ crypto_X509_get_extension(crypto_X509Obj *self, PyObject *args) {
 }
 
 
+/*
+ * Convert the names of a subjectAltName extension to Python
+ *
+ * Arguments: alt_names - The names, which are only read
+ * Returns:   A new reference to a list of (type, name) tuples, or NULL on
+ *            error
+ */
+PyObject *
+crypto_GeneralNames_to_list(GENERAL_NAMES *alt_names)
+{
+    GENERAL_NAME *gen_name;
+    ASN1_STRING *str;
+    PyObject *result, *tuple;
+    char ip[16];    /* ###.###.###.###\0 is 16 characters */
+    int i;
+
+    if ((result = PyList_New(0)) == NULL)
+        return NULL;
+
+    for (i = 0; i < sk_GENERAL_NAME_num(alt_names); i++)
+    {
+        gen_name = sk_GENERAL_NAME_value(alt_names, i);
+
+        switch (gen_name->type)
+        {
+            case GEN_EMAIL:
+                str = gen_name->d.rfc822Name;
+                break;
+
+            case GEN_DNS:
+                str = gen_name->d.dNSName;
+                break;
+
+            case GEN_URI:
+                str = gen_name->d.uniformResourceIdentifier;
+                break;
+
+            case GEN_IPADD:
+                str = NULL;
+                inet_ntop(AF_INET, gen_name->d.iPAddress->data, ip, sizeof(ip));
+                break;
+
+            default:
+                /* unsupported type -- ignore this entry */
+                continue;
+        }
+
+        if (str != NULL)
+            tuple = Py_BuildValue("(i" BYTESTRING_FMT "#)", gen_name->type,
+                                  ASN1_STRING_get0_data(str),
+                                  ASN1_STRING_length(str));
+        else
+            tuple = Py_BuildValue("(i" BYTESTRING_FMT ")", gen_name->type, ip);
+
+        if (tuple == NULL || PyList_Append(result, tuple) == -1)
+        {
+            Py_XDECREF(tuple);
+            Py_CLEAR(result);
+            break;
+        }
+        Py_DECREF(tuple);
+    }
+
+    return result;
+}
+
+/*
+ * Decode the subjectAltName extension of a certificate
+ *
+ * Arguments: cert - The certificate
+ * Returns:   A new reference to a list of (type, name) tuples, None if there
+ *            is no subjectAltName extension, or NULL on error
+ */
+static PyObject *
+decode_subject_alt_name(X509 *cert)
+{
+    GENERAL_NAMES *alt_names;
+    PyObject *result;
+
+    alt_names = X509_get_ext_d2i(cert, NID_subject_alt_name, NULL, NULL);
+    if (alt_names == NULL)
+    {
+        /* no subjectAltName extension */
+        flush_error_queue();
+        Py_RETURN_NONE;
+    }
+
+    result = crypto_GeneralNames_to_list(alt_names);
+    GENERAL_NAMES_free(alt_names);
+    return result;
+}
+
+/*
+ * Return the subjectAltName names of a certificate, decoding them the first
+ * time
+ *
+ * Arguments: self - The X509 object
+ * Returns:   A new list of (type, name) tuples, None if there is no
+ *            subjectAltName extension, or NULL on error
+ */
+static PyObject *
+cached_subject_alt_name(crypto_X509Obj *self)
+{
+    if (self->subject_alt_name == NULL)
+    {
+        self->subject_alt_name = decode_subject_alt_name(self->x509);
+        if (self->subject_alt_name == NULL)
+            return NULL;
+    }
+
+    if (self->subject_alt_name == Py_None)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    /* The list is copied so that callers can't change the cached one */
+    return PyList_GetSlice(self->subject_alt_name, 0,
+                           PyList_GET_SIZE(self->subject_alt_name));
+}
+
 static char crypto_X509_get_subject_alt_name_doc[] = "\n\
 Return the contents of the subjectAltName extension.\n\
 \n\
@@ -781,115 +1048,10 @@ Returns:   A list of (int type, str altname) pairs (tuples)\n\
 static PyObject *
 crypto_X509_get_subject_alt_name(crypto_X509Obj *self, PyObject *args)
 {
-    X509 *cert = self->x509;
-    int ext_ndx;
-    char *buf;
-
-    ext_ndx = X509_get_ext_by_NID(cert, NID_subject_alt_name, -1);
-    if (ext_ndx >= 0)
-    {
-        /* subjectAltName extension found */
-        X509_EXTENSION *ext;
-        STACK_OF(GENERAL_NAME) *alt_names;
-        GENERAL_NAME *gen_name;
-
-        ext = X509_get_ext(cert, ext_ndx);
-        alt_names = X509V3_EXT_d2i(ext);
-        if (alt_names)
-        {
-            int num;
-            int i;
-            PyObject *result;
-
-            num = sk_GENERAL_NAME_num(alt_names);
-            result = PyList_New(0);
-
-            for (i = 0; i < num; i++)
-            {
-                PyObject *tuple;
-                PyObject *pybuf;
-                char *name;
-                size_t name_len;
-                int copy_name = 0;    /* set to 1 if name should be copied into buf */
-
-                gen_name = sk_GENERAL_NAME_value(alt_names, i);
-
-                /* allocate buf and put a string representation of the name into it */
-                switch (gen_name->type)
-                {
-                    case GEN_EMAIL:
-                        name = (char *)ASN1_STRING_get0_data(gen_name->d.rfc822Name);
-                        name_len = ASN1_STRING_length(gen_name->d.rfc822Name);
-                        copy_name = 1;
-                        break;
-
-                    case GEN_DNS:
-                        name = (char *)ASN1_STRING_get0_data(gen_name->d.dNSName);
-                        name_len = ASN1_STRING_length(gen_name->d.dNSName);
-                        copy_name = 1;
-                        break;
-
-                    case GEN_URI:
-                        name = (char *)ASN1_STRING_get0_data(gen_name->d.uniformResourceIdentifier);
-                        name_len = ASN1_STRING_length(gen_name->d.uniformResourceIdentifier);
-                        copy_name = 1;
-                        break;
-
-                    case GEN_IPADD:
-                        buf = malloc(16);   /* ###.###.###.###\0 is 16 characters */
-                        inet_ntop(AF_INET, gen_name->d.iPAddress->data, buf, 16);
-                        break;
-
-                    default:
-                        /* unsupported type -- ignore this entry */
-                        continue;
-                }
-
-                if (copy_name)
-                {
-                    buf = malloc(name_len);
-                    if (buf == NULL)
-                    {
-                        PyErr_SetString(PyExc_MemoryError, "Could not allocate memory for the copy of name.");
-                        return NULL;
-                    }
-                    memcpy(buf, name, name_len);
-                    buf[name_len] = 0;
-                }
-
-                /* build the tuple and put it in the list */
-                /* we could use PyString_FromStringAndSize in the cases where we normally copy the name,
-                 * but not in the others. */
-                pybuf = PyString_FromString(buf);
-                free(buf);
-                if (pybuf == NULL)
-                {
-                    /* assuming that the only (or at least by far most likely) reason for this is
-                     * running out of memory */
-                    PyErr_SetString(PyExc_MemoryError, "Failed to create new string.");
-                    return NULL;
-                }
-                tuple = PyTuple_Pack(2, PyInt_FromLong(gen_name->type), pybuf);
-                if (tuple == NULL)
-                {
-                    /* assuming that the only (or at least by far most likely) reason for this is
-                     * running out of memory */
-                    PyErr_SetString(PyExc_MemoryError, "Failed to create new tuple.");
-                    return NULL;
-                }
-                if (PyList_Append(result, tuple) == -1)
-                {
-                    /* the exception was already set, according to the Python docs */
-                    return NULL;
-                }
-            }
-            sk_GENERAL_NAME_free(alt_names);
-            return result;
-        }
-    }
+    if (!PyArg_ParseTuple(args, ":get_subject_alt_name"))
+        return NULL;
 
-    /* no subjectAltName extension */
-    Py_RETURN_NONE;
+    return cached_subject_alt_name(self);
 }
 
 
@@ -906,15 +1068,15 @@ static PyObject *
 crypto_X509_verify(crypto_X509Obj *self, PyObject *args, PyObject *kwargs)
 {
     X509_STORE *store = NULL;
-    X509_STORE_CTX *context = NULL;
     X509_VERIFY_PARAM *verify_param = NULL;
     PyObject *result = NULL;
+    int err;
 
     int check_crls = 0;
     PyObject *file_list = NULL;
     PyObject *dir_list = NULL;
 
-    static char *kwlist[] = {"check_crls", "files", "dirs"};
+    static char *kwlist[] = {"check_crls", "files", "dirs", NULL};
 
     if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iOO", kwlist,
 				     &check_crls, &file_list, &dir_list))
@@ -953,11 +1115,15 @@ crypto_X509_verify(crypto_X509Obj *self, PyObject *args, PyObject *kwargs)
             if (item == NULL)
                 goto free_and_return;     /* Exception was set. Also, this shouldn't happen. */
 
-            string = PyString_AsString(item);
-            if (string == NULL)
+            string = PyBytes_AsString(item);
+            if (string == NULL) {
+                Py_DECREF(item);
                 goto free_and_return;     /* Exception was set. */
+            }
 
+            /* string points into item, so keep it alive until loaded */
             X509_STORE_load_locations(store, string, NULL);
+            Py_DECREF(item);
         }
     }
 
@@ -967,29 +1133,41 @@ crypto_X509_verify(crypto_X509Obj *self, PyObject *args, PyObject *kwargs)
 
         for (i = 0; i < PySequence_Size(dir_list); i++)
         {
-            PyObject *item;;
+            PyObject *item;
             char *string;
 
             item = PySequence_GetItem(dir_list, i);
             if (item == NULL)
                 goto free_and_return;     /* Exception was set. Also, this shouldn't happen. */
 
-            string = PyString_AsString(item);
-            if (string == NULL)
+            string = PyBytes_AsString(item);
+            if (string == NULL) {
+                Py_DECREF(item);
                 goto free_and_return;     /* Exception was set. */
+            }
 
+            /* string points into item, so keep it alive until loaded */
             X509_STORE_load_locations(store, NULL, string);
+            Py_DECREF(item);
         }
     }
 
-    context = X509_STORE_CTX_new();
-    X509_STORE_CTX_init(context, store, self->x509, NULL);
-    X509_verify_cert(context);
-    result = PyInt_FromLong(X509_STORE_CTX_get_error(context));
+    /*
+     * Loading the locations again for every call is expensive; X509Store
+     * keeps them around and should be preferred for repeated verification.
+     */
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    err = crypto_X509Store_verify_cert(store, self->x509, NULL, NULL);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if (err < 0)
+        exception_from_error_queue(crypto_Error);
+    else
+        result = PyLong_FromLong(err);
 
   free_and_return:
-    X509_STORE_CTX_cleanup(context);
-    X509_STORE_CTX_free(context);
+    flush_error_queue();
+    X509_STORE_free(store);
     X509_VERIFY_PARAM_free(verify_param);
 
     return result;
@@ -1012,6 +1190,10 @@ crypto_X509_del_extension(crypto_X509Obj *self, PyObject *args) {
         return NULL;
     }
 
+    if (!crypto_X509_modify(self))
+        return NULL;
+    Py_CLEAR(self->subject_alt_name);
+
     /* will return NULL if loc is out of the range of extensions */
     ext = X509_delete_ext(self->x509, loc);
     if (!ext) {
@@ -1025,6 +1207,77 @@ crypto_X509_del_extension(crypto_X509Obj *self, PyObject *args) {
     return Py_None;
 }
 
+/*
+ * Name a signature algorithm
+ *
+ * Arguments: nid - The NID of the signature algorithm
+ * Returns:   A new reference to its short name, None if it is undefined, or
+ *            NULL on error
+ */
+PyObject *
+crypto_signature_algorithm(int nid)
+{
+    if (nid == NID_undef)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    return PyBytes_FromString(OBJ_nid2sn(nid));
+}
+
+static char crypto_X509_to_dict_doc[] = "\n\
+Decode the whole certificate at once.\n\
+\n\
+@return: A dict with the version, serial_number, signature_algorithm,\n\
+         subject and issuer (as lists of (name, value) tuples, like\n\
+         X509Name.get_components), not_before, not_after, public_key (a dict\n\
+         with the type and bits of the key), subject_alt_name and\n\
+         extensions (a list of dicts with the name, critical flag, DER data\n\
+         and text value of each extension)\n\
+";
+
+static PyObject *
+crypto_X509_to_dict(crypto_X509Obj *self, PyObject *args)
+{
+    X509 *cert = self->x509;
+    EVP_PKEY *pkey;
+    PyObject *dict;
+
+    if (!PyArg_ParseTuple(args, ":to_dict"))
+        return NULL;
+
+    if ((dict = PyDict_New()) == NULL)
+        return NULL;
+
+    if ((pkey = X509_get0_pubkey(cert)) == NULL)
+        flush_error_queue();
+
+    if (dict_set_new(dict, "version",
+                     PyLong_FromLong(X509_get_version(cert))) < 0 ||
+        dict_set_new(dict, "serial_number", cached_serial_number(self)) < 0 ||
+        dict_set_new(dict, "signature_algorithm", crypto_signature_algorithm(
+                         X509_get_signature_nid(cert))) < 0 ||
+        dict_set_new(dict, "subject", crypto_X509Name_components(
+                         X509_get_subject_name(cert))) < 0 ||
+        dict_set_new(dict, "issuer", crypto_X509Name_components(
+                         X509_get_issuer_name(cert))) < 0 ||
+        dict_set_new(dict, "not_before", cached_time(
+                         &self->not_before, X509_get_notBefore(cert))) < 0 ||
+        dict_set_new(dict, "not_after", cached_time(
+                         &self->not_after, X509_get_notAfter(cert))) < 0 ||
+        dict_set_new(dict, "public_key", crypto_PKey_describe(pkey)) < 0 ||
+        dict_set_new(dict, "subject_alt_name",
+                     cached_subject_alt_name(self)) < 0 ||
+        dict_set_new(dict, "extensions", crypto_X509Extensions_to_list(
+                         X509_get0_extensions(cert))) < 0)
+    {
+        Py_DECREF(dict);
+        return NULL;
+    }
+
+    return dict;
+}
+
 /*
  * ADD_METHOD(name) expands to a correct PyMethodDef declaration
  *   {  'name', (PyCFunction)crypto_X509_name, METH_VARARGS }
@@ -1056,13 +1309,14 @@ static PyMethodDef crypto_X509_methods[] =
     ADD_METHOD(sign),
     ADD_METHOD(has_expired),
     ADD_METHOD(subject_name_hash),
-    ADD_METHOD(digest),
+    ADD_METHOD_KW(digest),
     ADD_METHOD(add_extensions),
     ADD_METHOD(get_extension),
     ADD_METHOD(get_extension_count),
     ADD_METHOD(get_subject_alt_name),
     ADD_METHOD_KW(verify),
     ADD_METHOD(del_extension),
+    ADD_METHOD(to_dict),
     { NULL, NULL }
 };
 #undef ADD_METHOD
@@ -1082,14 +1336,24 @@ crypto_X509_New(X509 *cert, int dealloc)
 {
     crypto_X509Obj *self;
 
-    self = PyObject_New(crypto_X509Obj, &crypto_X509_Type);
+    self = PyObject_GC_New(crypto_X509Obj, &crypto_X509_Type);
 
     if (self == NULL)
         return NULL;
 
     self->x509 = cert;
     self->dealloc = dealloc;
-
+    self->readonly = 0;
+    self->in_use = 0;
+    crypto_DERDigest_invalidate(&self->der_digest);
+    self->subject = NULL;
+    self->issuer = NULL;
+    self->serial_number = NULL;
+    self->not_before = NULL;
+    self->not_after = NULL;
+    self->subject_alt_name = NULL;
+
+    PyObject_GC_Track(self);
     return self;
 }
 
@@ -1113,6 +1377,42 @@ crypto_X509_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
 }
 
 
+/*
+ * Find out all the objects which the X509 object refers to, the cached
+ * X509Name objects refer back to it.
+ *
+ * Arguments: self - The X509 object
+ *            visit - Function to call
+ *            arg - Extra argument to visit
+ * Returns:   0 if all goes well, otherwise the return code from the first
+ *            call that gave non-zero result.
+ */
+static int
+crypto_X509_traverse(crypto_X509Obj *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->subject);
+    Py_VISIT(self->issuer);
+    return 0;
+}
+
+/*
+ * Decref all contained objects and zero the pointers.
+ *
+ * Arguments: self - The X509 object
+ * Returns:   Always 0.
+ */
+static int
+crypto_X509_clear(crypto_X509Obj *self)
+{
+    Py_CLEAR(self->subject);
+    Py_CLEAR(self->issuer);
+    Py_CLEAR(self->serial_number);
+    Py_CLEAR(self->not_before);
+    Py_CLEAR(self->not_after);
+    Py_CLEAR(self->subject_alt_name);
+    return 0;
+}
+
 /*
  * Deallocate the memory used by the X509 object
  *
@@ -1122,11 +1422,116 @@ crypto_X509_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
 static void
 crypto_X509_dealloc(crypto_X509Obj *self)
 {
+    PyObject_GC_UnTrack(self);
+    crypto_X509_clear(self);
+
     /* Sometimes we don't have to dealloc the "real" X509 pointer ourselves */
     if (self->dealloc)
         X509_free(self->x509);
 
-    PyObject_Del(self);
+    PyObject_GC_Del(self);
+}
+
+/*
+ * Make sure the DER digest of an object is up to date
+ *
+ * Arguments: digest - The cached digest
+ *            it     - The ASN.1 type of the object
+ *            obj    - The OpenSSL object
+ * Returns:   1 if the digest is valid, 0 if the object can't be encoded
+ */
+static int
+der_digest_update(crypto_DERDigest *digest, const ASN1_ITEM *it, void *obj)
+{
+    unsigned int len;
+
+    if (digest->state == 0)
+    {
+        if (ASN1_item_digest(it, EVP_sha256(), obj, digest->md, &len))
+        {
+            digest->state = 1;
+        }
+        else
+        {
+            /* Incomplete objects, a fresh X509 for instance, can't be encoded */
+            flush_error_queue();
+            digest->state = -1;
+        }
+    }
+    return digest->state == 1;
+}
+
+/*
+ * Hash an object by the digest of its DER encoding
+ *
+ * Arguments: digest - The cached digest
+ *            it     - The ASN.1 type of the object
+ *            obj    - The OpenSSL object
+ *            self   - The Python object, hashed by identity if the OpenSSL
+ *                     object can't be encoded
+ * Returns:   The hash value
+ */
+long
+crypto_DERDigest_hash(crypto_DERDigest *digest, const ASN1_ITEM *it, void *obj,
+                      PyObject *self)
+{
+    long hash;
+
+    if (!der_digest_update(digest, it, obj))
+        return _Py_HashPointer(self);
+
+    memcpy(&hash, digest->md, sizeof(hash));
+    if (hash == -1)
+        hash = -2;
+    return hash;
+}
+
+/*
+ * Compare two objects of the same type by the digests of their DER encodings
+ *
+ * Arguments: a, obj_a - The cached digest and the first OpenSSL object
+ *            b, obj_b - The cached digest and the second OpenSSL object
+ *            it       - The ASN.1 type of the objects
+ * Returns:   1 if they are equal, 0 otherwise.  Objects which can't be
+ *            encoded are only equal to themselves.
+ */
+int
+crypto_DERDigest_equal(crypto_DERDigest *a, void *obj_a,
+                       crypto_DERDigest *b, void *obj_b, const ASN1_ITEM *it)
+{
+    if (obj_a == obj_b)
+        return 1;
+    if (!der_digest_update(a, it, obj_a) || !der_digest_update(b, it, obj_b))
+        return 0;
+    return memcmp(a->md, b->md, sizeof(a->md)) == 0;
+}
+
+static long
+crypto_X509_hash(crypto_X509Obj *self)
+{
+    return crypto_DERDigest_hash(&self->der_digest, ASN1_ITEM_rptr(X509),
+                                 self->x509, (PyObject *)self);
+}
+
+static PyObject *
+crypto_X509_richcompare(PyObject *a, PyObject *b, int op)
+{
+    crypto_X509Obj *x, *y;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) ||
+        !crypto_X509_Check(a) || !crypto_X509_Check(b))
+    {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+
+    x = (crypto_X509Obj *)a;
+    y = (crypto_X509Obj *)b;
+    equal = crypto_DERDigest_equal(&x->der_digest, x->x509,
+                                   &y->der_digest, y->x509,
+                                   ASN1_ITEM_rptr(X509));
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
 }
 
 PyTypeObject crypto_X509_Type = {
@@ -1143,17 +1548,17 @@ PyTypeObject crypto_X509_Type = {
     NULL, /* as_number */
     NULL, /* as_sequence */
     NULL, /* as_mapping */
-    NULL, /* hash */
+    (hashfunc)crypto_X509_hash, /* hash */
     NULL, /* call */
     NULL, /* str */
     NULL, /* getattro */
     NULL, /* setattro */
     NULL, /* as_buffer */
-    Py_TPFLAGS_DEFAULT,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
     crypto_X509_doc, /* doc */
-    NULL, /* traverse */
-    NULL, /* clear */
-    NULL, /* tp_richcompare */
+    (traverseproc)crypto_X509_traverse, /* traverse */
+    (inquiry)crypto_X509_clear, /* clear */
+    (richcmpfunc)crypto_X509_richcompare, /* tp_richcompare */
     0, /* tp_weaklistoffset */
     NULL, /* tp_iter */
     NULL, /* tp_iternext */
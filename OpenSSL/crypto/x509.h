@@ -15,17 +15,56 @@
 
 #include <Python.h>
 #include <openssl/ssl.h>
+#include <openssl/sha.h>
+#include <openssl/x509v3.h>
 
 extern  PyTypeObject      crypto_X509_Type;
 
 #define crypto_X509_Check(v) ((v)->ob_type == &crypto_X509_Type)
 
+/*
+ * The SHA-256 digest of the DER encoding of an object, which its hash and
+ * equality are based on.  It is computed the first time it is needed and
+ * invalidated by everything that changes the object.
+ */
+typedef struct {
+    unsigned char        md[SHA256_DIGEST_LENGTH];
+    int                  state;     /* 0 unknown, 1 md valid, -1 not encodable */
+} crypto_DERDigest;
+
+#define crypto_DERDigest_invalidate(d) ((d)->state = 0)
+
+extern  long      crypto_DERDigest_hash     (crypto_DERDigest *, const ASN1_ITEM *,
+                                             void *, PyObject *);
+extern  int       crypto_DERDigest_equal    (crypto_DERDigest *, void *,
+                                             crypto_DERDigest *, void *,
+                                             const ASN1_ITEM *);
+
 typedef struct {
     PyObject_HEAD
     X509                *x509;
     int                  dealloc;
+    crypto_DERDigest     der_digest;
+    /* Shared through the certificate cache, so it must not be modified */
+    int                  readonly;
+    /* The number of extract_fields calls reading it without the GIL */
+    int                  in_use;
+    /*
+     * Decoded fields, built the first time they are asked for and dropped by
+     * the setters which change them
+     */
+    PyObject            *subject;
+    PyObject            *issuer;
+    PyObject            *serial_number;
+    PyObject            *not_before;
+    PyObject            *not_after;
+    PyObject            *subject_alt_name;
 } crypto_X509Obj;
 
+extern  int       crypto_X509_modify   (crypto_X509Obj *);
+extern  PyObject  *crypto_GeneralNames_to_list (GENERAL_NAMES *);
+extern  PyObject  *crypto_signature_algorithm  (int);
+
 PyObject* _set_asn1_time(char *format, ASN1_TIME* timestamp, PyObject *args);
 PyObject* _get_asn1_time(char *format, ASN1_TIME* timestamp, PyObject *args);
 extern  int       init_crypto_x509   (PyObject *);
@@ -0,0 +1,386 @@
+/*
+ * x509compact.c
+ *
+ * See LICENSE for details.
+ *
+ * A compact certificate type, which keeps only the DER encoding of a
+ * certificate and a few fields read from it, so that a large number of
+ * certificates can be held in memory.  The rest of the certificate is decoded
+ * on demand into an X509 object.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+/* The time stamps are stored as offsets from this one */
+static ASN1_TIME *epoch = NULL;
+
+/*
+ * Convert a time stamp to the number of seconds since the epoch
+ *
+ * Arguments: when    - The time stamp
+ *            seconds - Where to store the number of seconds
+ * Returns:   1 on success, 0 on error
+ */
+static int
+time_to_seconds(const ASN1_TIME *when, PY_LONG_LONG *seconds)
+{
+    int days, secs;
+
+    if (!ASN1_TIME_diff(&days, &secs, epoch, when))
+        return 0;
+    *seconds = (PY_LONG_LONG)days * 86400 + secs;
+    return 1;
+}
+
+/*
+ * Convert a number of seconds since the epoch to a GeneralizedTime byte string
+ *
+ * Arguments: seconds - The number of seconds
+ * Returns:   A new reference to the byte string, or NULL on error
+ */
+static PyObject *
+seconds_to_bytes(PY_LONG_LONG seconds)
+{
+    ASN1_GENERALIZEDTIME *when;
+    PyObject *result;
+
+    when = ASN1_GENERALIZEDTIME_adj(NULL, 0, (int)(seconds / 86400),
+                                    (long)(seconds % 86400));
+    if (when == NULL)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+    result = PyBytes_FromStringAndSize((char *)ASN1_STRING_get0_data(when),
+                                       ASN1_STRING_length(when));
+    ASN1_GENERALIZEDTIME_free(when);
+    return result;
+}
+
+/*
+ * Constructor for CompactX509 objects, never called by Python code directly
+ *
+ * Arguments: cert - The certificate, which is only read
+ * Returns:   The newly created CompactX509 object, or NULL with an exception
+ *            set
+ */
+static crypto_CompactX509Obj *
+crypto_CompactX509_New(X509 *cert)
+{
+    crypto_CompactX509Obj *self;
+    unsigned char *p;
+    int len;
+
+    if ((len = i2d_X509(cert, NULL)) < 0)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    self = PyObject_NewVar(crypto_CompactX509Obj, &crypto_CompactX509_Type, len);
+    if (self == NULL)
+        return NULL;
+
+    p = self->der;
+    i2d_X509(cert, &p);
+    self->hash = -1;
+    self->subject_hash = X509_subject_name_hash(cert);
+    if (!time_to_seconds(X509_get0_notBefore(cert), &self->not_before) ||
+        !time_to_seconds(X509_get0_notAfter(cert), &self->not_after))
+    {
+        Py_DECREF(self);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return self;
+}
+
+static char crypto_CompactX509_der_doc[] = "\n\
+Return the DER encoding of the certificate\n\
+\n\
+@return: The DER encoding as a byte string\n\
+";
+
+static PyObject *
+crypto_CompactX509_der(crypto_CompactX509Obj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":der"))
+        return NULL;
+
+    return PyBytes_FromStringAndSize((char *)self->der, Py_SIZE(self));
+}
+
+static char crypto_CompactX509_to_x509_doc[] = "\n\
+Decode the certificate\n\
+\n\
+@return: A new X509 object\n\
+";
+
+static PyObject *
+crypto_CompactX509_to_x509(crypto_CompactX509Obj *self, PyObject *args)
+{
+    const unsigned char *p = self->der;
+    X509 *cert;
+
+    if (!PyArg_ParseTuple(args, ":to_x509"))
+        return NULL;
+
+    if ((cert = d2i_X509(NULL, &p, Py_SIZE(self))) == NULL)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return (PyObject *)crypto_X509_New(cert, 1);
+}
+
+static char crypto_CompactX509_get_notBefore_doc[] = "\n\
+Retrieve the time stamp for when the certificate starts being valid\n\
+\n\
+@return: A string giving the timestamp, in the format YYYYMMDDhhmmssZ\n\
+";
+
+static PyObject *
+crypto_CompactX509_get_notBefore(crypto_CompactX509Obj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_notBefore"))
+        return NULL;
+
+    return seconds_to_bytes(self->not_before);
+}
+
+static char crypto_CompactX509_get_notAfter_doc[] = "\n\
+Retrieve the time stamp for when the certificate stops being valid\n\
+\n\
+@return: A string giving the timestamp, in the format YYYYMMDDhhmmssZ\n\
+";
+
+static PyObject *
+crypto_CompactX509_get_notAfter(crypto_CompactX509Obj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_notAfter"))
+        return NULL;
+
+    return seconds_to_bytes(self->not_after);
+}
+
+static char crypto_CompactX509_has_expired_doc[] = "\n\
+Check whether the certificate has expired.\n\
+\n\
+@return: True if the certificate has expired, false otherwise\n\
+";
+
+static PyObject *
+crypto_CompactX509_has_expired(crypto_CompactX509Obj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":has_expired"))
+        return NULL;
+
+    return PyLong_FromLong(self->not_after < (PY_LONG_LONG)time(NULL));
+}
+
+static char crypto_CompactX509_subject_name_hash_doc[] = "\n\
+Return the hash of the X509 subject.\n\
+\n\
+@return: The hash of the subject\n\
+";
+
+static PyObject *
+crypto_CompactX509_subject_name_hash(crypto_CompactX509Obj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":subject_name_hash"))
+        return NULL;
+
+    return PyLong_FromLongLong(self->subject_hash);
+}
+
+/*
+ * ADD_METHOD(name) expands to a correct PyMethodDef declaration
+ *   {  'name', (PyCFunction)crypto_CompactX509_name, METH_VARARGS }
+ * for convenience
+ */
+#define ADD_METHOD(name)        \
+    { #name, (PyCFunction)crypto_CompactX509_##name, METH_VARARGS, crypto_CompactX509_##name##_doc }
+static PyMethodDef crypto_CompactX509_methods[] =
+{
+    ADD_METHOD(der),
+    ADD_METHOD(to_x509),
+    ADD_METHOD(get_notBefore),
+    ADD_METHOD(get_notAfter),
+    ADD_METHOD(has_expired),
+    ADD_METHOD(subject_name_hash),
+    { NULL, NULL }
+};
+#undef ADD_METHOD
+
+
+static char crypto_CompactX509_doc[] = "\n\
+CompactX509(certificate) -> CompactX509 instance\n\
+\n\
+Create a compact copy of a certificate, which keeps only its DER encoding.\n\
+\n\
+@param certificate: An X509 object or the DER encoding of a certificate\n\
+@returns: The CompactX509 object\n\
+";
+
+static PyObject *
+crypto_CompactX509_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    PyObject *certificate, *self;
+    Py_buffer buffer;
+    const unsigned char *p;
+    X509 *cert;
+
+    if (!PyArg_ParseTuple(args, "O:CompactX509", &certificate))
+        return NULL;
+
+    if (crypto_X509_Check(certificate))
+        return (PyObject *)crypto_CompactX509_New(
+            ((crypto_X509Obj *)certificate)->x509);
+
+    if (!PyArg_Parse(certificate, BUFFER_FMT ":CompactX509", &buffer))
+        return NULL;
+
+    p = buffer.buf;
+    cert = d2i_X509(NULL, &p, buffer.len);
+    PyBuffer_Release(&buffer);
+    if (cert == NULL)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    self = (PyObject *)crypto_CompactX509_New(cert);
+    X509_free(cert);
+    return self;
+}
+
+/*
+ * Hash a CompactX509 object by the digest of its encoding, consistently with
+ * crypto_CompactX509_richcompare
+ *
+ * Arguments: self - The CompactX509 object
+ * Returns:   The hash value
+ */
+static long
+crypto_CompactX509_hash(crypto_CompactX509Obj *self)
+{
+    unsigned char md[SHA256_DIGEST_LENGTH];
+
+    if (self->hash == -1)
+    {
+        if (!EVP_Digest(self->der, Py_SIZE(self), md, NULL, EVP_sha256(), NULL))
+        {
+            flush_error_queue();
+            return _Py_HashPointer(self);
+        }
+        memcpy(&self->hash, md, sizeof(self->hash));
+        if (self->hash == -1)
+            self->hash = -2;
+    }
+    return self->hash;
+}
+
+static PyObject *
+crypto_CompactX509_richcompare(PyObject *a, PyObject *b, int op)
+{
+    crypto_CompactX509Obj *x, *y;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) ||
+        !crypto_CompactX509_Check(a) || !crypto_CompactX509_Check(b))
+    {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+
+    x = (crypto_CompactX509Obj *)a;
+    y = (crypto_CompactX509Obj *)b;
+    equal = Py_SIZE(x) == Py_SIZE(y) &&
+        memcmp(x->der, y->der, Py_SIZE(x)) == 0;
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+/*
+ * Deallocate the memory used by the CompactX509 object
+ *
+ * Arguments: self - The CompactX509 object
+ * Returns:   None
+ */
+static void
+crypto_CompactX509_dealloc(crypto_CompactX509Obj *self)
+{
+    PyObject_Del(self);
+}
+
+PyTypeObject crypto_CompactX509_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "CompactX509",
+    offsetof(crypto_CompactX509Obj, der),
+    1,
+    (destructor)crypto_CompactX509_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    (hashfunc)crypto_CompactX509_hash, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_CompactX509_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    (richcmpfunc)crypto_CompactX509_richcompare, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    NULL, /* tp_iter */
+    NULL, /* tp_iternext */
+    crypto_CompactX509_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_CompactX509_new, /* tp_new */
+};
+
+/*
+ * Initialize the CompactX509 part of the crypto module
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_compactx509(PyObject *module)
+{
+    if ((epoch = ASN1_TIME_set(NULL, 0)) == NULL) {
+        return 0;
+    }
+
+    if (PyType_Ready(&crypto_CompactX509_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "CompactX509", (PyObject *)&crypto_CompactX509_Type) != 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "CompactX509Type", (PyObject *)&crypto_CompactX509_Type) != 0) {
+        return 0;
+    }
+
+    return 1;
+}
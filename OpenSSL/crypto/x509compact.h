@@ -0,0 +1,36 @@
+/*
+ * x509compact.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the compact certificate type, which keeps only the DER encoding.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_X509COMPACT_H_
+#define PyOpenSSL_crypto_X509COMPACT_H_
+
+#include <Python.h>
+#include <openssl/ssl.h>
+
+extern  int       init_crypto_compactx509   (PyObject *);
+
+extern  PyTypeObject      crypto_CompactX509_Type;
+
+#define crypto_CompactX509_Check(v) ((v)->ob_type == &crypto_CompactX509_Type)
+
+/*
+ * The DER encoding of the certificate is stored inline, ob_size giving its
+ * length, along with the few fields which are read often enough that they
+ * shouldn't need decoding it.
+ */
+typedef struct {
+    PyObject_VAR_HEAD
+    long                 hash;          /* -1 until computed */
+    unsigned long        subject_hash;
+    PY_LONG_LONG         not_before;    /* Seconds since the epoch */
+    PY_LONG_LONG         not_after;
+    unsigned char        der[1];
+} crypto_CompactX509Obj;
+
+#endif
@@ -242,19 +242,19 @@ crypto_X509Extension_dealloc(crypto_X509ExtensionObj *self)
  * does not accurately reflect what's in the extension.
  */
 int
-crypto_X509Extension_str_subjectAltName(crypto_X509ExtensionObj *self, BIO *bio) {
+crypto_X509Extension_str_subjectAltName(X509_EXTENSION *ext, BIO *bio) {
     GENERAL_NAMES *names;
     const X509V3_EXT_METHOD *method = NULL;
     long i, length, num;
     const unsigned char *p = NULL;
     ASN1_OCTET_STRING *aos = NULL;
 
-    method = X509V3_EXT_get(self->x509_extension);
+    method = X509V3_EXT_get(ext);
     if (method == NULL) {
         return -1;
     }
 
-    aos = X509_EXTENSION_get_data(self->x509_extension);
+    aos = X509_EXTENSION_get_data(ext);
     if (aos == NULL) {
       return -1;
     }
@@ -312,22 +312,25 @@ crypto_X509Extension_str_subjectAltName(crypto_X509ExtensionObj *self, BIO *bio)
 }
 
 /*
- * Print a nice text representation of the certificate request.
+ * Print a nice text representation of an extension.
+ *
+ * Arguments: ext - The extension
+ * Returns:   A new reference to the text, or NULL with an exception set
  */
-static PyObject *
-crypto_X509Extension_str(crypto_X509ExtensionObj *self) {
+PyObject *
+crypto_X509Extension_text(X509_EXTENSION *ext) {
     int str_len;
     char *tmp_str;
     PyObject *str;
     BIO *bio = BIO_new(BIO_s_mem());
 
-    if (OBJ_obj2nid(X509_EXTENSION_get_object(self->x509_extension)) == NID_subject_alt_name) {
-        if (crypto_X509Extension_str_subjectAltName(self, bio) == -1) {
+    if (OBJ_obj2nid(X509_EXTENSION_get_object(ext)) == NID_subject_alt_name) {
+        if (crypto_X509Extension_str_subjectAltName(ext, bio) == -1) {
             BIO_free(bio);
             exception_from_error_queue(crypto_Error);
             return NULL;
         }
-    } else if (!X509V3_EXT_print(bio, self->x509_extension, 0, 0)) {
+    } else if (!X509V3_EXT_print(bio, ext, 0, 0)) {
         BIO_free(bio);
         exception_from_error_queue(crypto_Error);
         return NULL;
@@ -341,6 +344,60 @@ crypto_X509Extension_str(crypto_X509ExtensionObj *self) {
     return str;
 }
 
+static PyObject *
+crypto_X509Extension_str(crypto_X509ExtensionObj *self) {
+    return crypto_X509Extension_text(self->x509_extension);
+}
+
+/*
+ * Describe a list of extensions
+ *
+ * Arguments: exts - The extensions, which may be NULL
+ * Returns:   A new reference to a list with a dict per extension, giving its
+ *            short name, whether it is critical, its DER data and its text
+ *            (None if OpenSSL can't print it), or NULL with an exception set
+ */
+PyObject *
+crypto_X509Extensions_to_list(const STACK_OF(X509_EXTENSION) *exts) {
+    X509_EXTENSION *ext;
+    ASN1_OCTET_STRING *data;
+    PyObject *list, *dict, *text;
+    int i, n = sk_X509_EXTENSION_num(exts);
+
+    if ((list = PyList_New(n > 0 ? n : 0)) == NULL)
+        return NULL;
+
+    for (i = 0; i < n; i++) {
+        ext = sk_X509_EXTENSION_value(exts, i);
+        if ((dict = PyDict_New()) == NULL)
+            goto error;
+        PyList_SET_ITEM(list, i, dict);
+
+        if ((text = crypto_X509Extension_text(ext)) == NULL) {
+            /* Unknown extensions have no text form */
+            PyErr_Clear();
+            Py_INCREF(Py_None);
+            text = Py_None;
+        }
+        data = X509_EXTENSION_get_data(ext);
+        if (dict_set_new(dict, "name", PyBytes_FromString(
+                OBJ_nid2sn(OBJ_obj2nid(X509_EXTENSION_get_object(ext))))) < 0 ||
+            dict_set_new(dict, "critical", PyBool_FromLong(
+                X509_EXTENSION_get_critical(ext))) < 0 ||
+            dict_set_new(dict, "data", PyBytes_FromStringAndSize(
+                (const char *)ASN1_STRING_get0_data(data),
+                ASN1_STRING_length(data))) < 0 ||
+            dict_set_new(dict, "value", text) < 0)
+            goto error;
+    }
+
+    return list;
+
+  error:
+    Py_DECREF(list);
+    return NULL;
+}
+
 PyTypeObject crypto_X509Extension_Type = {
     PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
     "X509Extension",
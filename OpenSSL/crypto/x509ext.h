@@ -19,6 +19,9 @@ extern  int     init_crypto_x509extension       (PyObject *);
 
 extern  PyTypeObject      crypto_X509Extension_Type;
 
+extern  PyObject  *crypto_X509Extension_text      (X509_EXTENSION *);
+extern  PyObject  *crypto_X509Extensions_to_list  (const STACK_OF(X509_EXTENSION) *);
+
 #define crypto_X509Extension_Check(v) ( \
         PyObject_TypeCheck((v),         \
                            &crypto_X509Extension_Type))
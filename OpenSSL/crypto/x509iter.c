@@ -0,0 +1,180 @@
+/*
+ * x509iter.c
+ *
+ * See LICENSE for details.
+ *
+ * Reading all the certificates in a PEM or DER bundle, one after another.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ */
+#include <Python.h>
+#define crypto_MODULE
+#include "crypto.h"
+
+/*
+ * Read the next certificate from a BIO.  Doesn't touch any Python object, so
+ * it can be called with the GIL released.
+ *
+ * Arguments: bio  - The BIO to read from
+ *            type - The file type (X509_FILETYPE_PEM or X509_FILETYPE_ASN1)
+ *            eof  - Set to 1 if there was no certificate left to read
+ * Returns:   The certificate, or NULL at the end of the data (eof is set) or
+ *            on error (the error is in the OpenSSL error queue)
+ */
+X509 *
+crypto_X509_read_bio(BIO *bio, int type, int *eof)
+{
+    X509 *cert;
+    unsigned long err;
+
+    *eof = 0;
+    if (type == X509_FILETYPE_PEM)
+    {
+        if ((cert = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL)
+            return cert;
+
+        /* Running out of PEM blocks is how the end of the bundle shows */
+        err = ERR_peek_last_error();
+        if (ERR_GET_LIB(err) == ERR_LIB_PEM &&
+            ERR_GET_REASON(err) == PEM_R_NO_START_LINE)
+        {
+            ERR_clear_error();
+            *eof = 1;
+        }
+        return NULL;
+    }
+
+    if (BIO_eof(bio))
+    {
+        *eof = 1;
+        return NULL;
+    }
+    return d2i_X509_bio(bio, NULL);
+}
+
+/*
+ * Create an iterator over the certificates in a buffer
+ *
+ * Arguments: type - The file type (X509_FILETYPE_PEM or X509_FILETYPE_ASN1)
+ *            view - The buffer, which the iterator takes over (it is released
+ *                   even if this fails)
+ * Returns:   The new iterator, or NULL with an exception set
+ */
+PyObject *
+crypto_X509Iterator_New(int type, Py_buffer *view)
+{
+    crypto_X509IteratorObj *self;
+
+    self = PyObject_New(crypto_X509IteratorObj, &crypto_X509Iterator_Type);
+    if (self == NULL)
+    {
+        PyBuffer_Release(view);
+        return NULL;
+    }
+
+    self->view = *view;
+    self->type = type;
+    self->busy = 0;
+    if ((self->bio = crypto_buffer_to_bio(&self->view)) == NULL)
+    {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+static PyObject *
+crypto_X509Iterator_iternext(crypto_X509IteratorObj *self)
+{
+    X509 *cert;
+    int eof;
+
+    if (self->bio == NULL)
+        return NULL;
+
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_ValueError, "iterator already executing");
+        return NULL;
+    }
+
+    self->busy = 1;
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    cert = crypto_X509_read_bio(self->bio, self->type, &eof);
+    MY_END_ALLOW_THREADS(ignored);
+    self->busy = 0;
+
+    if (cert != NULL)
+        return (PyObject *)crypto_X509_New(cert, 1);
+
+    /* Either the end or an error, there is nothing more to read */
+    BIO_free(self->bio);
+    self->bio = NULL;
+    if (!eof)
+        exception_from_error_queue(crypto_Error);
+    return NULL;
+}
+
+static void
+crypto_X509Iterator_dealloc(crypto_X509IteratorObj *self)
+{
+    if (self->bio != NULL)
+        BIO_free(self->bio);
+    PyBuffer_Release(&self->view);
+
+    PyObject_Del(self);
+}
+
+static char crypto_X509Iterator_doc[] = "\n\
+An iterator over the certificates in a PEM or DER buffer, as returned by\n\
+iter_certificates.\n\
+";
+
+PyTypeObject crypto_X509Iterator_Type = {
+    PyOpenSSL_HEAD_INIT(&PyType_Type, 0)
+    "X509Iterator",
+    sizeof(crypto_X509IteratorObj),
+    0,
+    (destructor)crypto_X509Iterator_dealloc,
+    NULL, /* print */
+    NULL, /* getattr */
+    NULL, /* setattr */
+    NULL, /* compare */
+    NULL, /* repr */
+    NULL, /* as_number */
+    NULL, /* as_sequence */
+    NULL, /* as_mapping */
+    NULL, /* hash */
+    NULL, /* call */
+    NULL, /* str */
+    NULL, /* getattro */
+    NULL, /* setattro */
+    NULL, /* as_buffer */
+    Py_TPFLAGS_DEFAULT,
+    crypto_X509Iterator_doc, /* doc */
+    NULL, /* traverse */
+    NULL, /* clear */
+    NULL, /* tp_richcompare */
+    0, /* tp_weaklistoffset */
+    PyObject_SelfIter, /* tp_iter */
+    (iternextfunc)crypto_X509Iterator_iternext, /* tp_iternext */
+};
+
+/*
+ * Initialize the X509Iterator part of the crypto module
+ *
+ * Arguments: module - The crypto module
+ * Returns:   None
+ */
+int
+init_crypto_x509iterator(PyObject *module)
+{
+    if (PyType_Ready(&crypto_X509Iterator_Type) < 0) {
+        return 0;
+    }
+
+    if (PyModule_AddObject(module, "X509IteratorType", (PyObject *)&crypto_X509Iterator_Type) != 0) {
+        return 0;
+    }
+    return 1;
+}
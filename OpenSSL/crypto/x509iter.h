@@ -0,0 +1,33 @@
+/*
+ * x509iter.h
+ *
+ * See LICENSE for details.
+ *
+ * Export the certificate bundle iterator and the function reading
+ * certificates from a BIO one after another.
+ * See the file RATIONALE for a short explanation of why this module was written.
+ *
+ */
+#ifndef PyOpenSSL_crypto_X509ITER_H_
+#define PyOpenSSL_crypto_X509ITER_H_
+
+#include <Python.h>
+#include <openssl/ssl.h>
+
+extern  PyTypeObject      crypto_X509Iterator_Type;
+
+#define crypto_X509Iterator_Check(v) ((v)->ob_type == &crypto_X509Iterator_Type)
+
+typedef struct {
+    PyObject_HEAD
+    Py_buffer            view;
+    BIO                  *bio;
+    int                  type;
+    int                  busy;
+} crypto_X509IteratorObj;
+
+extern  int       init_crypto_x509iterator   (PyObject *);
+extern  PyObject  *crypto_X509Iterator_New   (int, Py_buffer *);
+extern  X509      *crypto_X509_read_bio      (BIO *, int, int *);
+
+#endif
@@ -14,7 +14,7 @@
 #define crypto_MODULE
 #include "crypto.h"
 
-static PyMethodDef crypto_X509Name_methods[5];
+static PyMethodDef crypto_X509Name_methods[8];
 
 /*
  * Constructor for X509Name, never called by Python code directly
@@ -37,6 +37,8 @@ crypto_X509Name_New(X509_NAME *name, int dealloc)
     self->x509_name = name;
     self->dealloc = dealloc;
     self->parent_cert = NULL;
+    self->canon = NULL;
+    self->canon_der = NULL;
 
     PyObject_GC_Track(self);
     return self;
@@ -46,54 +48,187 @@ crypto_X509Name_New(X509_NAME *name, int dealloc)
 static char crypto_X509Name_doc[] = "\n\
 X509Name(name) -> New X509Name object\n\
 \n\
-Create a new X509Name, copying the given X509Name instance.\n\
+Create a new X509Name, copying the given X509Name instance or made of the\n\
+given components.\n\
 \n\
-@param name: An X509Name object to copy\n\
+@param name: An X509Name object to copy, or a sequence of components as\n\
+             accepted by set_components\n\
 @return: The X509Name object\n\
 ";
 
 static PyObject *
 crypto_X509Name_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
 {
-    crypto_X509NameObj *name;
+    PyObject *name;
+    X509_NAME *x509_name;
 
-    if (!PyArg_ParseTuple(args, "O!:X509Name", &crypto_X509Name_Type, &name)) {
+    if (!PyArg_ParseTuple(args, "O:X509Name", &name)) {
         return NULL;
     }
 
-    return (PyObject *)crypto_X509Name_New(X509_NAME_dup(name->x509_name), 1);
+    if (crypto_X509Name_Check(name)) {
+        x509_name = X509_NAME_dup(((crypto_X509NameObj *)name)->x509_name);
+    } else {
+        x509_name = X509_NAME_new();
+    }
+    if (x509_name == NULL) {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    if (!crypto_X509Name_Check(name) && !crypto_X509Name_fill(x509_name, name)) {
+        X509_NAME_free(x509_name);
+        return NULL;
+    }
+
+    return (PyObject *)crypto_X509Name_New(x509_name, 1);
 }
 
 
 /*
- * Return a name string given a X509_NAME object and a name identifier. Used
- * by the getattr function.
+ * Attribute names already looked up, mapped to their NID, or to NID_undef for
+ * those which aren't name components (the methods, for instance), so that
+ * OBJ_txt2nid only runs once per name.  The common components are added when
+ * the module is initialized; the number of others is bounded.
+ */
+static PyObject *nid_cache = NULL;
+#define NID_CACHE_MAX 1024
+
+static const int common_nids[] = {
+    NID_countryName, NID_stateOrProvinceName, NID_localityName,
+    NID_organizationName, NID_organizationalUnitName, NID_commonName,
+    NID_pkcs9_emailAddress, NID_serialNumber, NID_surname, NID_givenName,
+    NID_title, NID_initials, NID_dnQualifier, NID_domainComponent,
+    NID_userId, NID_streetAddress, NID_postalCode, NID_name,
+    NID_undef
+};
+
+/*
+ * Add a name component to the NID cache
  *
- * Arguments: name - The X509_NAME object
- *            nid  - The name identifier
- * Returns:   The name as a Python string object
+ * Arguments: name - The short or long name of the component
+ *            nid  - Its NID
+ * Returns:   1 on success, 0 with an exception set on error
  */
 static int
-get_name_by_nid(X509_NAME *name, int nid, char **utf8string)
+cache_nid(const char *name, int nid)
 {
-    int entry_idx;
-    X509_NAME_ENTRY *entry;
-    ASN1_STRING *data;
-    int len;
+    PyObject *key, *value;
+    int result;
 
-    if ((entry_idx = X509_NAME_get_index_by_NID(name, nid, -1)) == -1)
+    key = PyText_FromString(name);
+    value = PyLong_FromLong(nid);
+    result = key != NULL && value != NULL &&
+        PyDict_SetItem(nid_cache, key, value) == 0;
+    Py_XDECREF(key);
+    Py_XDECREF(value);
+    return result;
+}
+
+/*
+ * Find the NID of a name component
+ *
+ * Arguments: nameobj - The name or OID of the component
+ * Returns:   The NID, NID_undef if there is no such component, or -1 with an
+ *            exception set on error
+ */
+static int
+name_to_nid(PyObject *nameobj)
+{
+    PyObject *cached, *value;
+    char *name;
+    int nid;
+#ifdef PY3
+    PyObject *bytes;
+#endif
+
+    if ((cached = PyDict_GetItem(nid_cache, nameobj)) != NULL)
+        return (int)PyLong_AsLong(cached);
+
+#ifdef PY3
+    /* Bytes are accepted wherever a component name is, like str */
+    if (PyBytes_Check(nameobj))
     {
-        return 0;
+        bytes = nameobj;
+        Py_INCREF(bytes);
+    }
+    else if ((bytes = PyUnicode_AsASCIIString(nameobj)) == NULL)
+        return -1;
+    name = PyBytes_AsString(bytes);
+#else
+    if ((name = PyBytes_AsString(nameobj)) == NULL)
+        return -1;
+#endif
+
+    if ((nid = OBJ_txt2nid(name)) == NID_undef) {
+        /*
+         * This is a bit weird.  OBJ_txt2nid indicated failure, but it seems
+         * a lower level function, a2d_ASN1_OBJECT, also feels the need to
+         * push something onto the error queue.  If we don't clean that up
+         * now, someone else will bump into it later and be quite confused. 
+         * See lp#314814.
+         */
+        flush_error_queue();
     }
-    entry = X509_NAME_get_entry(name, entry_idx);
-    data = X509_NAME_ENTRY_get_data(entry);
-    if ((len = ASN1_STRING_to_UTF8((unsigned char **)utf8string, data)) < 0)
+#ifdef PY3
+    Py_DECREF(bytes);
+#endif
+
+    /* The cache is only an optimization */
+    if (PyDict_Size(nid_cache) < NID_CACHE_MAX) {
+        if ((value = PyLong_FromLong(nid)) == NULL ||
+            PyDict_SetItem(nid_cache, nameobj, value) < 0)
+            PyErr_Clear();
+        Py_XDECREF(value);
+    }
+    return nid;
+}
+
+/*
+ * Convert the value of a name entry to a unicode object
+ *
+ * Arguments: entry - The name entry
+ * Returns:   A new reference to the value, or NULL on error
+ */
+static PyObject *
+entry_to_text(X509_NAME_ENTRY *entry)
+{
+    unsigned char *utf8string;
+    PyObject *result;
+    int len;
+
+    len = ASN1_STRING_to_UTF8(&utf8string, X509_NAME_ENTRY_get_data(entry));
+    if (len < 0)
     {
         exception_from_error_queue(crypto_Error);
-        return -1;
+        return NULL;
     }
 
-    return len;
+    result = PyUnicode_Decode((char *)utf8string, len, "utf-8", NULL);
+    OPENSSL_free(utf8string);
+    return result;
+}
+
+/*
+ * Return the value of the first name entry with a given name identifier.
+ * Used by the getattr function.
+ *
+ * Arguments: name - The X509_NAME object
+ *            nid  - The name identifier
+ * Returns:   A new reference to the value, None if there is no such entry,
+ *            or NULL on error
+ */
+static PyObject *
+get_name_by_nid(X509_NAME *name, int nid)
+{
+    int entry_idx;
+
+    if ((entry_idx = X509_NAME_get_index_by_NID(name, nid, -1)) == -1)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    return entry_to_text(X509_NAME_get_entry(name, entry_idx));
 }
 
 /*
@@ -137,6 +272,242 @@ set_name_by_nid(X509_NAME *name, int nid, char *utf8string)
 }
 
 
+/*
+ * A component of a name being built, its value encoded as UTF-8
+ */
+typedef struct {
+    int                  nid;
+    int                  set;       /* 0 to start an RDN, -1 to join the last */
+    PyObject            *value;
+} name_component;
+
+static const char wrong_type_message[] =
+    "name components must be (field, value) pairs or sequences of them";
+
+/*
+ * Read one (field, value) pair into a name_component
+ *
+ * Arguments: pair - The pair
+ *            set  - The set argument for X509_NAME_add_entry_by_NID
+ *            out  - Where to store the component
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+static int
+parse_component(PyObject *pair, int set, name_component *out)
+{
+    PyObject *field, *value;
+    int nid;
+
+    if (!PyTuple_Check(pair) && !PyList_Check(pair))
+        goto wrong_type;
+    if (PySequence_Fast_GET_SIZE(pair) != 2)
+        goto wrong_type;
+    field = PySequence_Fast_GET_ITEM(pair, 0);
+    value = PySequence_Fast_GET_ITEM(pair, 1);
+    if (!PyBytes_Check(field) && !PyUnicode_Check(field))
+        goto wrong_type;
+
+    if ((nid = name_to_nid(field)) < 0)
+        return 0;
+    if (nid == NID_undef)
+    {
+        PyErr_SetString(PyExc_ValueError, "Unknown name component");
+        return 0;
+    }
+
+    if (PyUnicode_Check(value))
+    {
+        if ((value = PyUnicode_AsUTF8String(value)) == NULL)
+            return 0;
+    }
+    else if (PyBytes_Check(value))
+    {
+        Py_INCREF(value);
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, "name component values must be strings");
+        return 0;
+    }
+
+    out->nid = nid;
+    out->set = set;
+    out->value = value;
+    return 1;
+
+  wrong_type:
+    PyErr_SetString(PyExc_TypeError, wrong_type_message);
+    return 0;
+}
+
+/*
+ * Check whether an item of a component sequence is a single (field, value)
+ * pair rather than a multi-valued RDN
+ */
+static int
+is_pair(PyObject *item)
+{
+    return (PyTuple_Check(item) || PyList_Check(item)) &&
+        PySequence_Fast_GET_SIZE(item) == 2 &&
+        (PyBytes_Check(PySequence_Fast_GET_ITEM(item, 0)) ||
+         PyUnicode_Check(PySequence_Fast_GET_ITEM(item, 0)));
+}
+
+/*
+ * Free an array of components
+ */
+static void
+free_components(name_component *parsed, Py_ssize_t count)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < count; i++)
+        Py_DECREF(parsed[i].value);
+    PyMem_Free(parsed);
+}
+
+/*
+ * Read a sequence of components, each a (field, value) pair or a sequence of
+ * pairs making up a multi-valued RDN
+ *
+ * Arguments: components - The sequence
+ *            count      - Where to store the number of components read
+ * Returns:   An array of components to be freed with free_components, or NULL
+ *            with an exception set on error
+ */
+static name_component *
+parse_components(PyObject *components, Py_ssize_t *count)
+{
+    PyObject *seq, *item;
+    name_component *parsed;
+    Py_ssize_t i, j, n, rdn_size, size, used = 0;
+
+    if ((seq = PySequence_Fast(components, "components must be a sequence")) == NULL)
+        return NULL;
+
+    /* The multi-valued RDNs make the array longer than the sequence */
+    n = size = PySequence_Fast_GET_SIZE(seq);
+    for (i = 0; i < n; i++)
+    {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!is_pair(item) && (PyTuple_Check(item) || PyList_Check(item)))
+            size += PySequence_Fast_GET_SIZE(item) - 1;
+    }
+
+    if ((parsed = PyMem_New(name_component, size > 0 ? size : 1)) == NULL)
+    {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        if (is_pair(item))
+        {
+            if (!parse_component(item, 0, &parsed[used]))
+                goto error;
+            used++;
+            continue;
+        }
+
+        if (!PyTuple_Check(item) && !PyList_Check(item))
+        {
+            PyErr_SetString(PyExc_TypeError, wrong_type_message);
+            goto error;
+        }
+        if ((rdn_size = PySequence_Fast_GET_SIZE(item)) == 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "an RDN must not be empty");
+            goto error;
+        }
+        for (j = 0; j < rdn_size; j++)
+        {
+            if (!parse_component(PySequence_Fast_GET_ITEM(item, j),
+                                 j == 0 ? 0 : -1, &parsed[used]))
+                goto error;
+            used++;
+        }
+    }
+
+    Py_DECREF(seq);
+    *count = used;
+    return parsed;
+
+  error:
+    free_components(parsed, used);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+
+/*
+ * Replace all the entries of an X509_NAME in place.  The new entries are
+ * added after the old ones, which are only removed once they have all been
+ * added, so the name is left as it was if something goes wrong.
+ *
+ * Arguments: name       - The X509_NAME object
+ *            components - A sequence of (field, value) pairs, or sequences of
+ *                         them for multi-valued RDNs
+ * Returns:   1 on success, 0 with an exception set on error
+ */
+int
+crypto_X509Name_fill(X509_NAME *name, PyObject *components)
+{
+    name_component *parsed;
+    Py_ssize_t i, count;
+    int old_count;
+
+    if ((parsed = parse_components(components, &count)) == NULL)
+        return 0;
+
+    old_count = X509_NAME_entry_count(name);
+    for (i = 0; i < count; i++)
+    {
+        if (!X509_NAME_add_entry_by_NID(
+                name, parsed[i].nid, MBSTRING_UTF8,
+                (unsigned char *)PyBytes_AS_STRING(parsed[i].value),
+                (int)PyBytes_GET_SIZE(parsed[i].value), -1, parsed[i].set))
+        {
+            exception_from_error_queue(crypto_Error);
+            while (X509_NAME_entry_count(name) > old_count)
+                X509_NAME_ENTRY_free(X509_NAME_delete_entry(
+                    name, X509_NAME_entry_count(name) - 1));
+            free_components(parsed, count);
+            return 0;
+        }
+    }
+    free_components(parsed, count);
+
+    while (old_count-- > 0)
+        X509_NAME_ENTRY_free(X509_NAME_delete_entry(name, 0));
+    return 1;
+}
+
+/*
+ * Get ready to modify an X509Name object, telling the certificate or request
+ * it belongs to, if any, that it is changing
+ *
+ * Arguments: self - The X509Name object
+ * Returns:   1 if it can be modified, 0 with an exception set otherwise
+ */
+static int
+crypto_X509Name_modify(crypto_X509NameObj *self)
+{
+    if (self->parent_cert == NULL)
+        return 1;
+
+    if (crypto_X509_Check(self->parent_cert))
+        return crypto_X509_modify((crypto_X509Obj *)self->parent_cert);
+
+    if (crypto_X509Req_Check(self->parent_cert))
+        crypto_DERDigest_invalidate(
+            &((crypto_X509ReqObj *)self->parent_cert)->der_digest);
+    return 1;
+}
+
+
 /*
  * Find attribute. An X509Name object has the following attributes:
  * countryName (alias C), stateOrProvince (alias ST), locality (alias L),
@@ -151,42 +522,56 @@ set_name_by_nid(X509_NAME *name, int nid, char *utf8string)
 static PyObject *
 crypto_X509Name_getattro(crypto_X509NameObj *self, PyObject *nameobj)
 {
-    int nid, len;
-    char *utf8string;
-    char *name;
-#ifdef PY3
-    name = PyBytes_AsString(PyUnicode_AsASCIIString(nameobj));
-#else
-    name = PyBytes_AsString(nameobj);
-#endif
+    int nid;
 
-    if ((nid = OBJ_txt2nid(name)) == NID_undef) {
-        /*
-         * This is a bit weird.  OBJ_txt2nid indicated failure, but it seems
-         * a lower level function, a2d_ASN1_OBJECT, also feels the need to
-         * push something onto the error queue.  If we don't clean that up
-         * now, someone else will bump into it later and be quite confused. 
-         * See lp#314814.
-         */
-        flush_error_queue();
+    if ((nid = name_to_nid(nameobj)) < 0)
+        return NULL;
+    if (nid == NID_undef)
         return PyObject_GenericGetAttr((PyObject*)self, nameobj);
+
+    return get_name_by_nid(self->x509_name, nid);
+}
+
+/*
+ * Look up a name component by its name, like getattr but raising KeyError
+ * if the name doesn't have it
+ *
+ * Arguments: self - The X509Name object
+ *            key  - The name of the component
+ * Returns:   A Python object for the component, or NULL if something went
+ *            wrong
+ */
+static PyObject *
+crypto_X509Name_subscript(crypto_X509NameObj *self, PyObject *key)
+{
+    int nid, entry_idx = -1;
+
+    if (!PyBytes_Check(key) && !PyUnicode_Check(key))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "X509Name keys must be component names");
+        return NULL;
     }
 
-    len = get_name_by_nid(self->x509_name, nid, &utf8string);
-    if (len < 0)
+    if ((nid = name_to_nid(key)) < 0)
         return NULL;
-    else if (len == 0)
+    if (nid != NID_undef)
+        entry_idx = X509_NAME_get_index_by_NID(self->x509_name, nid, -1);
+    if (entry_idx < 0)
     {
-        Py_INCREF(Py_None);
-        return Py_None;
-    }
-    else {
-	    PyObject* result = PyUnicode_Decode(utf8string, len, "utf-8", NULL);
-	    OPENSSL_free(utf8string);
-	    return result;
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
     }
+
+    return entry_to_text(X509_NAME_get_entry(self->x509_name, entry_idx));
 }
 
+static PyMappingMethods crypto_X509Name_as_mapping = {
+    NULL, /* mp_length */
+    (binaryfunc)crypto_X509Name_subscript, /* mp_subscript */
+    NULL, /* mp_ass_subscript */
+};
+
 /*
  * Set attribute
  *
@@ -211,11 +596,183 @@ crypto_X509Name_setattr(crypto_X509NameObj *self, char *name, PyObject *value)
     if (!PyArg_Parse(value, "es:setattr", "utf-8", &buffer))
         return -1;
 
+    if (!crypto_X509Name_modify(self))
+    {
+        PyMem_Free(buffer);
+        return -1;
+    }
+
     result = set_name_by_nid(self->x509_name, nid, buffer);
     PyMem_Free(buffer);
     return result;
 }
 
+/* The string types whose values X509_NAME_cmp compares loosely */
+#define CANONICAL_STRING_TYPES \
+    (B_ASN1_UTF8STRING | B_ASN1_BMPSTRING | B_ASN1_UNIVERSALSTRING | \
+     B_ASN1_PRINTABLESTRING | B_ASN1_T61STRING | B_ASN1_IA5STRING | \
+     B_ASN1_VISIBLESTRING)
+
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/*
+ * Put a UTF-8 string into the canonical form OpenSSL compares names in:
+ * leading and trailing white space dropped, inner white space collapsed to
+ * one space and ASCII letters lowered
+ *
+ * Arguments: str - The string, changed in place
+ *            len - Its length
+ * Returns:   The length of the canonical string
+ */
+static int
+canonicalize_string(unsigned char *str, int len)
+{
+    unsigned char *from = str, *to = str;
+
+    while (len > 0 && IS_SPACE(*from))
+    {
+        from++;
+        len--;
+    }
+    while (len > 0 && IS_SPACE(from[len - 1]))
+        len--;
+
+    while (len > 0)
+    {
+        if (*from & 0x80)
+        {
+            *to++ = *from++;
+            len--;
+        }
+        else if (IS_SPACE(*from))
+        {
+            *to++ = ' ';
+            /* The last character isn't a space, so this stays in bounds */
+            do
+            {
+                from++;
+                len--;
+            } while (IS_SPACE(*from));
+        }
+        else
+        {
+            *to++ = (*from >= 'A' && *from <= 'Z') ? *from - 'A' + 'a' : *from;
+            from++;
+            len--;
+        }
+    }
+    return (int)(to - str);
+}
+
+/*
+ * Compute the canonical encoding X509_NAME_cmp compares names by: the DER
+ * encoding of the RDNs of the name, without the outer SEQUENCE, with their
+ * string values in canonical form
+ *
+ * Arguments: name - The X509_NAME object
+ * Returns:   A new reference to the encoding as a byte string, or NULL with
+ *            an exception set
+ */
+static PyObject *
+canonical_encoding(X509_NAME *name)
+{
+    X509_NAME *canon;
+    X509_NAME_ENTRY *entry;
+    const ASN1_STRING *value;
+    unsigned char *utf8, *der = NULL;
+    const unsigned char *p;
+    PyObject *result = NULL;
+    long length;
+    int i, n, len, set, last_set = -1, tag, xclass, ok;
+
+    if ((canon = X509_NAME_new()) == NULL)
+        goto error;
+
+    n = X509_NAME_entry_count(name);
+    for (i = 0; i < n; i++)
+    {
+        entry = X509_NAME_get_entry(name, i);
+        value = X509_NAME_ENTRY_get_data(entry);
+        set = X509_NAME_ENTRY_set(entry);
+        if (ASN1_tag2bit(ASN1_STRING_type(value)) & CANONICAL_STRING_TYPES)
+        {
+            if ((len = ASN1_STRING_to_UTF8(&utf8, value)) < 0)
+                goto error;
+            len = canonicalize_string(utf8, len);
+            ok = X509_NAME_add_entry_by_OBJ(
+                canon, X509_NAME_ENTRY_get_object(entry), V_ASN1_UTF8STRING,
+                utf8, len, -1, set == last_set ? -1 : 0);
+            OPENSSL_free(utf8);
+        }
+        else
+        {
+            ok = X509_NAME_add_entry_by_OBJ(
+                canon, X509_NAME_ENTRY_get_object(entry),
+                ASN1_STRING_type(value), ASN1_STRING_get0_data(value),
+                ASN1_STRING_length(value), -1, set == last_set ? -1 : 0);
+        }
+        if (!ok)
+            goto error;
+        last_set = set;
+    }
+
+    if ((len = i2d_X509_NAME(canon, &der)) < 0)
+        goto error;
+    p = der;
+    if (ASN1_get_object(&p, &length, &tag, &xclass, len) & 0x80)
+        goto error;
+    result = PyBytes_FromStringAndSize((const char *)p, length);
+    OPENSSL_free(der);
+    X509_NAME_free(canon);
+    return result;
+
+  error:
+    exception_from_error_queue(crypto_Error);
+    OPENSSL_free(der);
+    X509_NAME_free(canon);
+    return NULL;
+}
+
+/*
+ * Get the canonical encoding of a name, computing it again only if the name
+ * has changed since last time.  Several X509Name objects can share the same
+ * X509_NAME, so the cache is checked against the DER encoding, which OpenSSL
+ * itself keeps up to date, rather than invalidated by this object's setters.
+ *
+ * Arguments: self - The X509Name object
+ * Returns:   A borrowed reference to the encoding, or NULL with an exception
+ *            set
+ */
+static PyObject *
+cached_canonical_encoding(crypto_X509NameObj *self)
+{
+    const unsigned char *der;
+    size_t der_len;
+
+    if (!X509_NAME_get0_der(self->x509_name, &der, &der_len))
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    if (self->canon_der != NULL &&
+        (size_t)PyBytes_GET_SIZE(self->canon_der) == der_len &&
+        memcmp(PyBytes_AS_STRING(self->canon_der), der, der_len) == 0)
+        return self->canon;
+
+    Py_CLEAR(self->canon_der);
+    Py_CLEAR(self->canon);
+    if ((self->canon = canonical_encoding(self->x509_name)) == NULL)
+        return NULL;
+    if ((self->canon_der = PyBytes_FromStringAndSize((const char *)der,
+                                                     der_len)) == NULL)
+    {
+        Py_CLEAR(self->canon);
+        return NULL;
+    }
+    return self->canon;
+}
+
 /*
  * Compare two X509Name structures.
  *
@@ -225,6 +782,8 @@ crypto_X509Name_setattr(crypto_X509NameObj *self, char *name, PyObject *value)
  */
 static PyObject *
 crypto_X509Name_richcompare(PyObject *n, PyObject *m, int op) {
+    PyObject *n_canon, *m_canon;
+    Py_ssize_t n_len, m_len;
     int result;
 
     if (!crypto_X509Name_Check(n) || !crypto_X509Name_Check(m)) {
@@ -232,9 +791,19 @@ crypto_X509Name_richcompare(PyObject *n, PyObject *m, int op) {
         return Py_NotImplemented;
     }
 
-    result = X509_NAME_cmp(
-        ((crypto_X509NameObj*)n)->x509_name,
-        ((crypto_X509NameObj*)m)->x509_name);
+    /* The same order as X509_NAME_cmp: shorter encodings first */
+    if ((n_canon = cached_canonical_encoding((crypto_X509NameObj *)n)) == NULL ||
+        (m_canon = cached_canonical_encoding((crypto_X509NameObj *)m)) == NULL) {
+        return NULL;
+    }
+    n_len = PyBytes_GET_SIZE(n_canon);
+    m_len = PyBytes_GET_SIZE(m_canon);
+    if (n_len != m_len) {
+        result = n_len < m_len ? -1 : 1;
+    } else {
+        result = memcmp(PyBytes_AS_STRING(n_canon), PyBytes_AS_STRING(m_canon),
+                        n_len);
+    }
 
     switch (op) {
     case Py_EQ:
@@ -301,6 +870,22 @@ crypto_X509Name_repr(crypto_X509NameObj *self)
     }
 }
 
+/*
+ * Hash an X509Name so that equal names hash the same
+ *
+ * Arguments: self - The X509Name object
+ * Returns:   The hash value, or -1 with an exception set
+ */
+static long
+crypto_X509Name_tp_hash(crypto_X509NameObj *self)
+{
+    PyObject *canon;
+
+    if ((canon = cached_canonical_encoding(self)) == NULL)
+        return -1;
+    return PyObject_Hash(canon);
+}
+
 static char crypto_X509Name_hash_doc[] = "\n\
 Return the hash value of this name\n\
 \n\
@@ -355,54 +940,192 @@ crypto_X509Name_der(crypto_X509NameObj *self, PyObject *args)
 }
 
 
-static char crypto_X509Name_get_components_doc[] = "\n\
-Returns the split-up components of this name.\n\
+/*
+ * List the components of a name
+ *
+ * Arguments: name - The name
+ * Returns:   A new reference to a list of (name, value) tuples, or NULL on
+ *            error
+ */
+PyObject *
+crypto_X509Name_components(X509_NAME *name)
+{
+    X509_NAME_ENTRY *ent;
+    ASN1_STRING *fval;
+    PyObject *list, *tuple;
+    int n, i;
+
+    n = X509_NAME_entry_count(name);
+    if ((list = PyList_New(n)) == NULL)
+        return NULL;
+    for (i = 0; i < n; i++)
+    {
+        ent = X509_NAME_get_entry(name, i);
+        fval = X509_NAME_ENTRY_get_data(ent);
+
+        tuple = Py_BuildValue(
+            "(" BYTESTRING_FMT BYTESTRING_FMT "#)",
+            OBJ_nid2sn(OBJ_obj2nid(X509_NAME_ENTRY_get_object(ent))),
+            ASN1_STRING_get0_data(fval), ASN1_STRING_length(fval));
+        if (tuple == NULL)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, tuple);
+    }
+
+    return list;
+}
+
+static char crypto_X509Name_get_all_doc[] = "\n\
+Return the values of all the components of this name with a given name,\n\
+for components such as OU which may be repeated.\n\
 \n\
-@return: List of tuples (name, value).\n\
+@param name: The name of the component, such as \"OU\" or\n\
+             \"organizationalUnitName\"\n\
+@return: A list of unicode strings, empty if there is no such component\n\
 ";
 
 static PyObject *
-crypto_X509Name_get_components(crypto_X509NameObj *self, PyObject *args)
+crypto_X509Name_get_all(crypto_X509NameObj *self, PyObject *args)
 {
-    int n, i;
-    X509_NAME *name = self->x509_name;
-    PyObject *list;
+    PyObject *nameobj, *list, *value;
+    int nid, entry_idx = -1;
 
-    if (!PyArg_ParseTuple(args, ":get_components"))
-	return NULL;
+    if (!PyArg_ParseTuple(args, "O:get_all", &nameobj))
+        return NULL;
 
-    n = X509_NAME_entry_count(name);
-    list = PyList_New(n);
-    for (i = 0; i < n; i++)
+    if (!PyBytes_Check(nameobj) && !PyUnicode_Check(nameobj))
     {
-	X509_NAME_ENTRY *ent;
-	ASN1_OBJECT *fname;
-	ASN1_STRING *fval;
-	int nid;
-	int l;
-	unsigned char *str;
-	PyObject *tuple;
+        PyErr_SetString(PyExc_TypeError, "expected a component name");
+        return NULL;
+    }
+    if ((nid = name_to_nid(nameobj)) < 0)
+        return NULL;
+    if (nid == NID_undef)
+    {
+        PyErr_SetString(PyExc_ValueError, "Unknown name component");
+        return NULL;
+    }
 
-	ent = X509_NAME_get_entry(name, i);
+    if ((list = PyList_New(0)) == NULL)
+        return NULL;
+    while ((entry_idx = X509_NAME_get_index_by_NID(
+                self->x509_name, nid, entry_idx)) >= 0)
+    {
+        value = entry_to_text(X509_NAME_get_entry(self->x509_name, entry_idx));
+        if (value == NULL || PyList_Append(list, value) < 0)
+        {
+            Py_XDECREF(value);
+            Py_DECREF(list);
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
 
-	fname = X509_NAME_ENTRY_get_object(ent);
-	fval = X509_NAME_ENTRY_get_data(ent);
+    return list;
+}
 
-	l = ASN1_STRING_length(fval);
-	str = (unsigned char *)ASN1_STRING_get0_data(fval);
+static char crypto_X509Name_as_dict_doc[] = "\n\
+Return the components of this name as a dict.\n\
+\n\
+@return: A dict mapping the short name of each component (or its OID if it\n\
+         has none) to its value as a unicode string.  A repeated component\n\
+         maps to its first value, like attribute access gives.\n\
+";
 
-	nid = OBJ_obj2nid(fname);
+static PyObject *
+crypto_X509Name_as_dict(crypto_X509NameObj *self, PyObject *args)
+{
+    X509_NAME_ENTRY *entry;
+    ASN1_OBJECT *object;
+    PyObject *dict, *key, *value;
+    char buf[80];
+    int i, n, nid;
 
-	/* printf("fname is %s len=%d str=%s\n", OBJ_nid2sn(nid), l, str); */
+    if (!PyArg_ParseTuple(args, ":as_dict"))
+        return NULL;
 
-	tuple = PyTuple_New(2);
-	PyTuple_SetItem(tuple, 0, PyBytes_FromString(OBJ_nid2sn(nid)));
-	PyTuple_SetItem(tuple, 1, PyBytes_FromStringAndSize((char *)str, l));
+    if ((dict = PyDict_New()) == NULL)
+        return NULL;
 
-	PyList_SetItem(list, i, tuple);
+    n = X509_NAME_entry_count(self->x509_name);
+    for (i = 0; i < n; i++)
+    {
+        entry = X509_NAME_get_entry(self->x509_name, i);
+        object = X509_NAME_ENTRY_get_object(entry);
+        if ((nid = OBJ_obj2nid(object)) != NID_undef)
+            key = PyText_FromString(OBJ_nid2sn(nid));
+        else
+        {
+            OBJ_obj2txt(buf, sizeof(buf), object, 1);
+            key = PyText_FromString(buf);
+        }
+        if (key == NULL)
+            goto error;
+        if (PyDict_GetItem(dict, key) != NULL)
+        {
+            Py_DECREF(key);
+            continue;
+        }
+        if ((value = entry_to_text(entry)) == NULL ||
+            PyDict_SetItem(dict, key, value) < 0)
+        {
+            Py_DECREF(key);
+            Py_XDECREF(value);
+            goto error;
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
     }
 
-    return list;
+    return dict;
+
+  error:
+    Py_DECREF(dict);
+    return NULL;
+}
+
+static char crypto_X509Name_set_components_doc[] = "\n\
+Replace all the components of this name.\n\
+\n\
+@param components: A sequence whose items are either a (field, value) pair\n\
+                   or a sequence of such pairs making up a multi-valued RDN.\n\
+                   Fields are short or long component names, values are\n\
+                   byte or unicode strings.  The order is kept.\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_X509Name_set_components(crypto_X509NameObj *self, PyObject *args)
+{
+    PyObject *components;
+
+    if (!PyArg_ParseTuple(args, "O:set_components", &components))
+        return NULL;
+
+    if (!crypto_X509Name_modify(self) ||
+        !crypto_X509Name_fill(self->x509_name, components))
+        return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static char crypto_X509Name_get_components_doc[] = "\n\
+Returns the split-up components of this name.\n\
+\n\
+@return: List of tuples (name, value).\n\
+";
+
+static PyObject *
+crypto_X509Name_get_components(crypto_X509NameObj *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_components"))
+	return NULL;
+
+    return crypto_X509Name_components(self->x509_name);
 }
 
 
@@ -417,18 +1140,19 @@ Returns:   String.\n\
 static PyObject *
 crypto_X509Name_get_oneline(crypto_X509NameObj *self, PyObject *args)
 {
-    char tmpbuf[512] = "";
+    char *oneline;
+    PyObject *result;
 
-    if (X509_NAME_oneline(self->x509_name, tmpbuf, 512) == NULL)
+    /* Let OpenSSL allocate the buffer, so that long names aren't cut short */
+    if ((oneline = X509_NAME_oneline(self->x509_name, NULL, 0)) == NULL)
     {
         exception_from_error_queue(crypto_Error);
         return NULL;
     }
-    else
-    {
-        return PyString_FromString(tmpbuf);
-    }
 
+    result = PyBytes_FromString(oneline);
+    OPENSSL_free(oneline);
+    return result;
 }
 
 
@@ -480,6 +1204,8 @@ crypto_X509Name_dealloc(crypto_X509NameObj *self)
         X509_NAME_free(self->x509_name);
 
     crypto_X509Name_clear(self);
+    Py_XDECREF(self->canon);
+    Py_XDECREF(self->canon_der);
 
     PyObject_GC_Del(self);
 }
@@ -497,6 +1223,9 @@ static PyMethodDef crypto_X509Name_methods[] =
     ADD_METHOD(hash),
     ADD_METHOD(der),
     ADD_METHOD(get_components),
+    ADD_METHOD(set_components),
+    ADD_METHOD(get_all),
+    ADD_METHOD(as_dict),
     ADD_METHOD(get_oneline),
     { NULL, NULL }
 };
@@ -515,8 +1244,8 @@ PyTypeObject crypto_X509Name_Type = {
     (reprfunc)crypto_X509Name_repr,
     NULL, /* as_number */
     NULL, /* as_sequence */
-    NULL, /* as_mapping */
-    NULL, /* hash */
+    &crypto_X509Name_as_mapping, /* as_mapping */
+    (hashfunc)crypto_X509Name_tp_hash, /* hash */
     NULL, /* call */
     NULL, /* str */
     (getattrofunc)crypto_X509Name_getattro, /* getattro */
@@ -552,6 +1281,19 @@ PyTypeObject crypto_X509Name_Type = {
 int
 init_crypto_x509name(PyObject *module)
 {
+    const int *common;
+
+    if ((nid_cache = PyDict_New()) == NULL) {
+        return 0;
+    }
+
+    for (common = common_nids; *common != NID_undef; common++) {
+        if (!cache_nid(OBJ_nid2sn(*common), *common) ||
+            !cache_nid(OBJ_nid2ln(*common), *common)) {
+            return 0;
+        }
+    }
+
     if (PyType_Ready(&crypto_X509Name_Type) < 0) {
         return 0;
     }
@@ -20,6 +20,9 @@ extern  int     init_crypto_x509name       (PyObject *);
 
 extern  PyTypeObject      crypto_X509Name_Type;
 
+extern  PyObject  *crypto_X509Name_components (X509_NAME *);
+extern  int       crypto_X509Name_fill       (X509_NAME *, PyObject *);
+
 #define crypto_X509Name_Check(v) ((v)->ob_type == &crypto_X509Name_Type)
 
 typedef struct {
@@ -27,6 +30,8 @@ typedef struct {
     X509_NAME           *x509_name;
     int                  dealloc;
     PyObject            *parent_cert;
+    PyObject            *canon;         /* Canonical encoding, or NULL */
+    PyObject            *canon_der;     /* The DER it was computed from */
 } crypto_X509NameObj;
 
 
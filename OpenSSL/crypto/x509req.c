@@ -85,6 +85,8 @@ crypto_X509Req_set_pubkey(crypto_X509ReqObj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O!:set_pubkey", &crypto_PKey_Type, &pkey))
         return NULL;
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if (!X509_REQ_set_pubkey(self->x509_req, pkey->pkey))
     {
         exception_from_error_queue(crypto_Error);
@@ -99,7 +101,8 @@ static char crypto_X509Req_sign_doc[] = "\n\
 Sign the certificate request using the supplied key and digest\n\
 \n\
 @param pkey: The key to sign with\n\
-@param digest: The message digest to use\n\
+@param digest: The message digest to use, or None for keys which don't take\n\
+               one, like Ed25519 keys\n\
 @return: None\n\
 ";
 
@@ -107,13 +110,14 @@ static PyObject *
 crypto_X509Req_sign(crypto_X509ReqObj *self, PyObject *args)
 {
     crypto_PKeyObj *pkey;
-    char *digest_name;
     const EVP_MD *digest;
 
-    if (!PyArg_ParseTuple(args, "O!s:sign", &crypto_PKey_Type, &pkey,
-			  &digest_name))
+    if (!PyArg_ParseTuple(args, "O!O&:sign", &crypto_PKey_Type, &pkey,
+			  crypto_sign_digest_converter, &digest))
         return NULL;
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if (pkey->only_public) {
 	PyErr_SetString(PyExc_ValueError, "Key has only public part");
 	return NULL;
@@ -124,12 +128,6 @@ crypto_X509Req_sign(crypto_X509ReqObj *self, PyObject *args)
 	return NULL;
     }
 
-    if ((digest = EVP_get_digestbyname(digest_name)) == NULL)
-    {
-        PyErr_SetString(PyExc_ValueError, "No such digest method");
-        return NULL;
-    }
-
     if (!X509_REQ_sign(self->x509_req, pkey->pkey, digest))
     {
         exception_from_error_queue(crypto_Error);
@@ -188,6 +186,8 @@ crypto_X509Req_add_extensions(crypto_X509ReqObj *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O:add_extensions", &extensions))
         return NULL;
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if (!PySequence_Check(extensions))
     {
         PyErr_SetString(PyExc_TypeError, "Expected a sequence");
@@ -247,6 +247,8 @@ crypto_X509Req_set_version(crypto_X509ReqObj *self, PyObject *args)
         return NULL;
     }
 
+    crypto_DERDigest_invalidate(&self->der_digest);
+
     if (!X509_REQ_set_version(self->x509_req, version)) {
         return NULL;
     }
@@ -276,6 +278,56 @@ crypto_X509Req_get_version(crypto_X509ReqObj *self, PyObject *args)
     return PyLong_FromLong(version);
 }
 
+static char crypto_X509Req_to_dict_doc[] = "\n\
+Decode the whole certificate request at once.\n\
+\n\
+@return: A dict with the version, signature_algorithm, subject (as a list of\n\
+         (name, value) tuples, like X509Name.get_components), public_key (a\n\
+         dict with the type and bits of the key) and extensions (a list of\n\
+         dicts with the name, critical flag, DER data and text value of each\n\
+         extension)\n\
+";
+
+static PyObject *
+crypto_X509Req_to_dict(crypto_X509ReqObj *self, PyObject *args)
+{
+    X509_REQ *req = self->x509_req;
+    STACK_OF(X509_EXTENSION) *exts;
+    EVP_PKEY *pkey;
+    PyObject *dict;
+    int failed;
+
+    if (!PyArg_ParseTuple(args, ":to_dict"))
+        return NULL;
+
+    if ((dict = PyDict_New()) == NULL)
+        return NULL;
+
+    if ((pkey = X509_REQ_get0_pubkey(req)) == NULL)
+        flush_error_queue();
+    if ((exts = X509_REQ_get_extensions(req)) == NULL)
+        flush_error_queue();
+
+    failed = dict_set_new(dict, "version",
+                          PyLong_FromLong(X509_REQ_get_version(req))) < 0 ||
+        dict_set_new(dict, "signature_algorithm", crypto_signature_algorithm(
+                         X509_REQ_get_signature_nid(req))) < 0 ||
+        dict_set_new(dict, "subject", crypto_X509Name_components(
+                         X509_REQ_get_subject_name(req))) < 0 ||
+        dict_set_new(dict, "public_key", crypto_PKey_describe(pkey)) < 0 ||
+        dict_set_new(dict, "extensions",
+                     crypto_X509Extensions_to_list(exts)) < 0;
+    sk_X509_EXTENSION_pop_free(exts, X509_EXTENSION_free);
+
+    if (failed)
+    {
+        Py_DECREF(dict);
+        return NULL;
+    }
+
+    return dict;
+}
+
 /*
  * ADD_METHOD(name) expands to a correct PyMethodDef declaration
  *   {  'name', (PyCFunction)crypto_X509Req_name, METH_VARARGS }
@@ -293,6 +345,7 @@ static PyMethodDef crypto_X509Req_methods[] =
     ADD_METHOD(add_extensions),
     ADD_METHOD(set_version),
     ADD_METHOD(get_version),
+    ADD_METHOD(to_dict),
     { NULL, NULL }
 };
 #undef ADD_METHOD
@@ -318,10 +371,39 @@ crypto_X509Req_New(X509_REQ *req, int dealloc)
 
     self->x509_req = req;
     self->dealloc = dealloc;
+    crypto_DERDigest_invalidate(&self->der_digest);
 
     return self;
 }
 
+static long
+crypto_X509Req_hash(crypto_X509ReqObj *self)
+{
+    return crypto_DERDigest_hash(&self->der_digest, ASN1_ITEM_rptr(X509_REQ),
+                                 self->x509_req, (PyObject *)self);
+}
+
+static PyObject *
+crypto_X509Req_richcompare(PyObject *a, PyObject *b, int op)
+{
+    crypto_X509ReqObj *x, *y;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) ||
+        !crypto_X509Req_Check(a) || !crypto_X509Req_Check(b))
+    {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+
+    x = (crypto_X509ReqObj *)a;
+    y = (crypto_X509ReqObj *)b;
+    equal = crypto_DERDigest_equal(&x->der_digest, x->x509_req,
+                                   &y->der_digest, y->x509_req,
+                                   ASN1_ITEM_rptr(X509_REQ));
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
 
 static char crypto_X509Req_doc[] = "\n\
 X509Req() -> X509Req instance\n\
@@ -372,7 +454,7 @@ PyTypeObject crypto_X509Req_Type = {
     NULL, /* as_number */
     NULL, /* as_sequence */
     NULL, /* as_mapping */
-    NULL, /* hash */
+    (hashfunc)crypto_X509Req_hash, /* hash */
     NULL, /* call */
     NULL, /* str */
     NULL, /* getattro */
@@ -382,7 +464,7 @@ PyTypeObject crypto_X509Req_Type = {
     crypto_X509Req_doc, /* doc */
     NULL, /* traverse */
     NULL, /* clear */
-    NULL, /* tp_richcompare */
+    (richcmpfunc)crypto_X509Req_richcompare, /* tp_richcompare */
     0, /* tp_weaklistoffset */
     NULL, /* tp_iter */
     NULL, /* tp_iternext */
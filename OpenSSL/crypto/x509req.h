@@ -24,6 +24,7 @@ typedef struct {
     PyObject_HEAD
     X509_REQ            *x509_req;
     int                  dealloc;
+    crypto_DERDigest     der_digest;
 } crypto_X509ReqObj;
 
 
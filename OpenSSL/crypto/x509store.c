@@ -36,6 +36,295 @@ crypto_X509Store_add_cert(crypto_X509StoreObj *self, PyObject *args)
     return Py_None;
 }
 
+static char crypto_X509Store_add_crl_doc[] = "\n\
+Add a certificate revocation list\n\
+\n\
+@param crl: The CRL to add\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_X509Store_add_crl(crypto_X509StoreObj *self, PyObject *args)
+{
+    crypto_CRLObj *crl;
+
+    if (!PyArg_ParseTuple(args, "O!:add_crl", &crypto_CRL_Type, &crl))
+        return NULL;
+
+    if (!X509_STORE_add_crl(self->x509_store, crl->crl))
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static char crypto_X509Store_load_locations_doc[] = "\n\
+Load trusted certificates and CRLs from a file and/or a directory.  The\n\
+files are parsed once, when this method is called.\n\
+\n\
+@param cafile: None, or the name of a file of PEM encoded certificates and\n\
+               CRLs\n\
+@param capath: None, or the name of a hashed directory of certificates and\n\
+               CRLs (see c_rehash)\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_X509Store_load_locations(crypto_X509StoreObj *self, PyObject *args)
+{
+    char *cafile, *capath = NULL;
+    int ret;
+
+    if (!PyArg_ParseTuple(args, "z|z:load_locations", &cafile, &capath))
+        return NULL;
+
+    if (cafile == NULL && capath == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "cafile and capath cannot both be None");
+        return NULL;
+    }
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    ret = X509_STORE_load_locations(self->x509_store, cafile, capath);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if (!ret)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static char crypto_X509Store_set_flags_doc[] = "\n\
+Set verification flags, a bitwise or of the X509_V_FLAG_* constants\n\
+\n\
+@param flags: The flags to set\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_X509Store_set_flags(crypto_X509StoreObj *self, PyObject *args)
+{
+    unsigned long flags;
+
+    if (!PyArg_ParseTuple(args, "k:set_flags", &flags))
+        return NULL;
+
+    if (!X509_STORE_set_flags(self->x509_store, flags))
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static char crypto_X509Store_set_depth_doc[] = "\n\
+Set the maximum depth of the certificate chains built by verify\n\
+\n\
+@param depth: The maximum depth\n\
+@return: None\n\
+";
+
+static PyObject *
+crypto_X509Store_set_depth(crypto_X509StoreObj *self, PyObject *args)
+{
+    int depth;
+
+    if (!PyArg_ParseTuple(args, "i:set_depth", &depth))
+        return NULL;
+
+    if (!X509_STORE_set_depth(self->x509_store, depth))
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/*
+ * Verify a certificate against a store.  Does not touch any Python object, so
+ * it may be called with the GIL released.
+ *
+ * Arguments: store     - The trust store
+ *            cert      - The certificate to verify
+ *            untrusted - Additional untrusted certificates to build the chain
+ *                        from, or NULL
+ *            chain     - If not NULL, receives the chain that was built (the
+ *                        caller owns it and the certificates in it), or NULL
+ * Returns:   One of the X509_V_* codes, or -1 if OpenSSL ran out of memory
+ */
+int
+crypto_X509Store_verify_cert(X509_STORE *store, X509 *cert,
+                             STACK_OF(X509) *untrusted, STACK_OF(X509) **chain)
+{
+    X509_STORE_CTX *context;
+    int result;
+
+    if (chain != NULL)
+        *chain = NULL;
+
+    if ((context = X509_STORE_CTX_new()) == NULL)
+        return -1;
+
+    if (!X509_STORE_CTX_init(context, store, cert, untrusted))
+    {
+        X509_STORE_CTX_free(context);
+        return -1;
+    }
+
+    X509_verify_cert(context);
+    result = X509_STORE_CTX_get_error(context);
+    if (chain != NULL)
+        *chain = X509_STORE_CTX_get1_chain(context);
+
+    X509_STORE_CTX_free(context);
+
+    /* Verification failures are reported through the result */
+    ERR_clear_error();
+    return result;
+}
+
+/*
+ * Convert a sequence of X509 objects to a STACK_OF(X509).  Every certificate
+ * gets an extra reference, so the stack stays valid with the GIL released.
+ *
+ * Arguments: certs - A sequence of X509 objects
+ * Returns:   The stack, to be freed with sk_X509_pop_free(.., X509_free), or
+ *            NULL with an exception set
+ */
+STACK_OF(X509) *
+crypto_X509_sequence_to_stack(PyObject *certs)
+{
+    STACK_OF(X509) *stack;
+    PyObject *seq, *item;
+    Py_ssize_t i, n;
+
+    if ((seq = PySequence_Fast(certs, "Expected a sequence of X509 objects")) == NULL)
+        return NULL;
+
+    if ((stack = sk_X509_new_null()) == NULL)
+    {
+        Py_DECREF(seq);
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    for (i = 0; i < n; i++)
+    {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!crypto_X509_Check(item))
+        {
+            PyErr_SetString(PyExc_TypeError, "Expected a sequence of X509 objects");
+            goto error;
+        }
+        if (!sk_X509_push(stack, ((crypto_X509Obj *)item)->x509))
+        {
+            exception_from_error_queue(crypto_Error);
+            goto error;
+        }
+        X509_up_ref(((crypto_X509Obj *)item)->x509);
+    }
+
+    Py_DECREF(seq);
+    return stack;
+
+  error:
+    Py_DECREF(seq);
+    sk_X509_pop_free(stack, X509_free);
+    return NULL;
+}
+
+static char crypto_X509Store_verify_doc[] = "\n\
+Verify a certificate against the trusted certificates and CRLs in the store.\n\
+\n\
+@param cert: The certificate to verify\n\
+@param chain: (optional) a sequence of untrusted intermediate certificates\n\
+              which may be used to build the chain\n\
+@return: A tuple of the verification result, 0 (X509_V_OK) if the\n\
+         certificate is valid or one of the X509_V_* error codes otherwise,\n\
+         and the list of X509 objects in the chain that was built, starting\n\
+         with a copy of cert.\n\
+";
+
+static PyObject *
+crypto_X509Store_verify(crypto_X509StoreObj *self, PyObject *args, PyObject *kwargs)
+{
+    crypto_X509Obj *cert;
+    PyObject *untrusted_seq = Py_None, *chain_list, *item;
+    STACK_OF(X509) *untrusted = NULL, *chain = NULL;
+    int result, i, n;
+
+    static char *kwlist[] = {"cert", "chain", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O:verify", kwlist,
+                                     &crypto_X509_Type, &cert, &untrusted_seq))
+        return NULL;
+
+    if (untrusted_seq != Py_None &&
+        (untrusted = crypto_X509_sequence_to_stack(untrusted_seq)) == NULL)
+        return NULL;
+
+    MY_BEGIN_ALLOW_THREADS(ignored);
+    result = crypto_X509Store_verify_cert(self->x509_store, cert->x509,
+                                          untrusted, &chain);
+    sk_X509_pop_free(untrusted, X509_free);
+    MY_END_ALLOW_THREADS(ignored);
+
+    if (result < 0)
+    {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    n = chain == NULL ? 0 : sk_X509_num(chain);
+    if ((chain_list = PyList_New(n)) == NULL)
+    {
+        sk_X509_pop_free(chain, X509_free);
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+    {
+        X509 *copy;
+
+        /*
+         * The chain shares its certificates with cert, the untrusted ones and
+         * the store, which other X509 objects wrap.  Their decoded fields and
+         * digests are cached per object, so a change made through one of them
+         * would leave the others stale; hand out copies instead.
+         */
+        if ((copy = X509_dup(sk_X509_value(chain, i))) == NULL)
+        {
+            exception_from_error_queue(crypto_Error);
+            goto error;
+        }
+        if ((item = (PyObject *)crypto_X509_New(copy, 1)) == NULL)
+        {
+            X509_free(copy);
+            goto error;
+        }
+        PyList_SET_ITEM(chain_list, i, item);
+    }
+    sk_X509_pop_free(chain, X509_free);
+
+    return Py_BuildValue("(iN)", result, chain_list);
+
+  error:
+    sk_X509_pop_free(chain, X509_free);
+    Py_DECREF(chain_list);
+    return NULL;
+}
+
 
 /*
  * ADD_METHOD(name) expands to a correct PyMethodDef declaration
@@ -44,12 +333,20 @@ crypto_X509Store_add_cert(crypto_X509StoreObj *self, PyObject *args)
  */
 #define ADD_METHOD(name)        \
     { #name, (PyCFunction)crypto_X509Store_##name, METH_VARARGS, crypto_X509Store_##name##_doc }
+#define ADD_KW_METHOD(name)        \
+    { #name, (PyCFunction)crypto_X509Store_##name, METH_VARARGS | METH_KEYWORDS, crypto_X509Store_##name##_doc }
 static PyMethodDef crypto_X509Store_methods[] =
 {
     ADD_METHOD(add_cert),
+    ADD_METHOD(add_crl),
+    ADD_METHOD(load_locations),
+    ADD_METHOD(set_flags),
+    ADD_METHOD(set_depth),
+    ADD_KW_METHOD(verify),
     { NULL, NULL }
 };
 #undef ADD_METHOD
+#undef ADD_KW_METHOD
 
 
 /*
@@ -76,6 +373,34 @@ crypto_X509Store_New(X509_STORE *store, int dealloc)
     return self;
 }
 
+
+static char crypto_X509Store_doc[] = "\n\
+X509Store() -> X509Store instance\n\
+\n\
+Create a new, empty certificate store.  A store keeps its trusted\n\
+certificates, CRLs and verification parameters between calls to verify, so\n\
+it is meant to be set up once and reused.\n\
+\n\
+@return: The X509Store object\n\
+";
+
+static PyObject *
+crypto_X509Store_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
+{
+    X509_STORE *store;
+
+    if (!PyArg_ParseTuple(args, ":X509Store")) {
+        return NULL;
+    }
+
+    if ((store = X509_STORE_new()) == NULL) {
+        exception_from_error_queue(crypto_Error);
+        return NULL;
+    }
+
+    return (PyObject *)crypto_X509Store_New(store, 1);
+}
+
 /*
  * Deallocate the memory used by the X509Store object
  *
@@ -114,7 +439,7 @@ PyTypeObject crypto_X509Store_Type = {
     NULL, /* setattro */
     NULL, /* as_buffer */
     Py_TPFLAGS_DEFAULT,
-    NULL, /* doc */
+    crypto_X509Store_doc, /* doc */
     NULL, /* traverse */
     NULL, /* clear */
     NULL, /* tp_richcompare */
@@ -122,6 +447,16 @@ PyTypeObject crypto_X509Store_Type = {
     NULL, /* tp_iter */
     NULL, /* tp_iternext */
     crypto_X509Store_methods, /* tp_methods */
+    NULL, /* tp_members */
+    NULL, /* tp_getset */
+    NULL, /* tp_base */
+    NULL, /* tp_dict */
+    NULL, /* tp_descr_get */
+    NULL, /* tp_descr_set */
+    0, /* tp_dictoffset */
+    NULL, /* tp_init */
+    NULL, /* tp_alloc */
+    crypto_X509Store_new, /* tp_new */
 };
 
 
@@ -138,9 +473,30 @@ init_crypto_x509store(PyObject *module)
         return 0;
     }
 
+    if (PyModule_AddObject(module, "X509Store", (PyObject *)&crypto_X509Store_Type) != 0) {
+        return 0;
+    }
+
     if (PyModule_AddObject(module, "X509StoreType", (PyObject *)&crypto_X509Store_Type) != 0) {
         return 0;
     }
 
+    PyModule_AddIntConstant(module, "X509_V_OK", X509_V_OK);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_CRL_CHECK", X509_V_FLAG_CRL_CHECK);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_CRL_CHECK_ALL", X509_V_FLAG_CRL_CHECK_ALL);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_IGNORE_CRITICAL", X509_V_FLAG_IGNORE_CRITICAL);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_X509_STRICT", X509_V_FLAG_X509_STRICT);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_ALLOW_PROXY_CERTS", X509_V_FLAG_ALLOW_PROXY_CERTS);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_POLICY_CHECK", X509_V_FLAG_POLICY_CHECK);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_EXPLICIT_POLICY", X509_V_FLAG_EXPLICIT_POLICY);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_INHIBIT_ANY", X509_V_FLAG_INHIBIT_ANY);
+    PyModule_AddIntConstant(module, "X509_V_FLAG_INHIBIT_MAP", X509_V_FLAG_INHIBIT_MAP);
+#ifdef X509_V_FLAG_PARTIAL_CHAIN
+    PyModule_AddIntConstant(module, "X509_V_FLAG_PARTIAL_CHAIN", X509_V_FLAG_PARTIAL_CHAIN);
+#endif
+#ifdef X509_V_FLAG_NO_CHECK_TIME
+    PyModule_AddIntConstant(module, "X509_V_FLAG_NO_CHECK_TIME", X509_V_FLAG_NO_CHECK_TIME);
+#endif
+
     return 1;
 }
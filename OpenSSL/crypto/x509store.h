@@ -26,5 +26,10 @@ typedef struct {
     int                  dealloc;
 } crypto_X509StoreObj;
 
+extern  int     crypto_X509Store_verify_cert(X509_STORE *, X509 *,
+                                             STACK_OF(X509) *,
+                                             STACK_OF(X509) **);
+extern  STACK_OF(X509) *crypto_X509_sequence_to_stack(PyObject *);
+
 
 #endif
@@ -20,6 +20,7 @@ PyInit_##name(void)
 #define PyOpenSSL_MODRETURN(module) { return module; }
 
 #define BYTESTRING_FMT "y"
+#define BUFFER_FMT "y*"
 
 #else /* (PY_VERSION_HEX >= 0x03000000) */
 
@@ -35,6 +36,7 @@ PyInit_##name(void)
 #define PyBytes_Check PyString_Check
 #define PyBytes_CheckExact PyString_CheckExact
 #define PyBytes_AsString PyString_AsString
+#define PyBytes_AS_STRING PyString_AS_STRING
 #define PyBytes_FromString PyString_FromString
 #define PyBytes_FromStringAndSize PyString_FromStringAndSize
 #define _PyBytes_Resize _PyString_Resize
@@ -48,8 +50,17 @@ void \
 init##name(void)
 
 #define BYTESTRING_FMT "s"
+#define BUFFER_FMT "s*"
 
 #endif /* (PY_VERSION_HEX >= 0x03000000) */
 
+/*
+ * What PyThread_start_new_thread returns when it fails, which only got a name
+ * in Python 3.7
+ */
+#if (PY_VERSION_HEX < 0x03070000)
+#define PYTHREAD_INVALID_THREAD_ID (-1)
+#endif
+
 #endif /* PyOpenSSL_PY3K_H_ */
 
@@ -8,22 +8,44 @@ Unit tests for L{OpenSSL.crypto}.
 from unittest import main
 
 import os, re
+from sys import getsizeof
+from gc import collect, get_objects
+from mmap import mmap, ACCESS_READ
+from threading import Thread
+from hashlib import sha1, sha256
 from subprocess import PIPE, Popen
+from time import time, sleep
 from datetime import datetime, timedelta
 
 from OpenSSL.crypto import TYPE_RSA, TYPE_DSA, Error, PKey, PKeyType
+from OpenSSL.crypto import TYPE_EC, TYPE_ED25519
 from OpenSSL.crypto import X509, X509Type, X509Name, X509NameType
 from OpenSSL.crypto import X509Req, X509ReqType
 from OpenSSL.crypto import X509Extension, X509ExtensionType
 from OpenSSL.crypto import load_certificate, load_privatekey
+from OpenSSL.crypto import load_certificates, iter_certificates
 from OpenSSL.crypto import FILETYPE_PEM, FILETYPE_ASN1, FILETYPE_TEXT
+from OpenSSL.crypto import set_certificate_cache_size, get_certificate_cache_info
 from OpenSSL.crypto import dump_certificate, load_certificate_request
 from OpenSSL.crypto import dump_certificate_request, dump_privatekey
+from OpenSSL.crypto import dump_certificate_into, dump_privatekey_into
+from OpenSSL.crypto import dump_certificate_request_into
 from OpenSSL.crypto import PKCS7Type, load_pkcs7_data
 from OpenSSL.crypto import PKCS12, PKCS12Type, load_pkcs12
 from OpenSSL.crypto import CRL, Revoked, load_crl
 from OpenSSL.crypto import NetscapeSPKI, NetscapeSPKIType
-from OpenSSL.crypto import sign, verify
+from OpenSSL.crypto import X509Store, X509StoreType
+from OpenSSL.crypto import X509_V_OK, X509_V_FLAG_NO_CHECK_TIME
+from OpenSSL.crypto import verify_many, fingerprint_many, extract_fields
+from OpenSSL.crypto import sign, verify, sign_many, verify_signatures
+from OpenSSL.crypto import generate_keys
+from OpenSSL.crypto import Signer, SignerType, Verifier, VerifierType
+from OpenSSL.crypto import Digest, DigestType, Cipher, CipherType
+from OpenSSL.crypto import CompactX509, CompactX509Type
+from OpenSSL.crypto import KeyPool, KeyPoolType
+from OpenSSL.crypto import DSAParameters, DSAParametersType
+from OpenSSL.crypto import load_dsa_params, dump_dsa_params
+from OpenSSL.crypto import get_digest, get_cipher
 from OpenSSL.test.util import TestCase, bytes, b
 
 def normalize_certificate_pem(pem):
@@ -282,6 +304,22 @@ RFEIPQsFZRLrtnCAiEhyT8bC2s/Njlu6ly9gtJZWSV46Q3ZjBL4q9sHKqZQ=
 -----END CERTIFICATE-----""")
 
 
+# A certificate whose subject has two OU components
+multipleOUCertificatePEM = b("""-----BEGIN CERTIFICATE-----
+MIIB3TCCAYOgAwIBAgIUE/Ctq6RGQoa+hYS3MNoUGjjtux8wCgYIKoZIzj0EAwIw
+QzEQMA4GA1UECgwHVGVzdGluZzEOMAwGA1UECwwFZmlyc3QxDzANBgNVBAsMBnNl
+Y29uZDEOMAwGA1UEAwwFbXVsdGkwIBcNMjYxMDE3MTgyNDM0WhgPMjEyNjA5MjMx
+ODI0MzRaMEMxEDAOBgNVBAoMB1Rlc3RpbmcxDjAMBgNVBAsMBWZpcnN0MQ8wDQYD
+VQQLDAZzZWNvbmQxDjAMBgNVBAMMBW11bHRpMFkwEwYHKoZIzj0CAQYIKoZIzj0D
+AQcDQgAEnM9Xm7QmhM5f+1dEBjKp/lySPtySlZxuCqcLceca08TQV4cZBTDDzVbS
+oB8IgcsFSBG+GMxhU6Wxlsmd1OcXDqNTMFEwHQYDVR0OBBYEFBCFp53yKiuq7RjB
+qeUJNtaZVtkOMB8GA1UdIwQYMBaAFBCFp53yKiuq7RjBqeUJNtaZVtkOMA8GA1Ud
+EwEB/wQFMAMBAf8wCgYIKoZIzj0EAwIDSAAwRQIhAL/6CQyB9DTne6hn0wvRlVpn
+bdcmeSjG9zHZ1hFdBuKzAiBX0UKgGe1EjowcLMuxDwUkoDwcLz95E/PrG9FRATG4
+kw==
+-----END CERTIFICATE-----""")
+
+
 class X509ExtTests(TestCase):
     """
     Tests for L{OpenSSL.crypto.X509Extension}.
@@ -613,6 +651,85 @@ class PKeyTests(TestCase):
         self.assertEqual(key.bits(), bits)
 
 
+    def test_ecGeneration(self):
+        """
+        L{PKeyType.generate_key} generates an EC key when passed L{TYPE_EC}
+        as a type and the size of a NIST curve or the name of a curve.
+        """
+        for curve, bits in [(256, 256), (384, 384), ("P-256", 256),
+                            ("secp521r1", 521), (u"prime256v1", 256)]:
+            key = PKey()
+            key.generate_key(TYPE_EC, curve)
+            self.assertEqual(key.type(), TYPE_EC)
+            self.assertEqual(key.bits(), bits)
+
+
+    def test_ecGenerationWrongArgs(self):
+        """
+        L{PKeyType.generate_key} raises L{TypeError} when called with
+        L{TYPE_EC} and no curve, and L{ValueError} when the curve is unknown.
+        """
+        key = PKey()
+        self.assertRaises(TypeError, key.generate_key, TYPE_EC)
+        self.assertRaises(TypeError, key.generate_key, TYPE_EC, None)
+        self.assertRaises(ValueError, key.generate_key, TYPE_EC, 255)
+        self.assertRaises(ValueError, key.generate_key, TYPE_EC, "no such curve")
+        self.assertRaises(TypeError, key.generate_key, TYPE_RSA)
+
+
+    def test_ed25519Generation(self):
+        """
+        L{PKeyType.generate_key} generates an Ed25519 key when passed
+        L{TYPE_ED25519} as a type, with or without a number of bits.
+        """
+        key = PKey()
+        key.generate_key(TYPE_ED25519)
+        self.assertEqual(key.type(), TYPE_ED25519)
+        key.generate_key(TYPE_RSA, 512)
+        key.generate_key(TYPE_ED25519, 256)
+        self.assertEqual(key.type(), TYPE_ED25519)
+
+
+    def test_multiPrimeRSAGeneration(self):
+        """
+        L{PKeyType.generate_key} generates an RSA key with as many primes as
+        given by the C{primes} keyword argument, which can be dumped and
+        loaded again.
+        """
+        key = PKey()
+        key.generate_key(TYPE_RSA, 2048, primes=3)
+        self.assertEqual(key.type(), TYPE_RSA)
+        self.assertEqual(key.bits(), 2048)
+        text = dump_privatekey(FILETYPE_TEXT, key)
+        self.assertTrue(b("prime3:") in text)
+        self.assertFalse(b("prime4:") in text)
+        pem = dump_privatekey(FILETYPE_PEM, key)
+        for filetype in [FILETYPE_PEM, FILETYPE_ASN1]:
+            loaded = load_privatekey(filetype, dump_privatekey(filetype, key))
+            self.assertEqual(loaded.bits(), 2048)
+            self.assertEqual(dump_privatekey(FILETYPE_PEM, loaded), pem)
+
+        key.generate_key(TYPE_RSA, 1024, primes=2)
+        self.assertFalse(b("prime3:") in dump_privatekey(FILETYPE_TEXT, key))
+
+
+    def test_multiPrimeRSAGenerationWrongArgs(self):
+        """
+        L{PKeyType.generate_key} raises L{TypeError} if C{primes} is not
+        given as a keyword argument or is not an integer, L{ValueError} if it
+        is less than 2 or given for a key type other than L{TYPE_RSA}, and
+        L{Error} if there are too many primes for the number of bits.
+        """
+        key = PKey()
+        self.assertRaises(TypeError, key.generate_key, TYPE_RSA, 1024, 3)
+        self.assertRaises(
+            TypeError, key.generate_key, TYPE_RSA, 1024, primes="3")
+        self.assertRaises(ValueError, key.generate_key, TYPE_RSA, 1024, primes=1)
+        self.assertRaises(ValueError, key.generate_key, TYPE_DSA, 1024, primes=3)
+        self.assertRaises(ValueError, key.generate_key, TYPE_EC, 256, primes=3)
+        self.assertRaises(Error, key.generate_key, TYPE_RSA, 1024, primes=4)
+
+
     def test_regeneration(self):
         """
         L{PKeyType.generate_key} can be called multiple times on the same
@@ -836,6 +953,256 @@ class X509NameTests(TestCase):
             "null.python.org\x00example.org", subject.commonName)
 
 
+    def test_subscript(self):
+        """
+        An L{X509NameType} instance can be indexed by the short or long name
+        of a component, giving the same value as the attribute of that name.
+        """
+        name = self._x509name(CN="foo", O="bar")
+        self.assertEqual(name["CN"], name.commonName)
+        self.assertEqual(name["commonName"], "foo")
+        self.assertEqual(name["O"], "bar")
+
+
+    def test_subscript_missing(self):
+        """
+        Indexing an L{X509NameType} instance with a component it doesn't have,
+        or with a name which isn't a component at all, raises L{KeyError}.
+        Indexing it with anything but a string raises L{TypeError}.
+        """
+        name = self._x509name(CN="foo")
+        self.assertRaises(KeyError, lambda: name["OU"])
+        self.assertRaises(KeyError, lambda: name["no such thing"])
+        self.assertRaises(TypeError, lambda: name[1])
+
+
+    def test_bytes_keys(self):
+        """
+        Component names can be given as bytes as well as text when indexing
+        an L{X509NameType} instance, calling L{X509Name.get_all} or building
+        an L{X509Name} from components.
+        """
+        name = X509Name([(b("CN"), "foo"), (b("organizationalUnitName"), "x"),
+                         (u"OU", "y")])
+        self.assertEqual(name[b("CN")], name[u"CN"])
+        self.assertEqual(name[b("commonName")], u"foo")
+        self.assertEqual(name.get_all(b("OU")), [u"x", u"y"])
+        self.assertEqual(name.get_all(b("OU")), name.get_all(u"OU"))
+        self.assertRaises(KeyError, lambda: name[b("no such thing")])
+        self.assertRaises(ValueError, name.get_all, b("no such thing"))
+
+
+    def test_empty_is_true(self):
+        """
+        An L{X509NameType} instance with no components is still true.
+        """
+        self.assertTrue(self._x509name())
+
+
+    def test_get_all(self):
+        """
+        L{X509Name.get_all} returns the values of every component with the
+        given name, in order.
+        """
+        cert = load_certificate(FILETYPE_PEM, multipleOUCertificatePEM)
+        subject = cert.get_subject()
+        self.assertEqual(subject.get_all("OU"), [u"first", u"second"])
+        self.assertEqual(
+            subject.get_all("organizationalUnitName"), [u"first", u"second"])
+        self.assertEqual(subject.get_all("CN"), [u"multi"])
+        self.assertEqual(subject.get_all("L"), [])
+
+
+    def test_get_all_wrong_args(self):
+        """
+        L{X509Name.get_all} raises L{ValueError} when called with a name which
+        isn't a component and L{TypeError} when called with anything but a
+        single string.
+        """
+        name = self._x509name()
+        self.assertRaises(ValueError, name.get_all, "no such thing")
+        self.assertRaises(TypeError, name.get_all, None)
+        self.assertRaises(TypeError, name.get_all)
+        self.assertRaises(TypeError, name.get_all, "CN", "O")
+
+
+    def test_as_dict(self):
+        """
+        L{X509Name.as_dict} returns a dict mapping the short name of each
+        component to its first value.
+        """
+        cert = load_certificate(FILETYPE_PEM, multipleOUCertificatePEM)
+        self.assertEqual(
+            cert.get_subject().as_dict(),
+            {"O": u"Testing", "OU": u"first", "CN": u"multi"})
+        self.assertEqual(self._x509name().as_dict(), {})
+        self.assertRaises(TypeError, self._x509name().as_dict, None)
+
+
+    def test_attribute_lookup(self):
+        """
+        Looking up the same attributes of L{X509NameType} instances repeatedly
+        gives the component values, the methods, or L{AttributeError} for
+        names which are neither.
+        """
+        name = self._x509name(CN="foo")
+        for i in range(3):
+            self.assertEqual(name.CN, "foo")
+            self.assertEqual(name.OU, None)
+            self.assertEqual(name.get_components(), [(b("CN"), b("foo"))])
+            self.assertRaises(AttributeError, getattr, name, "no_such_thing")
+
+
+    def test_from_components(self):
+        """
+        L{X509Name} can be called with a sequence of (field, value) pairs to
+        create a name made of those components, in that order.
+        """
+        name = X509Name([("CN", "foo"), ("O", u"bar"), ("OU", "x"),
+                         ("organizationalUnitName", "y")])
+        self.assertEqual(
+            name.get_components(),
+            [(b("CN"), b("foo")), (b("O"), b("bar")),
+             (b("OU"), b("x")), (b("OU"), b("y"))])
+        self.assertEqual(X509Name([]).get_components(), [])
+
+
+    def test_from_components_multivalued(self):
+        """
+        An item of the sequence passed to L{X509Name} which is itself a
+        sequence of pairs makes a multi-valued RDN.
+        """
+        name = X509Name([("C", "US"), (("O", "foo"), ("OU", "bar"))])
+        self.assertEqual(
+            name.get_components(),
+            [(b("C"), b("US")), (b("O"), b("foo")), (b("OU"), b("bar"))])
+        self.assertEqual(name.der(), X509Name(name).der())
+        self.assertNotEqual(
+            name.der(),
+            X509Name([("C", "US"), ("O", "foo"), ("OU", "bar")]).der())
+
+
+    def test_from_components_wrong_args(self):
+        """
+        L{X509Name} raises L{TypeError} when given something which isn't a
+        sequence of components and L{ValueError} for unknown fields or empty
+        RDNs.
+        """
+        self.assertRaises(TypeError, X509Name, None)
+        self.assertRaises(TypeError, X509Name, [("CN",)])
+        self.assertRaises(TypeError, X509Name, [("CN", 1)])
+        self.assertRaises(TypeError, X509Name, [(1, "foo")])
+        self.assertRaises(TypeError, X509Name, ["CN"])
+        self.assertRaises(ValueError, X509Name, [("no such thing", "foo")])
+        self.assertRaises(ValueError, X509Name, [()])
+
+
+    def test_set_components(self):
+        """
+        L{X509Name.set_components} replaces all the components of the name.
+        """
+        name = self._x509name(CN="foo", O="bar")
+        name.set_components([("OU", "baz"), ("CN", "quux")])
+        self.assertEqual(
+            name.get_components(), [(b("OU"), b("baz")), (b("CN"), b("quux"))])
+
+
+    def test_set_components_failure(self):
+        """
+        When L{X509Name.set_components} fails, the name is left unchanged.
+        """
+        name = self._x509name(CN="foo")
+        self.assertRaises(ValueError, name.set_components,
+                          [("O", "bar"), ("no such thing", "foo")])
+        # A country name must be two characters long
+        self.assertRaises(Error, name.set_components,
+                          [("O", "bar"), ("C", "too long")])
+        self.assertEqual(name.get_components(), [(b("CN"), b("foo"))])
+
+
+    def test_set_components_of_certificate(self):
+        """
+        L{X509Name.set_components} on the subject of a certificate changes
+        the certificate.
+        """
+        cert = X509()
+        cert.get_subject().set_components([("CN", "foo")])
+        self.assertEqual(cert.get_subject().CN, "foo")
+        self.assertEqual(
+            cert.get_subject().get_components(), [(b("CN"), b("foo"))])
+
+
+    def test_set_subject_components(self):
+        """
+        L{X509.set_subject} and L{X509.set_issuer} accept a sequence of
+        components, which replaces the name of the certificate in place.
+        """
+        cert = X509()
+        subject = cert.get_subject()
+        cert.set_subject([("CN", "foo"), ("O", "bar")])
+        cert.set_issuer([("CN", "baz")])
+        self.assertEqual(
+            subject.get_components(), [(b("CN"), b("foo")), (b("O"), b("bar"))])
+        self.assertEqual(
+            cert.get_issuer().get_components(), [(b("CN"), b("baz"))])
+        self.assertRaises(TypeError, cert.set_subject, None)
+        self.assertRaises(ValueError, cert.set_issuer, [("bad", "foo")])
+        self.assertEqual(
+            cert.get_issuer().get_components(), [(b("CN"), b("baz"))])
+
+
+    def test_hashable(self):
+        """
+        L{X509NameType} instances which are equal hash the same, so they can
+        be used as dict keys.
+        """
+        a = X509Name([("CN", "foo"), ("O", "bar")])
+        b = X509Name([("CN", u"foo"), ("O", "bar")])
+        self.assertEqual(hash(a), hash(b))
+        self.assertEqual({a: 1}[b], 1)
+        self.assertEqual(hash(X509Name([])), hash(X509Name([])))
+
+
+    def test_canonical_comparison(self):
+        """
+        L{X509NameType} instances compare and hash the way OpenSSL compares
+        names, ignoring the case of ASCII letters and extra white space.
+        """
+        a = X509Name([("CN", "  Foo   Bar "), ("O", "x")])
+        b = X509Name([("CN", "foo bar"), ("O", "X")])
+        self.assertEqual(a, b)
+        self.assertEqual(hash(a), hash(b))
+        self.assertEqual(a.hash(), b.hash())
+        self.assertNotEqual(a, X509Name([("CN", "foobar"), ("O", "x")]))
+
+
+    def test_comparison_after_change(self):
+        """
+        Changing an L{X509NameType} instance changes how it compares and
+        hashes, even when the change is made through another object for the
+        same name.
+        """
+        request = X509Req()
+        first = request.get_subject()
+        second = request.get_subject()
+        other = X509Name([("CN", "foo")])
+        self.assertNotEqual(first, other)
+        hash(first)
+        second.CN = "foo"
+        self.assertEqual(first, other)
+        self.assertEqual(hash(first), hash(other))
+        first.set_components([("CN", "bar")])
+        self.assertNotEqual(second, other)
+
+
+    def test_get_oneline_long(self):
+        """
+        L{X509Name.get_oneline} returns the whole of a long name.
+        """
+        name = X509Name([("OU", "x" * 60)] * 10)
+        self.assertEqual(name.get_oneline(), b("/OU=" + "x" * 60) * 10)
+
+
 
 class _PKeyInteractionTestsMixin:
     """
@@ -1017,6 +1384,68 @@ class X509ReqTests(TestCase, _PKeyInteractionTestsMixin):
         self.assertRaises(TypeError, request.add_extensions, [], None)
 
 
+    def test_hash_equality(self):
+        """
+        L{X509Req} instances are equal and hash the same when their DER
+        encodings are the same, which changes when they are modified.
+        """
+        pkey = load_privatekey(FILETYPE_PEM, root_key_pem)
+        request = X509Req()
+        request.set_pubkey(pkey)
+        request.get_subject().commonName = "hash test"
+        request.sign(pkey, "sha256")
+        der = dump_certificate_request(FILETYPE_ASN1, request)
+        first = load_certificate_request(FILETYPE_ASN1, der)
+        second = load_certificate_request(FILETYPE_ASN1, der)
+        self.assertEqual(first, second)
+        self.assertEqual(first, request)
+        self.assertFalse(first != second)
+        self.assertEqual(hash(first), hash(second))
+        self.assertEqual(len(set([first, second, request])), 1)
+
+        second.set_version(2)
+        second.sign(pkey, "sha256")
+        self.assertNotEqual(first, second)
+        self.assertNotEqual(hash(first), hash(second))
+
+        # Incomplete requests are only equal to themselves
+        empty = X509Req()
+        self.assertEqual(empty, empty)
+        self.assertNotEqual(empty, X509Req())
+        self.assertEqual(hash(empty), hash(empty))
+        self.assertNotEqual(first, der)
+
+
+    def test_to_dict(self):
+        """
+        L{X509Req.to_dict} returns a dict with the same values as the other
+        methods of L{X509Req}, L{X509Name}, L{PKey} and L{X509Extension}.
+        """
+        pkey = load_privatekey(FILETYPE_PEM, root_key_pem)
+        request = X509Req()
+        request.set_pubkey(pkey)
+        request.get_subject().commonName = "dict test"
+        request.get_subject().organizationName = "Testing"
+        extension = X509Extension(b('basicConstraints'), True, b('CA:false'))
+        request.add_extensions([extension])
+        request.sign(pkey, "sha256")
+        self.assertEqual(request.to_dict(), {
+                "version": request.get_version(),
+                "signature_algorithm": b("RSA-SHA256"),
+                "subject": request.get_subject().get_components(),
+                "public_key": {"type": pkey.type(), "bits": pkey.bits()},
+                "extensions": [{"name": extension.get_short_name(),
+                                "critical": True,
+                                "data": extension.get_data(),
+                                "value": str(extension)}]})
+
+        self.assertEqual(X509Req().to_dict(), {
+                "version": X509Req().get_version(),
+                "signature_algorithm": None, "subject": [],
+                "public_key": None, "extensions": []})
+        self.assertRaises(TypeError, request.to_dict, None)
+
+
 
 class X509Tests(TestCase, _PKeyInteractionTestsMixin):
     """
@@ -1301,6 +1730,62 @@ WpOdIpB8KksUTCzV591Nr1wd
             b("A5:34:21:2A:E6:9E:BE:42:E1:1C:A8:C4:69:ED:0E:B4:55:5E:79:48"))
 
 
+    def test_digest_raw(self):
+        """
+        L{X509.digest} returns the raw bytes of the digest of the DER encoding
+        of the certificate if C{raw} is true.
+        """
+        cert = load_certificate(FILETYPE_PEM, self.pemData)
+        der = dump_certificate(FILETYPE_ASN1, cert)
+        self.assertEqual(cert.digest("sha1", True), sha1(der).digest())
+        self.assertEqual(
+            cert.digest(digest="sha256", raw=True), sha256(der).digest())
+        self.assertEqual(
+            cert.digest("sha256", raw=False),
+            b(":").join([b("%02X") % (ord(c),)
+                         for c in sha256(der).digest().decode("latin-1")]))
+        self.assertRaises(TypeError, cert.digest)
+        self.assertRaises(TypeError, cert.digest, "sha1", "yes")
+        self.assertRaises(ValueError, cert.digest, "strange-digest", True)
+
+
+    def test_fingerprint_many(self):
+        """
+        L{fingerprint_many} returns the raw digests of the DER encoding of
+        every certificate, as a list or joined in one string, whatever the
+        number of threads used.
+        """
+        certs = [load_certificate(FILETYPE_PEM, pem)
+                 for pem in [root_cert_pem, server_cert_pem, client_cert_pem]]
+        certs = certs * 10
+        expected = [sha256(dump_certificate(FILETYPE_ASN1, cert)).digest()
+                    for cert in certs]
+        for threads in [0, 1, 4]:
+            self.assertEqual(
+                fingerprint_many(certs, "sha256", threads=threads), expected)
+            self.assertEqual(
+                fingerprint_many(certs, "sha256", True, threads),
+                b("").join(expected))
+        self.assertEqual(
+            fingerprint_many(tuple(certs[:2]), get_digest("sha1")),
+            [cert.digest("sha1", True) for cert in certs[:2]])
+        self.assertEqual(fingerprint_many([], "sha1"), [])
+        self.assertEqual(fingerprint_many([], "sha1", joined=True), b(""))
+
+
+    def test_fingerprint_many_wrong_args(self):
+        """
+        L{fingerprint_many} raises L{TypeError} for anything but a sequence
+        of L{X509} objects and L{ValueError} for an unknown digest.
+        """
+        cert = load_certificate(FILETYPE_PEM, self.pemData)
+        self.assertRaises(TypeError, fingerprint_many)
+        self.assertRaises(TypeError, fingerprint_many, None, "sha1")
+        self.assertRaises(TypeError, fingerprint_many, [cert, None], "sha1")
+        self.assertRaises(
+            ValueError, fingerprint_many, [cert], "strange-digest")
+
+
     def _extcert(self, pkey, extensions):
         cert = X509()
         cert.set_pubkey(pkey)
@@ -1556,97 +2041,773 @@ WpOdIpB8KksUTCzV591Nr1wd
              ])
 
 
+    def test_hash_equality(self):
+        """
+        L{X509} instances are equal and hash the same when their DER encodings
+        are the same, so that copies of a certificate can be deduplicated.
+        """
+        first = load_certificate(FILETYPE_PEM, self.pemData)
+        second = load_certificate(FILETYPE_PEM, self.pemData)
+        other = load_certificate(FILETYPE_PEM, server_cert_pem)
+        self.assertEqual(first, second)
+        self.assertFalse(first != second)
+        self.assertEqual(hash(first), hash(second))
+        self.assertNotEqual(first, other)
+        self.assertFalse(first == other)
+        self.assertEqual(len(set([first, second, other])), 2)
+        self.assertEqual({first: 1}[second], 1)
+        self.assertNotEqual(first, self.pemData)
+        self.assertNotEqual(first, None)
+
 
-class PKCS12Tests(TestCase):
+    def test_hash_equality_mutation(self):
+        """
+        Modifying an L{X509} instance changes its equality and hash.
+        """
+        pkey = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        copy = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.assertEqual(hash(cert), hash(copy))
+        copy.set_serial_number(cert.get_serial_number() + 1)
+        copy.sign(pkey, "sha256")
+        self.assertNotEqual(cert, copy)
+        self.assertNotEqual(hash(cert), hash(copy))
+        cert.set_serial_number(copy.get_serial_number())
+        cert.sign(pkey, "sha256")
+        self.assertEqual(cert, copy)
+        self.assertEqual(hash(cert), hash(copy))
+
+        # Changes made through the subject name are seen as well
+        cert = X509()
+        cert.set_pubkey(pkey)
+        cert.sign(pkey, "sha256")
+        before = hash(cert)
+        cert.get_subject().commonName = "changed"
+        self.assertNotEqual(hash(cert), before)
+
+        # Incomplete certificates are only equal to themselves
+        empty = X509()
+        self.assertEqual(empty, empty)
+        self.assertNotEqual(empty, X509())
+        self.assertEqual(hash(empty), hash(empty))
+
+
+    def test_decoded_field_cache(self):
+        """
+        Repeated calls to the getters of L{X509} return the same objects until
+        the corresponding setter is called.
+        """
+        cert = load_certificate(FILETYPE_PEM, self.pemData)
+        for getter in [cert.get_subject, cert.get_issuer,
+                       cert.get_serial_number, cert.get_notBefore,
+                       cert.get_notAfter]:
+            self.assertIdentical(getter(), getter())
+
+        subject = cert.get_subject()
+        subject.commonName = "changed"
+        self.assertIdentical(cert.get_subject(), subject)
+        self.assertEqual(cert.get_subject().commonName, "changed")
+
+        name = X509Name(subject)
+        name.commonName = "replaced"
+        cert.set_subject(name)
+        self.assertEqual(cert.get_subject().commonName, "replaced")
+        cert.set_issuer(name)
+        self.assertEqual(cert.get_issuer().commonName, "replaced")
+        cert.set_serial_number(12345)
+        self.assertEqual(cert.get_serial_number(), 12345)
+        cert.set_notBefore(b("20000101000000Z"))
+        self.assertEqual(cert.get_notBefore(), b("20000101000000Z"))
+        cert.set_notAfter(b("20300101000000Z"))
+        self.assertEqual(cert.get_notAfter(), b("20300101000000Z"))
+        cert.gmtime_adj_notAfter(0)
+        self.assertNotEqual(cert.get_notAfter(), b("20300101000000Z"))
+
+
+    def test_decoded_subject_alt_name_cache(self):
+        """
+        L{X509.get_subject_alt_name} returns a new list each time, which
+        changes when extensions are added to or deleted from the certificate.
+        """
+        cert = X509()
+        self.assertIdentical(cert.get_subject_alt_name(), None)
+        cert.add_extensions([X509Extension(
+                    b('subjectAltName'), False,
+                    b('DNS:example.com, email:me@example.com'))])
+        names = cert.get_subject_alt_name()
+        self.assertEqual(
+            names, [(2, b('example.com')), (1, b('me@example.com'))])
+        names.append(None)
+        self.assertEqual(len(cert.get_subject_alt_name()), 2)
+        cert.del_extension(0)
+        self.assertIdentical(cert.get_subject_alt_name(), None)
+        self.assertRaises(TypeError, cert.get_subject_alt_name, None)
+
+
+    def test_decoded_field_cache_collected(self):
+        """
+        An L{X509} instance whose subject and issuer have been retrieved is
+        freed by the garbage collector, even though the cached L{X509Name}
+        instances refer back to it.
+        """
+        def count():
+            collect()
+            return len([o for o in get_objects() if isinstance(o, X509)])
+        before = count()
+        cert = load_certificate(FILETYPE_PEM, self.pemData)
+        cert.get_subject()
+        cert.get_issuer()
+        del cert
+        self.assertEqual(count(), before)
+
+
+    def test_to_dict(self):
+        """
+        L{X509.to_dict} returns a dict with the same values as the other
+        methods of L{X509}, L{X509Name}, L{PKey} and L{X509Extension}.
+        """
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        decoded = cert.to_dict()
+        extensions = [cert.get_extension(i)
+                      for i in range(cert.get_extension_count())]
+        self.assertEqual(decoded, {
+                "version": cert.get_version(),
+                "serial_number": cert.get_serial_number(),
+                "signature_algorithm": cert.get_signature_algorithm(),
+                "subject": cert.get_subject().get_components(),
+                "issuer": cert.get_issuer().get_components(),
+                "not_before": cert.get_notBefore(),
+                "not_after": cert.get_notAfter(),
+                "public_key": {"type": cert.get_pubkey().type(),
+                               "bits": cert.get_pubkey().bits()},
+                "subject_alt_name": None,
+                "extensions": [{"name": ext.get_short_name(),
+                                "critical": bool(ext.get_critical()),
+                                "data": ext.get_data(),
+                                "value": str(ext)}
+                               for ext in extensions]})
+
+        cert = X509()
+        cert.add_extensions([X509Extension(
+                    b('subjectAltName'), False, b('DNS:example.com'))])
+        decoded = cert.to_dict()
+        self.assertEqual(decoded["subject_alt_name"], [(2, b('example.com'))])
+        self.assertEqual(decoded["extensions"][0]["value"], "DNS:example.com")
+        self.assertIdentical(decoded["public_key"], None)
+        self.assertIdentical(decoded["not_after"], None)
+        self.assertRaises(TypeError, cert.to_dict, None)
+
+
+
+class CompactX509Tests(TestCase):
     """
-    Test for L{OpenSSL.crypto.PKCS12} and L{OpenSSL.crypto.load_pkcs12}.
+    Tests for L{OpenSSL.crypto.CompactX509}.
     """
-    pemData = cleartextCertificatePEM + cleartextPrivateKeyPEM
+    def setUp(self):
+        self.cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.der = dump_certificate(FILETYPE_ASN1, self.cert)
+
 
     def test_type(self):
         """
-        L{PKCS12Type} is a type object.
+        L{CompactX509} and L{CompactX509Type} refer to the same type object and
+        can be used to create instances of that type.
         """
-        self.assertIdentical(PKCS12, PKCS12Type)
-        self.assertConsistentType(PKCS12, 'PKCS12')
+        self.assertIdentical(CompactX509, CompactX509Type)
+        self.assertConsistentType(CompactX509, 'CompactX509', self.der)
 
 
-    def test_empty_construction(self):
+    def test_der(self):
         """
-        L{PKCS12} returns a new instance of L{PKCS12} with no certificate,
-        private key, CA certificates, or friendly name.
+        L{CompactX509.der} returns the DER encoding of the certificate, whether
+        it was created from an L{X509} instance or from the encoding, which may
+        be any buffer.
         """
-        p12 = PKCS12()
-        self.assertEqual(None, p12.get_certificate())
-        self.assertEqual(None, p12.get_privatekey())
-        self.assertEqual(None, p12.get_ca_certificates())
-        self.assertEqual(None, p12.get_friendlyname())
+        self.assertEqual(CompactX509(self.cert).der(), self.der)
+        self.assertEqual(CompactX509(self.der).der(), self.der)
+        self.assertEqual(CompactX509(bytearray(self.der)).der(), self.der)
+        self.assertEqual(CompactX509(self.der + b("trailer")).der(), self.der)
 
 
-    def test_type_errors(self):
+    def test_fields(self):
         """
-        The L{PKCS12} setter functions (C{set_certificate}, C{set_privatekey},
-        C{set_ca_certificates}, and C{set_friendlyname}) raise L{TypeError}
-        when passed objects of types other than those expected.
+        The fields kept by L{CompactX509} have the same values as those of the
+        L{X509} instance.
         """
-        p12 = PKCS12()
-        self.assertRaises(TypeError, p12.set_certificate, 3)
-        self.assertRaises(TypeError, p12.set_certificate, PKey())
-        self.assertRaises(TypeError, p12.set_certificate, X509)
-        self.assertRaises(TypeError, p12.set_privatekey, 3)
-        self.assertRaises(TypeError, p12.set_privatekey, 'legbone')
-        self.assertRaises(TypeError, p12.set_privatekey, X509())
-        self.assertRaises(TypeError, p12.set_ca_certificates, 3)
-        self.assertRaises(TypeError, p12.set_ca_certificates, X509())
-        self.assertRaises(TypeError, p12.set_ca_certificates, (3, 4))
-        self.assertRaises(TypeError, p12.set_ca_certificates, ( PKey(), ))
-        self.assertRaises(TypeError, p12.set_friendlyname, 6)
-        self.assertRaises(TypeError, p12.set_friendlyname, ('foo', 'bar'))
+        compact = CompactX509(self.der)
+        self.assertEqual(compact.get_notBefore(), self.cert.get_notBefore())
+        self.assertEqual(compact.get_notAfter(), self.cert.get_notAfter())
+        self.assertEqual(compact.has_expired(), self.cert.has_expired())
+        self.assertEqual(
+            compact.subject_name_hash(), self.cert.subject_name_hash())
 
 
-    def test_key_only(self):
+    def test_to_x509(self):
         """
-        A L{PKCS12} with only a private key can be exported using
-        L{PKCS12.export} and loaded again using L{load_pkcs12}.
+        L{CompactX509.to_x509} returns a new L{X509} instance for the
+        certificate, which can be changed without affecting the compact one.
         """
-        passwd = 'blah'
-        p12 = PKCS12()
-        pkey = load_privatekey(FILETYPE_PEM, cleartextPrivateKeyPEM)
-        p12.set_privatekey(pkey)
-        self.assertEqual(None, p12.get_certificate())
-        self.assertEqual(pkey, p12.get_privatekey())
-        try:
-            dumped_p12 = p12.export(passphrase=passwd, iter=2, maciter=3)
-        except Error:
-            # Some versions of OpenSSL will throw an exception
-            # for this nearly useless PKCS12 we tried to generate:
-            # [('PKCS12 routines', 'PKCS12_create', 'invalid null argument')]
-            return
-        p12 = load_pkcs12(dumped_p12, passwd)
-        self.assertEqual(None, p12.get_ca_certificates())
-        self.assertEqual(None, p12.get_certificate())
+        compact = CompactX509(self.der)
+        cert = compact.to_x509()
+        self.assertTrue(isinstance(cert, X509Type))
+        self.assertEqual(cert, self.cert)
+        self.assertNotIdentical(compact.to_x509(), cert)
+        cert.set_serial_number(1)
+        self.assertEqual(compact.der(), self.der)
 
-        # OpenSSL fails to bring the key back to us.  So sad.  Perhaps in the
-        # future this will be improved.
-        self.assertTrue(isinstance(p12.get_privatekey(), (PKey, type(None))))
+
+    def test_hash_equality(self):
+        """
+        L{CompactX509} instances are equal, and hash the same, when their
+        encodings are.  They are not equal to L{X509} instances.
+        """
+        compact = CompactX509(self.cert)
+        self.assertEqual(compact, CompactX509(self.der))
+        self.assertFalse(compact != CompactX509(self.der))
+        self.assertEqual(hash(compact), hash(CompactX509(self.der)))
+        self.assertNotEqual(compact, self.cert)
+        other = CompactX509(load_certificate(FILETYPE_PEM, server_cert_pem))
+        self.assertNotEqual(compact, other)
+        self.assertEqual(len(set([compact, CompactX509(self.der), other])), 2)
+        self.assertNotEqual(compact, self.der)
 
 
-    def test_cert_only(self):
+    def test_size(self):
         """
-        A L{PKCS12} with only a certificate can be exported using
-        L{PKCS12.export} and loaded again using L{load_pkcs12}.
+        A L{CompactX509} instance takes little more memory than the encoding of
+        the certificate.
         """
-        passwd = 'blah'
-        p12 = PKCS12()
-        cert = load_certificate(FILETYPE_PEM, cleartextCertificatePEM)
-        p12.set_certificate(cert)
-        self.assertEqual(cert, p12.get_certificate())
-        self.assertEqual(None, p12.get_privatekey())
-        try:
-            dumped_p12 = p12.export(passphrase=passwd, iter=2, maciter=3)
-        except Error:
-            # Some versions of OpenSSL will throw an exception
-            # for this nearly useless PKCS12 we tried to generate:
+        compact = CompactX509(self.der)
+        self.assertTrue(getsizeof(compact) < len(self.der) + 64)
+
+
+    def test_wrong_args(self):
+        """
+        L{CompactX509} raises L{TypeError} when called with the wrong number
+        or types of arguments, and L{Error} when given something which isn't
+        the encoding of a certificate or an incomplete L{X509} instance.
+        """
+        self.assertRaises(TypeError, CompactX509)
+        self.assertRaises(TypeError, CompactX509, self.der, None)
+        self.assertRaises(TypeError, CompactX509, None)
+        self.assertRaises(Error, CompactX509, b("not a certificate"))
+        self.assertRaises(Error, CompactX509, root_cert_pem)
+        self.assertRaises(Error, CompactX509, X509())
+        self.assertRaises(TypeError, CompactX509(self.der).der, None)
+        self.assertRaises(TypeError, CompactX509(self.der).to_x509, None)
+
+
+
+class KeyPoolTests(TestCase):
+    """
+    Tests for L{OpenSSL.crypto.KeyPool}.
+    """
+    def _waitFor(self, pool, predicate):
+        """
+        Wait for the stats of C{pool} to satisfy C{predicate}, failing the
+        test if they don't within a few seconds.
+        """
+        deadline = time() + 10
+        while not predicate(pool.stats()):
+            if time() > deadline:
+                self.fail("KeyPool stats %r never changed" % (pool.stats(),))
+            sleep(0.01)
+        return pool.stats()
+
+
+    def test_type(self):
+        """
+        L{KeyPool} and L{KeyPoolType} refer to the same type object.
+        """
+        self.assertIdentical(KeyPool, KeyPoolType)
+        self.assertEqual(KeyPoolType.__name__, 'KeyPool')
+        self.assertTrue(isinstance(KeyPoolType, type))
+
+
+    def test_fill(self):
+        """
+        The background threads of a L{KeyPool} generate keys until the pool
+        holds the target number, and L{KeyPool.take} returns them.
+        """
+        pool = KeyPool(TYPE_EC, 256, 4, threads=2)
+        stats = self._waitFor(pool, lambda stats: stats["size"] == 4)
+        self.assertEqual(stats["target_size"], 4)
+        self.assertEqual(stats["generated"], 4)
+        self.assertEqual(stats["misses"], 0)
+        self.assertTrue(stats["generation_time"] > 0)
+        self.assertTrue(stats["refill_rate"] > 0)
+
+        key = pool.take()
+        self.assertTrue(isinstance(key, PKeyType))
+        self.assertEqual(key.type(), TYPE_EC)
+        self.assertEqual(key.bits(), 256)
+        self._waitFor(pool, lambda stats: stats["generated"] == 5)
+        self.assertEqual(pool.stats()["size"], 4)
+        self.assertEqual(pool.stats()["taken"], 1)
+
+
+    def test_take_more(self):
+        """
+        L{KeyPool.take} generates a key on the spot when the pool is empty, so
+        more keys than the target size can be taken at once.
+        """
+        # The first key is taken long before the background thread can
+        # generate one
+        pool = KeyPool(TYPE_RSA, 1024, 1)
+        keys = [pool.take() for i in range(3)]
+        self.assertEqual([key.bits() for key in keys], [1024] * 3)
+        stats = pool.stats()
+        self.assertEqual(stats["taken"], 3)
+        self.assertTrue(stats["misses"] > 0)
+        sign(keys[0], b("data"), "sha256")
+
+
+    def test_failure(self):
+        """
+        A background thread of a L{KeyPool} stops when it can't generate a
+        key, and L{KeyPool.take} then raises L{Error}.
+        """
+        # Too small for the RSA implementation to generate
+        pool = KeyPool(TYPE_RSA, 16, 2, threads=2)
+        stats = self._waitFor(pool, lambda stats: stats["threads"] == 0)
+        self.assertEqual(stats["failures"], 2)
+        self.assertRaises(Error, pool.take)
+
+
+    def test_close(self):
+        """
+        L{KeyPool.close} stops the background threads and empties the pool,
+        after which L{KeyPool.take} raises L{ValueError}.
+        """
+        pool = KeyPool(TYPE_EC, "P-384", 3, threads=3)
+        self._waitFor(pool, lambda stats: stats["size"] == 3)
+        pool.close()
+        stats = self._waitFor(pool, lambda stats: stats["threads"] == 0)
+        self.assertEqual(stats["size"], 0)
+        self.assertRaises(ValueError, pool.take)
+        pool.close()
+
+
+    def test_wrong_args(self):
+        """
+        L{KeyPool} raises L{TypeError} or L{ValueError} for arguments which
+        L{PKeyType.generate_key} would reject, and L{ValueError} when the
+        target size or the number of threads isn't positive.
+        """
+        self.assertRaises(TypeError, KeyPool)
+        self.assertRaises(TypeError, KeyPool, TYPE_RSA, None, 1)
+        self.assertRaises(ValueError, KeyPool, TYPE_EC, 255, 1)
+        self.assertRaises(Error, KeyPool, -1, 0, 1)
+        self.assertRaises(ValueError, KeyPool, TYPE_ED25519, None, 0)
+        self.assertRaises(ValueError, KeyPool, TYPE_ED25519, None, 1, 0)
+
+
+
+class DSAParametersTests(TestCase):
+    """
+    Tests for L{OpenSSL.crypto.DSAParameters}, L{load_dsa_params} and
+    L{dump_dsa_params}.
+    """
+    def _prime(self, text):
+        """
+        Return the hex digits of the prime P from the text dump of DSA
+        parameters or of a DSA key.
+        """
+        lines = text.splitlines()
+        start = [i for i, line in enumerate(lines)
+                 if line.strip() == b("prime P:")][0] + 1
+        digits = []
+        for line in lines[start:]:
+            if not line.startswith(b(" ")) or line.strip().endswith(b(":")):
+                break
+            digits.append(line.strip())
+        return b("").join(digits)
+
+
+    def test_type(self):
+        """
+        L{DSAParameters} and L{DSAParametersType} refer to the same type
+        object.
+        """
+        self.assertIdentical(DSAParameters, DSAParametersType)
+        self.assertEqual(DSAParametersType.__name__, 'DSAParameters')
+        self.assertTrue(isinstance(DSAParametersType, type))
+
+
+    def test_generate(self):
+        """
+        L{DSAParameters} generates parameters of the requested size.
+        """
+        params = DSAParameters(1024)
+        self.assertEqual(params.bits(), 1024)
+
+
+    def test_generate_key(self):
+        """
+        L{PKey.generate_key} given L{DSAParameters} instead of a number of bits
+        generates distinct DSA keys sharing those parameters.
+        """
+        params = DSAParameters(1024)
+        prime = self._prime(dump_dsa_params(FILETYPE_TEXT, params))
+        keys = [PKey(), PKey()]
+        for key in keys:
+            key.generate_key(TYPE_DSA, params)
+            self.assertEqual(key.type(), TYPE_DSA)
+            self.assertEqual(key.bits(), 1024)
+            self.assertEqual(
+                self._prime(dump_privatekey(FILETYPE_TEXT, key)), prime)
+        self.assertNotEqual(dump_privatekey(FILETYPE_PEM, keys[0]),
+                            dump_privatekey(FILETYPE_PEM, keys[1]))
+
+
+    def test_generate_many(self):
+        """
+        L{generate_keys} and L{KeyPool} accept L{DSAParameters} instead of a
+        number of bits.
+        """
+        params = DSAParameters(1024)
+        prime = self._prime(dump_dsa_params(FILETYPE_TEXT, params))
+        keys = generate_keys(TYPE_DSA, params, 4, threads=2)
+        pool = KeyPool(TYPE_DSA, params, 2)
+        keys.append(pool.take())
+        pool.close()
+        for key in keys:
+            self.assertEqual(
+                self._prime(dump_privatekey(FILETYPE_TEXT, key)), prime)
+
+
+    def test_load_dump(self):
+        """
+        L{dump_dsa_params} dumps parameters which L{load_dsa_params} loads
+        back, in PEM or ASN1 form.
+        """
+        params = DSAParameters(1024)
+        pem = dump_dsa_params(FILETYPE_PEM, params)
+        self.assertTrue(pem.startswith(b("-----BEGIN DSA PARAMETERS-----")))
+        der = dump_dsa_params(FILETYPE_ASN1, params)
+        for filetype, dumped in [(FILETYPE_PEM, pem), (FILETYPE_ASN1, der)]:
+            loaded = load_dsa_params(filetype, dumped)
+            self.assertTrue(isinstance(loaded, DSAParametersType))
+            self.assertEqual(loaded.bits(), 1024)
+            self.assertEqual(dump_dsa_params(FILETYPE_PEM, loaded), pem)
+
+
+    def test_wrong_args(self):
+        """
+        L{DSAParameters}, L{load_dsa_params} and L{dump_dsa_params} raise
+        L{TypeError} for wrong arguments, L{ValueError} for an unknown file
+        type and L{OpenSSL.crypto.Error} for bad parameters, as does
+        L{PKey.generate_key} given L{DSAParameters} for an RSA key.
+        """
+        self.assertRaises(TypeError, DSAParameters)
+        self.assertRaises(TypeError, DSAParameters, "1024")
+        self.assertRaises(Error, DSAParameters, -1)
+        params = DSAParameters(1024)
+        self.assertRaises(TypeError, params.bits, None)
+        self.assertRaises(TypeError, dump_dsa_params, FILETYPE_PEM, None)
+        self.assertRaises(ValueError, dump_dsa_params, 100, params)
+        self.assertRaises(TypeError, load_dsa_params, FILETYPE_PEM, None)
+        self.assertRaises(
+            ValueError, load_dsa_params, FILETYPE_TEXT, b("params"))
+        self.assertRaises(Error, load_dsa_params, FILETYPE_PEM, b("params"))
+        self.assertRaises(Error, load_dsa_params, FILETYPE_ASN1, b("params"))
+        self.assertRaises(TypeError, PKey().generate_key, TYPE_RSA, params)
+
+
+
+class X509StoreTests(TestCase):
+    """
+    Tests for L{OpenSSL.crypto.X509Store}.
+    """
+    def setUp(self):
+        self.root = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.server = load_certificate(FILETYPE_PEM, server_cert_pem)
+
+
+    def test_type(self):
+        """
+        L{X509Store} and L{X509StoreType} refer to the same type object and
+        can be used to create instances.
+        """
+        self.assertIdentical(X509Store, X509StoreType)
+        self.assertConsistentType(X509Store, 'X509Store')
+
+
+    def test_construction_wrong_args(self):
+        """
+        L{X509Store} raises L{TypeError} if called with arguments.
+        """
+        self.assertRaises(TypeError, X509Store, None)
+
+
+    def test_verify_untrusted(self):
+        """
+        L{X509Store.verify} reports an error code and the partial chain if
+        the issuer of the certificate is not trusted.
+        """
+        store = X509Store()
+        result, chain = store.verify(self.server)
+        self.assertNotEqual(result, X509_V_OK)
+        self.assertEqual(len(chain), 1)
+
+
+    def test_verify(self):
+        """
+        L{X509Store.verify} returns L{X509_V_OK} and the chain it built when
+        the certificate is issued by a trusted certificate in the store.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        store.set_flags(X509_V_FLAG_NO_CHECK_TIME)
+        result, chain = store.verify(self.server)
+        self.assertEqual(result, X509_V_OK)
+        self.assertEqual(
+            [dump_certificate(FILETYPE_ASN1, cert) for cert in chain],
+            [dump_certificate(FILETYPE_ASN1, self.server),
+             dump_certificate(FILETYPE_ASN1, self.root)])
+
+
+    def test_verify_chain_copies(self):
+        """
+        The certificates in the chain returned by L{X509Store.verify} are
+        copies, so changing them doesn't change the certificates passed in
+        behind the back of their cached fields and hash, and the other way
+        around.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        store.set_flags(X509_V_FLAG_NO_CHECK_TIME)
+        result, chain = store.verify(self.server)
+        der = dump_certificate(FILETYPE_ASN1, self.server)
+        subject = self.server.get_subject()
+        self.assertEqual(chain[0], self.server)
+
+        chain[0].set_subject(chain[0].get_issuer())
+        chain[0].sign(load_privatekey(FILETYPE_PEM, server_key_pem), 'sha256')
+        self.assertEqual(dump_certificate(FILETYPE_ASN1, self.server), der)
+        self.assertEqual(self.server.get_subject(), subject)
+        self.assertNotEqual(chain[0], self.server)
+
+        self.root.set_subject(subject)
+        self.assertNotEqual(chain[1].get_subject(), subject)
+
+
+    def test_verify_reuse(self):
+        """
+        An L{X509Store} can be used to verify any number of certificates.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        store.set_flags(X509_V_FLAG_NO_CHECK_TIME)
+        client = load_certificate(FILETYPE_PEM, client_cert_pem)
+        for i in range(3):
+            self.assertEqual(store.verify(self.server)[0], X509_V_OK)
+            self.assertEqual(store.verify(client)[0], X509_V_OK)
+
+
+    def test_verify_expired(self):
+        """
+        Without L{X509_V_FLAG_NO_CHECK_TIME}, L{X509Store.verify} reports the
+        expired test certificates with an error code instead of raising.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        result, chain = store.verify(self.server)
+        self.assertNotEqual(result, X509_V_OK)
+        self.assertEqual(len(chain), 2)
+
+
+    def test_verify_wrong_args(self):
+        """
+        L{X509Store.verify} raises L{TypeError} if not passed an L{X509} and
+        an optional sequence of L{X509}.
+        """
+        store = X509Store()
+        self.assertRaises(TypeError, store.verify)
+        self.assertRaises(TypeError, store.verify, None)
+        self.assertRaises(TypeError, store.verify, self.server, [None])
+        self.assertRaises(TypeError, store.verify, self.server, 1)
+
+
+    def test_load_locations(self):
+        """
+        L{X509Store.load_locations} loads trusted certificates from a PEM
+        file.
+        """
+        cafile = self.mktemp()
+        fObj = open(cafile, 'wb')
+        fObj.write(root_cert_pem)
+        fObj.close()
+        try:
+            store = X509Store()
+            store.load_locations(cafile)
+        finally:
+            os.remove(cafile)
+        store.set_flags(X509_V_FLAG_NO_CHECK_TIME)
+        self.assertEqual(store.verify(self.server)[0], X509_V_OK)
+
+
+    def test_load_locations_missing(self):
+        """
+        L{X509Store.load_locations} raises L{Error} if the file cannot be
+        loaded and L{ValueError} if given neither a file nor a directory.
+        """
+        store = X509Store()
+        self.assertRaises(Error, store.load_locations, self.mktemp())
+        self.assertRaises(ValueError, store.load_locations, None, None)
+
+
+    def test_set_depth(self):
+        """
+        L{X509Store.set_depth} accepts an integer and rejects anything else.
+        """
+        store = X509Store()
+        store.set_depth(3)
+        self.assertRaises(TypeError, store.set_depth, "3")
+
+
+    def test_verify_many(self):
+        """
+        L{verify_many} returns the verification result of every certificate,
+        in order, whatever the number of threads used.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        client = load_certificate(FILETYPE_PEM, client_cert_pem)
+        certs = [self.server, client, self.root] * 20
+        for flags in (0, X509_V_FLAG_NO_CHECK_TIME):
+            store.set_flags(flags)
+            expected = [store.verify(cert)[0] for cert in certs]
+            self.assertEqual(expected[0] == X509_V_OK, bool(flags))
+            for threads in (0, 1, 4, 100):
+                self.assertEqual(
+                    verify_many(store, certs, threads=threads), expected)
+
+
+    def test_verify_many_chain(self):
+        """
+        L{verify_many} uses the untrusted certificates passed as C{chain} to
+        build the chains.
+        """
+        store = X509Store()
+        store.add_cert(self.root)
+        store.set_flags(X509_V_FLAG_NO_CHECK_TIME)
+        self.assertEqual(verify_many(store, [self.root], chain=[self.server]),
+                         [X509_V_OK])
+
+
+    def test_verify_many_empty(self):
+        """
+        L{verify_many} returns an empty list when given no certificates.
+        """
+        self.assertEqual(verify_many(X509Store(), []), [])
+
+
+    def test_verify_many_wrong_args(self):
+        """
+        L{verify_many} raises L{TypeError} if not passed an L{X509Store} and a
+        sequence of L{X509} instances.
+        """
+        store = X509Store()
+        self.assertRaises(TypeError, verify_many)
+        self.assertRaises(TypeError, verify_many, store)
+        self.assertRaises(TypeError, verify_many, None, [self.server])
+        self.assertRaises(TypeError, verify_many, store, None)
+        self.assertRaises(TypeError, verify_many, store, [self.server, None])
+        self.assertRaises(TypeError, verify_many, store, [], chain=[None])
+
+
+
+class PKCS12Tests(TestCase):
+    """
+    Test for L{OpenSSL.crypto.PKCS12} and L{OpenSSL.crypto.load_pkcs12}.
+    """
+    pemData = cleartextCertificatePEM + cleartextPrivateKeyPEM
+
+    def test_type(self):
+        """
+        L{PKCS12Type} is a type object.
+        """
+        self.assertIdentical(PKCS12, PKCS12Type)
+        self.assertConsistentType(PKCS12, 'PKCS12')
+
+
+    def test_empty_construction(self):
+        """
+        L{PKCS12} returns a new instance of L{PKCS12} with no certificate,
+        private key, CA certificates, or friendly name.
+        """
+        p12 = PKCS12()
+        self.assertEqual(None, p12.get_certificate())
+        self.assertEqual(None, p12.get_privatekey())
+        self.assertEqual(None, p12.get_ca_certificates())
+        self.assertEqual(None, p12.get_friendlyname())
+
+
+    def test_type_errors(self):
+        """
+        The L{PKCS12} setter functions (C{set_certificate}, C{set_privatekey},
+        C{set_ca_certificates}, and C{set_friendlyname}) raise L{TypeError}
+        when passed objects of types other than those expected.
+        """
+        p12 = PKCS12()
+        self.assertRaises(TypeError, p12.set_certificate, 3)
+        self.assertRaises(TypeError, p12.set_certificate, PKey())
+        self.assertRaises(TypeError, p12.set_certificate, X509)
+        self.assertRaises(TypeError, p12.set_privatekey, 3)
+        self.assertRaises(TypeError, p12.set_privatekey, 'legbone')
+        self.assertRaises(TypeError, p12.set_privatekey, X509())
+        self.assertRaises(TypeError, p12.set_ca_certificates, 3)
+        self.assertRaises(TypeError, p12.set_ca_certificates, X509())
+        self.assertRaises(TypeError, p12.set_ca_certificates, (3, 4))
+        self.assertRaises(TypeError, p12.set_ca_certificates, ( PKey(), ))
+        self.assertRaises(TypeError, p12.set_friendlyname, 6)
+        self.assertRaises(TypeError, p12.set_friendlyname, ('foo', 'bar'))
+
+
+    def test_key_only(self):
+        """
+        A L{PKCS12} with only a private key can be exported using
+        L{PKCS12.export} and loaded again using L{load_pkcs12}.
+        """
+        passwd = 'blah'
+        p12 = PKCS12()
+        pkey = load_privatekey(FILETYPE_PEM, cleartextPrivateKeyPEM)
+        p12.set_privatekey(pkey)
+        self.assertEqual(None, p12.get_certificate())
+        self.assertEqual(pkey, p12.get_privatekey())
+        try:
+            dumped_p12 = p12.export(passphrase=passwd, iter=2, maciter=3)
+        except Error:
+            # Some versions of OpenSSL will throw an exception
+            # for this nearly useless PKCS12 we tried to generate:
+            # [('PKCS12 routines', 'PKCS12_create', 'invalid null argument')]
+            return
+        p12 = load_pkcs12(dumped_p12, passwd)
+        self.assertEqual(None, p12.get_ca_certificates())
+        self.assertEqual(None, p12.get_certificate())
+
+        # OpenSSL fails to bring the key back to us.  So sad.  Perhaps in the
+        # future this will be improved.
+        self.assertTrue(isinstance(p12.get_privatekey(), (PKey, type(None))))
+
+
+    def test_cert_only(self):
+        """
+        A L{PKCS12} with only a certificate can be exported using
+        L{PKCS12.export} and loaded again using L{load_pkcs12}.
+        """
+        passwd = 'blah'
+        p12 = PKCS12()
+        cert = load_certificate(FILETYPE_PEM, cleartextCertificatePEM)
+        p12.set_certificate(cert)
+        self.assertEqual(cert, p12.get_certificate())
+        self.assertEqual(None, p12.get_privatekey())
+        try:
+            dumped_p12 = p12.export(passphrase=passwd, iter=2, maciter=3)
+        except Error:
+            # Some versions of OpenSSL will throw an exception
+            # for this nearly useless PKCS12 we tried to generate:
             # [('PKCS12 routines', 'PKCS12_create', 'invalid null argument')]
             return
         p12 = load_pkcs12(dumped_p12, passwd)
@@ -1877,6 +3038,25 @@ class PKCS12Tests(TestCase):
         self.assertRaises(Error, p12.export)
 
 
+    def test_export_into(self):
+        """
+        L{PKCS12.export_into} writes the PKCS12 into a writable buffer and
+        returns its size, which it also returns when passed C{None} instead
+        of a buffer.
+        """
+        p12 = self.gen_pkcs12(server_cert_pem, server_key_pem, root_cert_pem)
+        size = p12.export_into(None, passphrase=b("foo"))
+        self.assertEqual(size, len(p12.export(passphrase=b("foo"))))
+        buffer = bytearray(size + 10)
+        self.assertEqual(p12.export_into(buffer, b("foo")), size)
+        recovered = load_pkcs12(buffer[:size], b("foo"))
+        self.assertEqual(
+            dump_certificate(FILETYPE_PEM, recovered.get_certificate()),
+            server_cert_pem)
+        self.assertRaises(ValueError, p12.export_into, bytearray(size - 1))
+        self.assertRaises(BufferError, p12.export_into, b("x") * size)
+
+
 
 # These quoting functions taken directly from Twisted's twisted.python.win32.
 _cmdLineQuoteRe = re.compile(r'(\\*)"')
@@ -2015,6 +3195,32 @@ class FunctionTests(TestCase):
         self.assertEqual(called, [False])
 
 
+    def test_load_privatekey_passphraseCallbackThreads(self):
+        """
+        L{load_privatekey} releases the GIL while decrypting and reacquires it
+        to run the passphrase callback, so it can be used from several threads
+        at once.
+        """
+        called = []
+        results = []
+        def cb(writing):
+            called.append(writing)
+            return encryptedPrivateKeyPEMPassphrase
+        def load():
+            for i in range(10):
+                results.append(
+                    load_privatekey(FILETYPE_PEM, encryptedPrivateKeyPEM, cb))
+        threads = [Thread(target=load) for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(len(called), 40)
+        self.assertEqual(len(results), 40)
+        for key in results:
+            self.assertTrue(isinstance(key, PKeyType))
+
+
     def test_load_privatekey_passphrase_exception(self):
         """
         An exception raised by the passphrase callback passed to
@@ -2106,6 +3312,168 @@ class FunctionTests(TestCase):
         self.assertEqual(dumped_text, good_text)
 
 
+    def _bundle(self):
+        """
+        Return the DER encodings of the test certificates and a PEM bundle of
+        them, with a private key between two of them.
+        """
+        ders = [dump_certificate(FILETYPE_ASN1, load_certificate(FILETYPE_PEM, pem))
+                for pem in [root_cert_pem, server_cert_pem, client_cert_pem]]
+        bundle = root_cert_pem + server_key_pem + server_cert_pem + client_cert_pem
+        return ders, bundle
+
+
+    def test_load_certificates(self):
+        """
+        L{load_certificates} returns all the certificates in a PEM or DER
+        buffer, in order, skipping any other PEM block.
+        """
+        ders, bundle = self._bundle()
+        for type, data in [(FILETYPE_PEM, bundle), (FILETYPE_ASN1, b("").join(ders))]:
+            certs = load_certificates(type, data)
+            self.assertEqual(
+                [dump_certificate(FILETYPE_ASN1, cert) for cert in certs], ders)
+
+
+    def test_load_certificates_buffers(self):
+        """
+        L{load_certificates} accepts any object supporting the buffer protocol.
+        """
+        ders, bundle = self._bundle()
+        for data in [bytearray(bundle), memoryview(bundle)]:
+            self.assertEqual(len(load_certificates(FILETYPE_PEM, data)), 3)
+
+
+    def test_load_certificates_empty(self):
+        """
+        L{load_certificates} returns an empty list for a buffer without any
+        certificate.
+        """
+        self.assertEqual(load_certificates(FILETYPE_PEM, b("")), [])
+        self.assertEqual(load_certificates(FILETYPE_PEM, server_key_pem), [])
+        self.assertEqual(load_certificates(FILETYPE_ASN1, b("")), [])
+
+
+    def test_load_certificates_invalid(self):
+        """
+        L{load_certificates} raises L{Error} if a certificate can't be parsed
+        and L{ValueError} for an unsupported file type.
+        """
+        ders, bundle = self._bundle()
+        self.assertRaises(Error, load_certificates, FILETYPE_ASN1,
+                          ders[0] + b("garbage"))
+        self.assertRaises(Error, load_certificates, FILETYPE_PEM,
+                          bundle.replace(b("MII"), b("!!!")))
+        self.assertRaises(ValueError, load_certificates, FILETYPE_TEXT, bundle)
+        self.assertRaises(TypeError, load_certificates, FILETYPE_PEM, object())
+
+
+    def test_iter_certificates(self):
+        """
+        L{iter_certificates} returns an iterator over all the certificates in
+        a PEM or DER buffer, in order.
+        """
+        ders, bundle = self._bundle()
+        for type, data in [(FILETYPE_PEM, bytearray(bundle)),
+                           (FILETYPE_ASN1, b("").join(ders))]:
+            certs = iter_certificates(type, data)
+            self.assertIdentical(iter(certs), certs)
+            self.assertEqual(
+                [dump_certificate(FILETYPE_ASN1, cert) for cert in certs], ders)
+            self.assertEqual(list(certs), [])
+
+
+    def test_iter_certificates_invalid(self):
+        """
+        The iterator returned by L{iter_certificates} yields the certificates
+        before a corrupted one, then raises L{Error} and stops.
+        """
+        ders, bundle = self._bundle()
+        certs = iter_certificates(FILETYPE_ASN1, ders[0] + b("garbage"))
+        self.assertEqual(dump_certificate(FILETYPE_ASN1, next(certs)), ders[0])
+        self.assertRaises(Error, next, certs)
+        self.assertEqual(list(certs), [])
+        self.assertRaises(ValueError, iter_certificates, FILETYPE_TEXT, bundle)
+
+
+    def test_dump_certificate_into(self):
+        """
+        L{dump_certificate_into} writes exactly what L{dump_certificate}
+        returns into a writable buffer and returns its size.  Given C{None}
+        instead of a buffer, it returns the size needed.
+        """
+        cert = load_certificate(FILETYPE_PEM, cleartextCertificatePEM)
+        for type in [FILETYPE_PEM, FILETYPE_ASN1, FILETYPE_TEXT]:
+            dumped = dump_certificate(type, cert)
+            self.assertEqual(dump_certificate_into(type, cert, None), len(dumped))
+            buffer = bytearray(len(dumped) + 5)
+            self.assertEqual(
+                dump_certificate_into(type, cert, buffer), len(dumped))
+            self.assertEqual(bytes(buffer[:len(dumped)]), dumped)
+            view = memoryview(buffer)[5:]
+            self.assertEqual(
+                dump_certificate_into(type, cert, view), len(dumped))
+            self.assertEqual(bytes(buffer[5:]), dumped)
+
+
+    def test_dump_certificate_into_invalid(self):
+        """
+        L{dump_certificate_into} raises L{ValueError} if the buffer is too
+        small or the type is unknown, and L{BufferError} if the buffer is not
+        writable.
+        """
+        cert = load_certificate(FILETYPE_PEM, cleartextCertificatePEM)
+        size = dump_certificate_into(FILETYPE_ASN1, cert, None)
+        self.assertRaises(ValueError, dump_certificate_into, FILETYPE_ASN1,
+                          cert, bytearray(size - 1))
+        self.assertRaises(ValueError, dump_certificate_into, 100, cert,
+                          bytearray(size))
+        self.assertRaises(BufferError, dump_certificate_into, FILETYPE_ASN1,
+                          cert, b("x") * size)
+        self.assertRaises(TypeError, dump_certificate_into, FILETYPE_ASN1,
+                          None, bytearray(size))
+
+
+    def test_dump_certificate_request_into(self):
+        """
+        L{dump_certificate_request_into} writes exactly what
+        L{dump_certificate_request} returns into a writable buffer and
+        returns its size.
+        """
+        req = load_certificate_request(FILETYPE_PEM, cleartextCertificateRequestPEM)
+        for type in [FILETYPE_PEM, FILETYPE_ASN1, FILETYPE_TEXT]:
+            dumped = dump_certificate_request(type, req)
+            size = dump_certificate_request_into(type, req, None)
+            self.assertEqual(size, len(dumped))
+            buffer = bytearray(size)
+            self.assertEqual(dump_certificate_request_into(type, req, buffer), size)
+            self.assertEqual(bytes(buffer), dumped)
+
+
+    def test_dump_privatekey_into(self):
+        """
+        L{dump_privatekey_into} writes a private key into a writable buffer,
+        encrypted if a cipher and passphrase are given, and returns its size.
+        """
+        key = load_privatekey(FILETYPE_PEM, cleartextPrivateKeyPEM)
+        dumped = dump_privatekey(FILETYPE_ASN1, key)
+        buffer = bytearray(len(dumped))
+        self.assertEqual(
+            dump_privatekey_into(FILETYPE_ASN1, key, buffer), len(dumped))
+        self.assertEqual(bytes(buffer), dumped)
+
+        passphrase = b("foo")
+        size = dump_privatekey_into(FILETYPE_PEM, key, None, "des3", passphrase)
+        buffer = bytearray(size)
+        self.assertEqual(
+            dump_privatekey_into(FILETYPE_PEM, key, buffer, "des3", passphrase),
+            size)
+        loaded = load_privatekey(FILETYPE_PEM, buffer, passphrase)
+        self.assertEqual(dump_privatekey(FILETYPE_ASN1, loaded), dumped)
+        self.assertRaises(ValueError, dump_privatekey_into, FILETYPE_PEM, key,
+                          buffer, "des3")
+
+
     def test_dump_privatekey(self):
         """
         L{dump_privatekey} writes a PEM, DER, and text.
@@ -2173,6 +3541,318 @@ class FunctionTests(TestCase):
         self.assertTrue(isinstance(pkcs7, PKCS7Type))
 
 
+    def test_load_buffer_protocol(self):
+        """
+        The I{load_*} functions accept any object supporting the buffer
+        protocol, not just strings.
+        """
+        cert = load_certificate(FILETYPE_PEM, cleartextCertificatePEM)
+        p12 = PKCS12()
+        p12.set_certificate(cert)
+        p12Data = p12.export()
+        for wrap in [bytearray, memoryview]:
+            self.assertTrue(isinstance(
+                    load_certificate(FILETYPE_PEM, wrap(cleartextCertificatePEM)),
+                    X509Type))
+            self.assertTrue(isinstance(
+                    load_privatekey(FILETYPE_PEM, wrap(cleartextPrivateKeyPEM)),
+                    PKeyType))
+            self.assertTrue(isinstance(
+                    load_certificate_request(
+                        FILETYPE_PEM, wrap(cleartextCertificateRequestPEM)),
+                    X509ReqType))
+            self.assertTrue(isinstance(
+                    load_crl(FILETYPE_PEM, wrap(crlData)), CRL))
+            self.assertTrue(isinstance(
+                    load_pkcs7_data(FILETYPE_PEM, wrap(pkcs7Data)), PKCS7Type))
+            self.assertTrue(isinstance(load_pkcs12(wrap(p12Data)), PKCS12))
+
+
+    def test_load_mmap(self):
+        """
+        The I{load_*} functions can parse an C{mmap} of a file in place.
+        """
+        path = self.mktemp()
+        fObj = open(path, 'wb')
+        fObj.write(crlData)
+        fObj.close()
+        fObj = open(path, 'rb')
+        try:
+            data = mmap(fObj.fileno(), 0, access=ACCESS_READ)
+            try:
+                crl = load_crl(FILETYPE_PEM, data)
+                self.assertEqual(len(crl.get_revoked()), 2)
+            finally:
+                data.close()
+        finally:
+            fObj.close()
+            os.remove(path)
+
+
+    def test_certificate_cache(self):
+        """
+        With the certificate cache enabled, L{load_certificate} returns
+        certificates sharing the parsed certificate for data it has already
+        loaded, and counts hits and misses.
+        """
+        set_certificate_cache_size(10)
+        try:
+            info = get_certificate_cache_info()
+            self.assertEqual(info["size"], 0)
+            self.assertEqual(info["max_size"], 10)
+            hits, misses = info["hits"], info["misses"]
+
+            first = load_certificate(FILETYPE_PEM, root_cert_pem)
+            second = load_certificate(FILETYPE_PEM, bytearray(root_cert_pem))
+            der = dump_certificate(FILETYPE_ASN1, first)
+            third = load_certificate(FILETYPE_ASN1, der)
+            self.assertEqual(first, second)
+            self.assertEqual(first, third)
+            self.assertEqual(second.get_subject(), first.get_subject())
+
+            info = get_certificate_cache_info()
+            self.assertEqual(info["hits"], hits + 1)
+            self.assertEqual(info["misses"], misses + 2)
+            self.assertEqual(info["size"], 2)
+
+            # Cached certificates outlive the cache
+            set_certificate_cache_size(0)
+            self.assertEqual(get_certificate_cache_info()["size"], 0)
+            self.assertEqual(dump_certificate(FILETYPE_ASN1, second), der)
+        finally:
+            set_certificate_cache_size(0)
+
+
+    def test_certificate_cache_lru(self):
+        """
+        The certificate cache evicts the least recently used certificate
+        when it is full.
+        """
+        set_certificate_cache_size(2)
+        try:
+            load_certificate(FILETYPE_PEM, root_cert_pem)
+            load_certificate(FILETYPE_PEM, server_cert_pem)
+            load_certificate(FILETYPE_PEM, root_cert_pem)
+            load_certificate(FILETYPE_PEM, client_cert_pem)
+            info = get_certificate_cache_info()
+            self.assertEqual(info["size"], 2)
+
+            # The server certificate was evicted, the root one was not
+            hits, misses = info["hits"], info["misses"]
+            load_certificate(FILETYPE_PEM, root_cert_pem)
+            load_certificate(FILETYPE_PEM, server_cert_pem)
+            info = get_certificate_cache_info()
+            self.assertEqual(info["hits"], hits + 1)
+            self.assertEqual(info["misses"], misses + 1)
+        finally:
+            set_certificate_cache_size(0)
+
+
+    def test_certificate_cache_readonly(self):
+        """
+        Certificates loaded through the certificate cache can't be modified,
+        the others still can.
+        """
+        pkey = load_privatekey(FILETYPE_PEM, root_key_pem)
+        set_certificate_cache_size(1)
+        try:
+            cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+            self.assertRaises(TypeError, cert.set_serial_number, 1)
+            self.assertRaises(TypeError, cert.set_version, 1)
+            self.assertRaises(TypeError, cert.sign, pkey, "sha256")
+            self.assertRaises(
+                TypeError, cert.set_notAfter, b("20200101000000Z"))
+            self.assertRaises(TypeError, cert.gmtime_adj_notBefore, 0)
+            self.assertRaises(
+                TypeError, setattr, cert.get_subject(), "commonName", "x")
+            self.assertEqual(
+                cert.get_subject().commonName, "Testing Root CA")
+        finally:
+            set_certificate_cache_size(0)
+
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        cert.set_serial_number(1)
+        self.assertEqual(cert.get_serial_number(), 1)
+
+
+    def test_certificate_cache_resize_threads(self):
+        """
+        The certificate cache can be disabled or resized while other threads
+        load certificates through it, and certificates loaded once it is
+        disabled can be modified.
+        """
+        pems = [root_cert_pem, server_cert_pem, client_cert_pem,
+                cleartextCertificatePEM, multipleOUCertificatePEM]
+        results = []
+        done = []
+        def load():
+            while not done:
+                for pem in pems:
+                    results.append(load_certificate(FILETYPE_PEM, pem))
+        threads = [Thread(target=load) for i in range(4)]
+        try:
+            for t in threads:
+                t.start()
+            # Long enough for the loading threads to be caught mid-decode
+            deadline = time() + 1
+            while time() < deadline:
+                set_certificate_cache_size(3)
+                set_certificate_cache_size(0)
+        finally:
+            done.append(True)
+            for t in threads:
+                t.join()
+            set_certificate_cache_size(0)
+
+        self.assertEqual(len(results) % len(pems), 0)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        cert.set_serial_number(1)
+        self.assertEqual(cert.get_serial_number(), 1)
+        info = get_certificate_cache_info()
+        self.assertEqual((info["size"], info["max_size"]), (0, 0))
+
+
+    def test_certificate_cache_wrong_args(self):
+        """
+        L{set_certificate_cache_size} raises L{TypeError} for anything but
+        an integer and L{ValueError} for a negative size.
+        L{get_certificate_cache_info} takes no arguments.
+        """
+        self.assertRaises(TypeError, set_certificate_cache_size)
+        self.assertRaises(TypeError, set_certificate_cache_size, "10")
+        self.assertRaises(ValueError, set_certificate_cache_size, -1)
+        self.assertRaises(TypeError, get_certificate_cache_info, None)
+
+
+    def test_extract_fields(self):
+        """
+        L{extract_fields} returns a dict with a list of the values of each
+        requested field, in the order of the certificates, which are the same
+        values the methods of L{X509} return.
+        """
+        root = load_certificate(FILETYPE_PEM, root_cert_pem)
+        server = load_certificate(FILETYPE_PEM, server_cert_pem)
+        certs = [root, server, root] * 10
+        fields = ["subject", "issuer", "subject_cn", "issuer_cn",
+                  "serial_number", "not_before", "not_after", "key_type",
+                  "key_bits", "signature_algorithm", "subject_alt_name",
+                  "version", "subject_name_hash"]
+        columns = extract_fields(certs, fields, threads=4)
+        self.assertEqual(sorted(columns.keys()), sorted(fields))
+        for i, cert in enumerate(certs):
+            self.assertEqual(
+                columns["subject"][i], cert.get_subject().get_oneline())
+            self.assertEqual(
+                columns["issuer"][i], cert.get_issuer().get_oneline())
+            self.assertEqual(
+                columns["subject_cn"][i], cert.get_subject().commonName)
+            self.assertEqual(
+                columns["issuer_cn"][i], cert.get_issuer().commonName)
+            self.assertEqual(
+                columns["serial_number"][i], cert.get_serial_number())
+            self.assertEqual(columns["not_before"][i], cert.get_notBefore())
+            self.assertEqual(columns["not_after"][i], cert.get_notAfter())
+            self.assertEqual(columns["key_type"][i], cert.get_pubkey().type())
+            self.assertEqual(columns["key_bits"][i], cert.get_pubkey().bits())
+            self.assertEqual(columns["signature_algorithm"][i],
+                             cert.get_signature_algorithm())
+            self.assertEqual(columns["subject_alt_name"][i],
+                             cert.get_subject_alt_name())
+            self.assertEqual(columns["version"][i], cert.get_version())
+            self.assertEqual(columns["subject_name_hash"][i],
+                             cert.subject_name_hash())
+        self.assertEqual(extract_fields([], fields), dict.fromkeys(fields, []))
+        self.assertEqual(extract_fields(certs, []), {})
+
+
+    def test_extract_fields_missing(self):
+        """
+        L{extract_fields} accepts L{CompactX509} instances, and gives C{None}
+        for the fields a certificate doesn't have.
+        """
+        cert = X509()
+        cert.add_extensions([X509Extension(
+                    b('subjectAltName'), False, b('DNS:example.com'))])
+        compact = CompactX509(load_certificate(FILETYPE_PEM, server_cert_pem))
+        columns = extract_fields(
+            [cert, compact], ["subject_cn", "not_after", "key_type",
+                              "subject_alt_name"])
+        self.assertEqual(columns["subject_cn"], [None, u"lovely server"])
+        self.assertEqual(
+            columns["not_after"], [None, compact.get_notAfter()])
+        self.assertEqual(columns["key_type"], [None, TYPE_RSA])
+        self.assertEqual(
+            columns["subject_alt_name"], [[(2, b('example.com'))], None])
+
+
+    def test_extract_fields_modified(self):
+        """
+        L{extract_fields} reads names which were changed since the certificate
+        was loaded, and the certificate can be changed again afterwards.
+        """
+        cert = load_certificate(FILETYPE_PEM, server_cert_pem)
+        cert.get_subject().commonName = "changed"
+        columns = extract_fields(
+            [cert, cert], ["subject", "subject_name_hash"], threads=2)
+        self.assertEqual(columns["subject"],
+                         [cert.get_subject().get_oneline()] * 2)
+        self.assertEqual(columns["subject_name_hash"],
+                         [cert.subject_name_hash()] * 2)
+        cert.set_serial_number(1)
+        self.assertEqual(cert.get_serial_number(), 1)
+
+
+    def test_extract_fields_threads(self):
+        """
+        X509 objects can't be modified while L{extract_fields} reads them in
+        another thread, which raises L{RuntimeError}.
+        """
+        cert = load_certificate(FILETYPE_PEM, server_cert_pem)
+        names = [load_certificate(FILETYPE_PEM, pem).get_subject()
+                 for pem in [root_cert_pem, server_cert_pem]]
+        results = []
+        refused = []
+        done = []
+        def extract():
+            while not done:
+                results.append(
+                    extract_fields([cert] * 100, ["subject"], threads=2))
+        thread = Thread(target=extract)
+        try:
+            thread.start()
+            deadline = time() + 1
+            while time() < deadline:
+                for name in names:
+                    try:
+                        cert.set_subject(name)
+                    except RuntimeError:
+                        refused.append(name)
+        finally:
+            done.append(True)
+            thread.join()
+
+        self.assertTrue(refused)
+        for columns in results:
+            self.assertEqual(len(set(columns["subject"])), 1)
+        cert.set_subject(names[0])
+        self.assertEqual(cert.get_subject(), names[0])
+
+
+    def test_extract_fields_wrong_args(self):
+        """
+        L{extract_fields} raises L{TypeError} if called with the wrong number
+        or types of arguments and L{ValueError} for an unknown field name.
+        """
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.assertRaises(TypeError, extract_fields)
+        self.assertRaises(TypeError, extract_fields, [cert])
+        self.assertRaises(TypeError, extract_fields, None, ["subject"])
+        self.assertRaises(TypeError, extract_fields, [cert, None], ["subject"])
+        self.assertRaises(TypeError, extract_fields, [cert], None)
+        self.assertRaises(TypeError, extract_fields, [cert], [None])
+        self.assertRaises(ValueError, extract_fields, [cert], ["unknown"])
+
+
 
 class PKCS7Tests(TestCase):
     """
@@ -2447,6 +4127,31 @@ class RevokedTests(TestCase):
         self.assertRaises(TypeError, revoked.get_reason, "foo")
 
 
+    def test_hash_equality(self):
+        """
+        L{Revoked} instances are equal and hash the same when their DER
+        encodings are the same, which changes when they are modified.
+        """
+        first = Revoked()
+        second = Revoked()
+        for revoked in [first, second]:
+            revoked.set_serial(b("3ab"))
+            revoked.set_rev_date(b("20100101000000Z"))
+        self.assertEqual(first, second)
+        self.assertEqual(hash(first), hash(second))
+        self.assertEqual(len(set([first, second])), 1)
+
+        second.set_reason(b("keyCompromise"))
+        self.assertNotEqual(first, second)
+        first.set_reason(b("keyCompromise"))
+        self.assertEqual(first, second)
+        self.assertEqual(hash(first), hash(second))
+        second.set_serial(b("3ac"))
+        self.assertNotEqual(first, second)
+        self.assertNotEqual(hash(first), hash(second))
+        self.assertNotEqual(first, None)
+
+
 
 class CRLTests(TestCase):
     """
@@ -2553,6 +4258,84 @@ class CRLTests(TestCase):
         self.assertRaises(ValueError, crl.export, self.cert, self.pkey, 100, 10)
 
 
+    def test_export_into(self):
+        """
+        L{OpenSSL.CRL.export_into} writes the CRL into a writable buffer and
+        returns its size, which it also returns when passed C{None} instead
+        of a buffer.
+        """
+        crl = CRL()
+        revoked = Revoked()
+        revoked.set_serial(b('3ab'))
+        revoked.set_rev_date(b('20100101000000Z'))
+        crl.add_revoked(revoked)
+        for type in [FILETYPE_PEM, FILETYPE_ASN1]:
+            size = crl.export_into(self.cert, self.pkey, None, type)
+            buffer = bytearray(size)
+            self.assertEqual(
+                crl.export_into(self.cert, self.pkey, buffer, type=type), size)
+            loaded = load_crl(type, buffer)
+            self.assertEqual(loaded.get_revoked()[0].get_serial(), b('03AB'))
+        self.assertRaises(ValueError, crl.export_into, self.cert, self.pkey,
+                          bytearray(10))
+        self.assertRaises(ValueError, crl.export_into, self.cert, self.pkey,
+                          None, 100)
+        self.assertRaises(TypeError, crl.export_into, self.cert, self.pkey)
+
+
+    def test_export_into_signed_once(self):
+        """
+        L{OpenSSL.CRL.export_into} passed C{None} instead of the certificate
+        and key writes the CRL as last signed, so its size can be queried
+        once and the CRL written into a buffer of exactly that size, even
+        with DSA keys whose signature length varies.  L{OpenSSL.CRL.sign}
+        signs the CRL without writing it.
+        """
+        key = PKey()
+        key.generate_key(TYPE_DSA, DSAParameters(1024))
+        crl = CRL()
+        for i in range(20):
+            size = crl.export_into(self.cert, key, None, FILETYPE_ASN1,
+                                   digest="sha256")
+            buffer = bytearray(size)
+            self.assertEqual(
+                crl.export_into(None, None, buffer, FILETYPE_ASN1), size)
+            again = bytearray(size)
+            crl.export_into(None, None, again, FILETYPE_ASN1)
+            self.assertEqual(again, buffer)
+            self.assertTrue(
+                isinstance(load_crl(FILETYPE_ASN1, buffer), CRL))
+
+        crl.sign(self.cert, key, days=10, digest="sha1")
+        pem = crl.export_into(None, None, None)
+        buffer = bytearray(pem)
+        self.assertEqual(crl.export_into(None, None, buffer), pem)
+        self.assertTrue(
+            bytes(buffer).startswith(b("-----BEGIN X509 CRL-----")))
+
+
+    def test_sign_wrong_args(self):
+        """
+        L{OpenSSL.CRL.sign} and L{OpenSSL.CRL.export_into} raise L{TypeError}
+        for wrong arguments, including only one of the certificate and key
+        being C{None} and the digest passed by position, and
+        L{OpenSSL.crypto.Error} if signing fails.
+        """
+        crl = CRL()
+        self.assertRaises(TypeError, crl.sign)
+        self.assertRaises(TypeError, crl.sign, self.cert)
+        self.assertRaises(TypeError, crl.sign, None, self.pkey)
+        self.assertRaises(TypeError, crl.sign, self.cert, self.pkey, 10, "sha1")
+        self.assertRaises(
+            ValueError, crl.sign, self.cert, self.pkey, digest="no-digest")
+        self.assertRaises(TypeError, crl.export_into, None, self.pkey, None)
+        self.assertRaises(TypeError, crl.export_into, self.cert, None, None)
+        self.assertRaises(
+            TypeError, crl.export_into, self.cert, self.pkey, None,
+            FILETYPE_PEM, 10, "sha1")
+        self.assertRaises(Error, crl.sign, self.cert, PKey())
+
+
     def test_get_revoked(self):
         """
         Use python to create a simple CRL with two revocations.
@@ -2697,5 +4480,438 @@ class SignVerifyTests(TestCase):
             ValueError, verify, good_cert, sig, content, "strange-digest")
 
 
+    def test_sign_verify_nul(self):
+        """
+        L{sign} and L{verify} handle data with embedded NUL bytes, signing
+        all of it, and accept any object supporting the buffer protocol.
+        """
+        content = b("first part\0second part")
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        sig = sign(priv_key, bytearray(content), "sha1")
+        verify(cert, sig, content, "sha1")
+        verify(cert, bytearray(sig), memoryview(content), "sha1")
+        self.assertRaises(
+            Error, verify, cert, sig, b("first part"), "sha1")
+
+
+    def _keyAndCertificate(self, type, bits, digest, **kwargs):
+        """
+        Generate a key and a self-signed certificate for it, passing any
+        keyword arguments on to L{PKey.generate_key}.
+        """
+        key = PKey()
+        key.generate_key(type, bits, **kwargs)
+        cert = X509()
+        cert.set_subject([("CN", "signer")])
+        cert.set_issuer([("CN", "signer")])
+        cert.gmtime_adj_notBefore(0)
+        cert.gmtime_adj_notAfter(3600)
+        cert.set_pubkey(key)
+        cert.sign(key, digest)
+        return key, cert
+
+
+    def test_sign_verify_ec(self):
+        """
+        L{sign} and L{verify} work with EC keys, which can also sign
+        certificates and certificate requests.
+        """
+        key, cert = self._keyAndCertificate(TYPE_EC, 256, "sha256")
+        self.assertEqual(cert.get_signature_algorithm(), b("ecdsa-with-SHA256"))
+        sig = sign(key, b("content"), "sha256")
+        verify(cert, sig, b("content"), "sha256")
+        self.assertRaises(Error, verify, cert, sig, b("tainted"), "sha256")
+
+        request = X509Req()
+        request.set_pubkey(key)
+        request.sign(key, "sha256")
+        self.assertTrue(request.verify(key))
+
+
+    def test_sign_verify_ed25519(self):
+        """
+        L{sign} and L{verify} work with Ed25519 keys, which take no separate
+        digest, so it is given as C{None}.
+        """
+        key, cert = self._keyAndCertificate(TYPE_ED25519, None, None)
+        self.assertEqual(cert.get_signature_algorithm(), b("ED25519"))
+        sig = sign(key, b("content"), None)
+        self.assertEqual(len(sig), 64)
+        verify(cert, sig, b("content"), None)
+        self.assertRaises(Error, verify, cert, sig, b("tainted"), None)
+        self.assertRaises(Error, sign, key, b("content"), "sha256")
+        self.assertEqual(
+            verify_signatures(cert, [(sig, b("content"))], None), [True])
+
+        request = X509Req()
+        request.set_pubkey(key)
+        request.sign(key, None)
+        self.assertTrue(request.verify(key))
+
+
+    def test_dump_load_ec_ed25519(self):
+        """
+        EC and Ed25519 private keys can be dumped and loaded again in PEM and
+        ASN.1 formats, and dumped as text.
+        """
+        for type, bits in [(TYPE_EC, "P-384"), (TYPE_ED25519, None)]:
+            key = PKey()
+            key.generate_key(type, bits)
+            pem = dump_privatekey(FILETYPE_PEM, key)
+            for filetype in [FILETYPE_PEM, FILETYPE_ASN1]:
+                loaded = load_privatekey(
+                    filetype, dump_privatekey(filetype, key))
+                self.assertEqual(loaded.type(), type)
+                self.assertEqual(dump_privatekey(FILETYPE_PEM, loaded), pem)
+            self.assertTrue(
+                b("Private-Key") in dump_privatekey(FILETYPE_TEXT, key))
+
+
+    def test_sign_verify_multi_prime_rsa(self):
+        """
+        Signatures made with a multi-prime RSA key are ordinary RSA signatures,
+        which L{verify} checks against the public key alone.
+        """
+        key, cert = self._keyAndCertificate(TYPE_RSA, 2048, "sha256", primes=3)
+        sig = sign(key, b("content"), "sha256")
+        self.assertEqual(len(sig), 256)
+        public = load_certificate(
+            FILETYPE_PEM, dump_certificate(FILETYPE_PEM, cert))
+        verify(public, sig, b("content"), "sha256")
+        self.assertRaises(Error, verify, public, sig, b("tainted"), "sha256")
+        self.assertEqual(
+            sign_many(key, [b("content")], "sha256"),
+            [sign(key, b("content"), "sha256")])
+
+
+    def test_signer_type(self):
+        """
+        L{Signer} and L{SignerType}, L{Verifier} and L{VerifierType} refer
+        to the same type objects.
+        """
+        self.assertIdentical(Signer, SignerType)
+        self.assertConsistentType(
+            Signer, 'Signer', load_privatekey(FILETYPE_PEM, root_key_pem),
+            "sha1")
+        self.assertIdentical(Verifier, VerifierType)
+        self.assertConsistentType(
+            Verifier, 'Verifier', load_certificate(FILETYPE_PEM, root_cert_pem),
+            "sha1")
+
+
+    def test_signer_verifier(self):
+        """
+        L{Signer} signs data fed to it in pieces, large and small, and
+        produces a signature L{verify} accepts.  L{Verifier} checks
+        signatures of data fed to it in pieces.
+        """
+        chunks = [b("x") * 10000, b("\0"), b("y") * 5, bytearray(b("z") * 3000)]
+        content = b("").join([bytes(chunk) for chunk in chunks])
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+
+        signer = Signer(priv_key, "sha256")
+        for chunk in chunks:
+            signer.update(chunk)
+        sig = signer.final()
+        self.assertEqual(sig, sign(priv_key, content, "sha256"))
+        verify(cert, sig, content, "sha256")
+
+        verifier = Verifier(cert, "sha256")
+        for chunk in chunks:
+            verifier.update(chunk)
+        verifier.final(sig)
+
+        verifier = Verifier(cert, "sha256")
+        verifier.update(content[:-1])
+        self.assertRaises(Error, verifier.final, sig)
+
+
+    def test_signer_final_once(self):
+        """
+        L{Signer.final} and L{Verifier.final} can only be called once, after
+        which L{Signer.update} and L{Verifier.update} raise L{ValueError}.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        signer = Signer(priv_key, "sha1")
+        sig = signer.final()
+        self.assertRaises(ValueError, signer.final)
+        self.assertRaises(ValueError, signer.update, b("more"))
+        verifier = Verifier(cert, "sha1")
+        verifier.final(sig)
+        self.assertRaises(ValueError, verifier.final, sig)
+        self.assertRaises(ValueError, verifier.update, b("more"))
+
+
+    def test_signer_threads(self):
+        """
+        L{Signer.update} can be called from several threads at once, every
+        piece of data being digested exactly once.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        signer = Signer(priv_key, "sha1")
+        chunk = b("a") * 100000
+        def update():
+            for i in range(10):
+                signer.update(chunk)
+        threads = [Thread(target=update) for i in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(
+            signer.final(), sign(priv_key, chunk * 40, "sha1"))
+
+
+    def test_signer_wrong_args(self):
+        """
+        L{Signer} and L{Verifier} raise L{TypeError} for a wrong key or
+        certificate and L{ValueError} for an unknown digest.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.assertRaises(TypeError, Signer, cert, "sha1")
+        self.assertRaises(TypeError, Verifier, priv_key, "sha1")
+        self.assertRaises(ValueError, Signer, priv_key, "strange-digest")
+        self.assertRaises(ValueError, Verifier, cert, "strange-digest")
+        self.assertRaises(TypeError, Signer(priv_key, "sha1").update, None)
+
+
+    def test_sign_many(self):
+        """
+        L{sign_many} returns the same signatures as calling L{sign} on each
+        message, whatever the number of threads used.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        messages = [b("message %d") % (i,) * i for i in range(50)]
+        messages.append(bytearray(b("\0") * 100000))
+        expected = [sign(priv_key, bytes(message), "sha256")
+                    for message in messages]
+        for threads in [0, 1, 4]:
+            self.assertEqual(
+                sign_many(priv_key, messages, "sha256", threads=threads),
+                expected)
+        self.assertEqual(
+            sign_many(priv_key, tuple(messages[:3]), "sha1"),
+            [sign(priv_key, message, "sha1") for message in messages[:3]])
+        self.assertEqual(sign_many(priv_key, [], "sha1"), [])
+
+
+    def test_sign_many_wrong_args(self):
+        """
+        L{sign_many} raises L{TypeError} for a wrong key or a message which
+        is not a buffer, L{ValueError} for an unknown digest and
+        L{OpenSSL.crypto.Error} if signing fails.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        self.assertRaises(TypeError, sign_many)
+        self.assertRaises(TypeError, sign_many, None, [], "sha1")
+        self.assertRaises(TypeError, sign_many, priv_key, None, "sha1")
+        self.assertRaises(
+            TypeError, sign_many, priv_key, [b("data"), None], "sha1")
+        self.assertRaises(
+            ValueError, sign_many, priv_key, [b("data")], "strange-digest")
+        self.assertRaises(Error, sign_many, PKey(), [b("data")], "sha1")
+
+
+    def test_verify_signatures(self):
+        """
+        L{verify_signatures} checks every (signature, data) pair, returning
+        C{True} for the valid ones and C{False} for the others, whatever the
+        number of threads used.
+        """
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        messages = [b("line %d") % (i,) for i in range(40)]
+        pairs = list(zip(sign_many(priv_key, messages, "sha256"), messages))
+        pairs[3] = (pairs[3][0], pairs[3][1] + b("tainted"))
+        pairs[7] = (pairs[8][0], pairs[7][1])
+        pairs[11] = (b(""), pairs[11][1])
+        pairs.append((bytearray(pairs[0][0]), memoryview(pairs[0][1])))
+        expected = [i not in (3, 7, 11) for i in range(len(pairs))]
+        for threads in [0, 1, 4]:
+            self.assertEqual(
+                verify_signatures(cert, pairs, "sha256", threads=threads),
+                expected)
+        self.assertEqual(verify_signatures(cert, (), "sha256"), [])
+
+        other = load_certificate(FILETYPE_PEM, server_cert_pem)
+        self.assertEqual(
+            verify_signatures(other, pairs[:2], "sha256"), [False, False])
+
+
+    def test_verify_signatures_wrong_args(self):
+        """
+        L{verify_signatures} raises L{TypeError} for a wrong certificate or
+        an item which is not a pair of buffers, L{ValueError} for a pair of
+        the wrong length and for an unknown digest.
+        """
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        self.assertRaises(TypeError, verify_signatures)
+        self.assertRaises(TypeError, verify_signatures, None, [], "sha1")
+        self.assertRaises(TypeError, verify_signatures, cert, None, "sha1")
+        self.assertRaises(TypeError, verify_signatures, cert, [None], "sha1")
+        self.assertRaises(
+            TypeError, verify_signatures, cert, [(b("sig"), None)], "sha1")
+        self.assertRaises(
+            ValueError, verify_signatures, cert, [(b("sig"),)], "sha1")
+        self.assertRaises(
+            ValueError, verify_signatures, cert, [(b("a"), b("b"))],
+            "strange-digest")
+
+
+    def test_generate_keys(self):
+        """
+        L{generate_keys} returns a list of C{count} distinct new keys of the
+        requested type and size, whatever the number of threads used.
+        """
+        for threads in [0, 1, 4]:
+            keys = generate_keys(TYPE_RSA, 1024, 5, threads=threads)
+            self.assertEqual(len(keys), 5)
+            for key in keys:
+                self.assertTrue(isinstance(key, PKeyType))
+                self.assertEqual(key.type(), TYPE_RSA)
+                self.assertEqual(key.bits(), 1024)
+            self.assertEqual(
+                len(set(dump_privatekey(FILETYPE_PEM, key) for key in keys)),
+                5)
+
+        keys = generate_keys(TYPE_EC, "prime256v1", 3)
+        self.assertEqual([key.bits() for key in keys], [256] * 3)
+        keys = generate_keys(TYPE_ED25519, None, 2, threads=2)
+        self.assertEqual([key.type() for key in keys], [TYPE_ED25519] * 2)
+        self.assertEqual(generate_keys(TYPE_RSA, 1024, 0), [])
+
+
+    def test_generate_keys_wrong_args(self):
+        """
+        L{generate_keys} raises L{TypeError} for wrong arguments or missing
+        bits, L{ValueError} for a negative count and L{OpenSSL.crypto.Error}
+        for an unknown key type or if generating a key fails.
+        """
+        self.assertRaises(TypeError, generate_keys)
+        self.assertRaises(TypeError, generate_keys, TYPE_RSA, 1024)
+        self.assertRaises(TypeError, generate_keys, TYPE_RSA, None, 2)
+        self.assertRaises(TypeError, generate_keys, TYPE_RSA, 1024, "2")
+        self.assertRaises(ValueError, generate_keys, TYPE_RSA, 1024, -1)
+        self.assertRaises(Error, generate_keys, 3, 1024, 1)
+        self.assertRaises(Error, generate_keys, TYPE_RSA, 16, 3)
+
+
+
+class EVPTests(TestCase):
+    """
+    Tests for L{OpenSSL.crypto.get_digest} and L{OpenSSL.crypto.get_cipher}.
+    """
+    def test_type(self):
+        """
+        L{Digest} and L{DigestType}, L{Cipher} and L{CipherType} refer to the
+        same type objects.  Calling them looks a name up like L{get_digest}
+        and L{get_cipher}, returning the same objects.
+        """
+        self.assertIdentical(Digest, DigestType)
+        self.assertIdentical(Cipher, CipherType)
+        self.assertIdentical(Digest("sha256"), get_digest("sha256"))
+        self.assertIdentical(Digest(name="SHA256"), get_digest("sha256"))
+        self.assertIdentical(Cipher("aes-128-cbc"), get_cipher("AES128"))
+        self.assertRaises(TypeError, Digest)
+        self.assertRaises(TypeError, Cipher)
+        self.assertRaises(TypeError, Digest, None)
+        self.assertRaises(TypeError, Cipher, "aes-128-cbc", "des3")
+        self.assertRaises(ValueError, Digest, "strange-digest")
+        self.assertRaises(ValueError, Cipher, "strange-cipher")
+        self.assertTrue(isinstance(get_digest("sha1"), Digest))
+        self.assertTrue(isinstance(get_cipher("des3"), Cipher))
+
+
+    def test_get_digest(self):
+        """
+        L{get_digest} returns the same L{Digest} object for every name of a
+        message digest, which describes it.
+        """
+        digest = get_digest("sha256")
+        self.assertIdentical(get_digest("sha256"), digest)
+        self.assertIdentical(get_digest("SHA256"), digest)
+        self.assertEqual(digest.get_name(), "SHA256")
+        self.assertEqual(digest.get_size(), 32)
+        self.assertEqual(digest.get_block_size(), 64)
+        self.assertEqual(repr(digest), "<Digest object 'SHA256'>")
+        self.assertNotEqual(get_digest("sha1"), digest)
+        self.assertRaises(ValueError, get_digest, "strange-digest")
+        self.assertRaises(TypeError, get_digest)
+        self.assertRaises(TypeError, get_digest, None)
+        self.assertRaises(TypeError, digest.get_size, None)
+
+
+    def test_get_cipher(self):
+        """
+        L{get_cipher} returns the same L{Cipher} object for every name of a
+        cipher, which describes it.
+        """
+        cipher = get_cipher("aes-128-cbc")
+        self.assertIdentical(get_cipher("aes-128-cbc"), cipher)
+        self.assertIdentical(get_cipher("AES128"), cipher)
+        self.assertEqual(cipher.get_name(), "AES-128-CBC")
+        self.assertEqual(cipher.get_key_length(), 16)
+        self.assertEqual(cipher.get_iv_length(), 16)
+        self.assertEqual(cipher.get_block_size(), 16)
+        self.assertEqual(repr(cipher), "<Cipher object 'AES-128-CBC'>")
+        self.assertRaises(ValueError, get_cipher, "strange-cipher")
+        self.assertRaises(TypeError, get_cipher)
+        self.assertRaises(TypeError, get_cipher, None)
+
+
+    def test_digest_argument(self):
+        """
+        A L{Digest} object can be used wherever a message digest name is
+        accepted, and any other object raises L{TypeError}.
+        """
+        digest = get_digest("sha1")
+        priv_key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        cert = load_certificate(FILETYPE_PEM, root_cert_pem)
+        content = b("some data")
+
+        sig = sign(priv_key, content, digest)
+        self.assertEqual(sig, sign(priv_key, content, "sha1"))
+        verify(cert, sig, content, digest)
+        self.assertEqual(sign_many(priv_key, [content], digest), [sig])
+        self.assertEqual(
+            verify_signatures(cert, [(sig, content)], digest), [True])
+        self.assertEqual(cert.digest(digest), cert.digest("sha1"))
+
+        signer = Signer(priv_key, digest)
+        signer.update(content)
+        self.assertEqual(signer.final(), sig)
+
+        request = X509Req()
+        request.set_pubkey(priv_key)
+        request.sign(priv_key, digest)
+        self.assertTrue(request.verify(priv_key))
+
+        self.assertRaises(TypeError, sign, priv_key, content, 1)
+        self.assertRaises(TypeError, cert.digest, get_cipher("des3"))
+        self.assertRaises(ValueError, cert.digest, "strange-digest")
+
+
+    def test_cipher_argument(self):
+        """
+        A L{Cipher} object can be used wherever a cipher name is accepted.
+        """
+        key = load_privatekey(FILETYPE_PEM, root_key_pem)
+        passphrase = b("foo")
+        pem = dump_privatekey(
+            FILETYPE_PEM, key, get_cipher("des3"), passphrase)
+        self.assertTrue(b("ENCRYPTED") in pem)
+        loaded = load_privatekey(FILETYPE_PEM, pem, passphrase)
+        self.assertEqual(
+            dump_privatekey(FILETYPE_PEM, loaded),
+            dump_privatekey(FILETYPE_PEM, key))
+        self.assertRaises(
+            TypeError, dump_privatekey, FILETYPE_PEM, key, get_digest("sha1"),
+            passphrase)
+
+
 if __name__ == '__main__':
     main()
@@ -13,6 +13,16 @@
 #include <Python.h>
 #include "util.h"
 
+#ifdef WITH_THREAD
+#include <pythread.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 /*
  * Flush OpenSSL's error queue and return a list of errors (a (library,
  * function, reason) string tuple)
@@ -44,6 +54,55 @@ void exception_from_error_queue(PyObject *the_Error) {
     Py_DECREF(errlist);
 } 
 
+/*
+ * Raise an exception for a single OpenSSL error code, like
+ * exception_from_error_queue would if it was the only error in the queue.
+ * This is for errors which happened in another thread, whose error queue is
+ * not available.
+ *
+ * Arguments: the_Error - The exception type to raise
+ *            err       - The error code, or 0 for an empty list of errors
+ * Returns:   None
+ */
+void
+exception_from_error_code(PyObject *the_Error, unsigned long err) {
+    PyObject *errlist, *tuple;
+
+    if ((errlist = PyList_New(0)) == NULL)
+        return;
+    if (err != 0) {
+        tuple = Py_BuildValue("(sss)", ERR_lib_error_string(err),
+                                       ERR_func_error_string(err),
+                                       ERR_reason_error_string(err));
+        if (tuple == NULL || PyList_Append(errlist, tuple) < 0) {
+            Py_XDECREF(tuple);
+            Py_DECREF(errlist);
+            return;
+        }
+        Py_DECREF(tuple);
+    }
+    PyErr_SetObject(the_Error, errlist);
+    Py_DECREF(errlist);
+}
+
+/*
+ * Get the code of the last error in this thread's OpenSSL error queue, to be
+ * raised later with exception_from_error_code.  Some failures don't queue an
+ * error, so a generic one is made up to make sure the failure is reported.
+ * Doesn't need the GIL.
+ *
+ * Arguments: lib - The library to blame if the queue is empty
+ * Returns:   The error code, never 0
+ */
+unsigned long
+last_error_code(int lib) {
+    unsigned long err = ERR_peek_last_error();
+
+    if (err == 0)
+        err = ERR_PACK(lib, 0, ERR_R_OPERATION_FAIL);
+    return err;
+}
+
 /*
  * Flush OpenSSL's error queue and ignore the result
  *
@@ -61,6 +120,173 @@ flush_error_queue(void) {
     Py_DECREF(list);
 }
 
+/*
+ * Set an item of a dict to a new reference, which is given away
+ *
+ * Arguments: dict  - The dict
+ *            key   - The key
+ *            value - The value, or NULL with an exception set if creating it
+ *                    failed
+ * Returns:   0 on success, -1 with an exception set on error
+ */
+int
+dict_set_new(PyObject *dict, const char *key, PyObject *value) {
+    int result;
+
+    if (value == NULL)
+        return -1;
+    result = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return result;
+}
+
+struct pool_st {
+    Py_ssize_t count;           /* Number of items */
+    Py_ssize_t next;            /* Next item to hand out */
+    pool_worker worker;
+    void *arg;
+#ifdef WITH_THREAD
+    PyThread_type_lock lock;    /* Protects next and running */
+    PyThread_type_lock done;    /* Held until the last worker thread exits */
+    int running;                /* Threads (including the caller) still working */
+#endif
+};
+
+/*
+ * Get the default number of worker threads, one per online CPU
+ *
+ * Arguments: None
+ * Returns:   The number of threads, at least 1
+ */
+int
+pool_default_threads(void) {
+    long n;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    n = 1;
+#endif
+    return n < 1 ? 1 : (int)n;
+}
+
+/*
+ * Get the index of the next item to process.  Only to be called by pool
+ * workers.
+ *
+ * Arguments: pool - The pool passed to the worker
+ * Returns:   The item index, or -1 if there is nothing left to do
+ */
+Py_ssize_t
+pool_next(pool_t *pool) {
+    Py_ssize_t i;
+
+#ifdef WITH_THREAD
+    if (pool->lock != NULL)
+        PyThread_acquire_lock(pool->lock, WAIT_LOCK);
+#endif
+    i = pool->next < pool->count ? pool->next++ : -1;
+#ifdef WITH_THREAD
+    if (pool->lock != NULL)
+        PyThread_release_lock(pool->lock);
+#endif
+    return i;
+}
+
+#ifdef WITH_THREAD
+/*
+ * Mark a thread as finished.  The last one to finish lets pool_run return.
+ */
+static int
+pool_leave(pool_t *pool) {
+    int running;
+
+    PyThread_acquire_lock(pool->lock, WAIT_LOCK);
+    running = --pool->running;
+    PyThread_release_lock(pool->lock);
+    return running;
+}
+
+static void
+pool_thread(void *arg) {
+    pool_t *pool = arg;
+
+    pool->worker(pool, pool->arg);
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+    ERR_remove_state(0);
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+    ERR_remove_thread_state(NULL);
+#endif
+    /* pool lives on the stack of pool_run, don't touch it after this */
+    if (pool_leave(pool) == 0)
+        PyThread_release_lock(pool->done);
+}
+#endif
+
+/*
+ * Run a worker over count items using up to threads native threads (one per
+ * CPU if threads <= 0), the calling thread being one of them.  Falls back to
+ * doing all the work in the calling thread if no threads can be started.
+ * Should be called with the GIL released.
+ *
+ * Arguments: count  - The number of items
+ *            threads - The maximum number of threads to use
+ *            worker - The function to run in every thread
+ *            arg    - The argument to pass to worker
+ * Returns:   None, once all items have been processed
+ */
+void
+pool_run(Py_ssize_t count, int threads, pool_worker worker, void *arg) {
+    pool_t pool;
+    int i;
+
+    pool.count = count;
+    pool.next = 0;
+    pool.worker = worker;
+    pool.arg = arg;
+
+    if (threads <= 0)
+        threads = pool_default_threads();
+    if (threads > count)
+        threads = count > 0 ? (int)count : 1;
+
+#ifdef WITH_THREAD
+    pool.lock = pool.done = NULL;
+    pool.running = 1;
+    if (threads > 1 &&
+        (pool.lock = PyThread_allocate_lock()) != NULL &&
+        (pool.done = PyThread_allocate_lock()) != NULL) {
+        PyThread_acquire_lock(pool.done, WAIT_LOCK);
+        for (i = 1; i < threads; i++) {
+            PyThread_acquire_lock(pool.lock, WAIT_LOCK);
+            pool.running++;
+            PyThread_release_lock(pool.lock);
+            if (PyThread_start_new_thread(pool_thread, &pool) ==
+                PYTHREAD_INVALID_THREAD_ID) {
+                pool_leave(&pool);
+                break;
+            }
+        }
+    }
+#endif
+
+    worker(&pool, arg);
+
+#ifdef WITH_THREAD
+    if (pool.done != NULL) {
+        if (pool_leave(&pool) > 0)
+            PyThread_acquire_lock(pool.done, WAIT_LOCK);
+        PyThread_release_lock(pool.done);
+        PyThread_free_lock(pool.done);
+    }
+    if (pool.lock != NULL)
+        PyThread_free_lock(pool.lock);
+#endif
+}
+
 #if (PY_VERSION_HEX < 0x02600000)
 PyObject* PyOpenSSL_LongToHex(PyObject *o) {
     PyObject *hex = NULL;
@@ -30,7 +30,10 @@
 
 extern  PyObject *error_queue_to_list(void);
 extern void exception_from_error_queue(PyObject *the_Error);
+extern void exception_from_error_code(PyObject *the_Error, unsigned long err);
+extern unsigned long last_error_code(int lib);
 extern  void      flush_error_queue(void);
+extern  int       dict_set_new(PyObject *dict, const char *key, PyObject *value);
 
 /*
  * These are needed because there is no "official" way to specify
@@ -55,7 +58,7 @@ extern  void      flush_error_queue(void);
 
 #else
 #  define MY_BEGIN_ALLOW_THREADS(st)
-#  define MY_END_ALLOW_THREADS(st)      { st = NULL; }
+#  define MY_END_ALLOW_THREADS(st)
 #endif
 
 #if !defined(PY_MAJOR_VERSION) || PY_VERSION_HEX < 0x02000000
@@ -131,6 +134,20 @@ typedef int Py_ssize_t;
 #define PY_SSIZE_T_MIN INT_MIN
 #endif
 
+/*
+ * A pool of native worker threads, for running OpenSSL work over many items
+ * with the GIL released.  A worker function is called once in every thread
+ * (including the calling one) and picks up item indices with pool_next()
+ * until it returns -1, which lets it set up per-thread state once.  Workers
+ * must not touch any Python object.
+ */
+typedef struct pool_st pool_t;
+typedef void (*pool_worker)(pool_t *pool, void *arg);
+
+extern  int        pool_default_threads(void);
+extern  void       pool_run(Py_ssize_t count, int threads, pool_worker worker, void *arg);
+extern  Py_ssize_t pool_next(pool_t *pool);
+
 #if (PY_VERSION_HEX < 0x02600000)
 extern PyObject* PyOpenSSL_LongToHex(PyObject *o);
 #else
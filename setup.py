@@ -23,14 +23,20 @@ crypto_src = ['OpenSSL/crypto/crypto.c', 'OpenSSL/crypto/x509.c',
               'OpenSSL/crypto/x509ext.c', 'OpenSSL/crypto/pkcs7.c',
               'OpenSSL/crypto/pkcs12.c', 'OpenSSL/crypto/netscape_spki.c',
               'OpenSSL/crypto/revoked.c', 'OpenSSL/crypto/crl.c',
-              'OpenSSL/util.c']
+              'OpenSSL/crypto/x509iter.c', 'OpenSSL/crypto/signer.c',
+              'OpenSSL/crypto/evp.c', 'OpenSSL/crypto/certcache.c',
+              'OpenSSL/crypto/x509compact.c', 'OpenSSL/crypto/keypool.c',
+              'OpenSSL/crypto/dsaparams.c', 'OpenSSL/util.c']
 crypto_dep = ['OpenSSL/crypto/crypto.h', 'OpenSSL/crypto/x509.h',
               'OpenSSL/crypto/x509name.h', 'OpenSSL/crypto/pkey.h',
               'OpenSSL/crypto/x509store.h', 'OpenSSL/crypto/x509req.h',
               'OpenSSL/crypto/x509ext.h', 'OpenSSL/crypto/pkcs7.h',
               'OpenSSL/crypto/pkcs12.h', 'OpenSSL/crypto/netscape_spki.h',
               'OpenSSL/crypto/revoked.h', 'OpenSSL/crypto/crl.h',
-              'OpenSSL/util.h']
+              'OpenSSL/crypto/x509iter.h', 'OpenSSL/crypto/signer.h',
+              'OpenSSL/crypto/evp.h', 'OpenSSL/crypto/certcache.h',
+              'OpenSSL/crypto/x509compact.h', 'OpenSSL/crypto/keypool.h',
+              'OpenSSL/crypto/dsaparams.h', 'OpenSSL/util.h']
 rand_src = ['OpenSSL/rand/rand.c', 'OpenSSL/util.c']
 rand_dep = ['OpenSSL/util.h']
 